@@ -1,23 +1,69 @@
 TEMPLATE = app
 
-QT += qml quick
+QT += qml quick concurrent
 CONFIG += c++11
 
 DEFINES += TEST_ANDROID_LOCAL
 
 SOURCES += main.cpp \
+    cubespheregenerator.cpp \
     earth3d.cpp \
     earth3drenderer.cpp \
+    globelod.cpp \
+    globepicker.cpp \
+    icospheregenerator.cpp \
+    ktxfile.cpp \
+    msaatarget.cpp \
+    passtimer.cpp \
+    patchculler.cpp \
+    pointdrawer.cpp \
+    pointindex.cpp \
+    pointlayer.cpp \
+    pointloader.cpp \
+    polylinedrawer.cpp \
+    polylinelayer.cpp \
+    shadercache.cpp \
     showtexturemapping.cpp \
-    spheregenerator.cpp
+    spherecache.cpp \
+    spheregenerator.cpp \
+    streamedtexture.cpp \
+    stripdrawer.cpp \
+    texturecache.cpp \
+    tilepack.cpp \
+    tilesource.cpp \
+    uniformblock.cpp \
+    virtualtexture.cpp
 
 RESOURCES += qml.qrc
 
 HEADERS += \
+    cubespheregenerator.h \
     earth3d.h \
     earth3drenderer.h \
+    globelod.h \
+    globepicker.h \
+    icospheregenerator.h \
+    ktxfile.h \
+    msaatarget.h \
+    passtimer.h \
+    patchculler.h \
+    pointdrawer.h \
+    pointindex.h \
+    pointlayer.h \
+    pointloader.h \
+    polylinedrawer.h \
+    polylinelayer.h \
+    shadercache.h \
     showtexturemapping.h \
-    spheregenerator.h
+    spherecache.h \
+    spheregenerator.h \
+    streamedtexture.h \
+    stripdrawer.h \
+    texturecache.h \
+    tilepack.h \
+    tilesource.h \
+    uniformblock.h \
+    virtualtexture.h
 
 OTHER_FILES += style.astylerc
 
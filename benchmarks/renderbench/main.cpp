@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <random>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QtMath>
+#include "earth3d.h"
+#include "offscreenview.h"
+#include "pointindex.h"
+#include "shadercache.h"
+#include "showtexturemapping.h"
+
+#ifndef GL_VENDOR
+#define GL_VENDOR 0x1F00
+#define GL_RENDERER 0x1F01
+#define GL_VERSION 0x1F02
+#endif
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+static const auto SkipEmptyParts = Qt::SkipEmptyParts;
+#else
+static const auto SkipEmptyParts = QString::SkipEmptyParts;
+#endif
+
+struct Run {
+    QString item;
+    int resolution;
+    QSize size;
+    int samples;
+    QString path;
+    int points;
+    int lines;
+};
+
+static QList<int> intList(const QString &value)
+{
+    QList<int> list;
+    for (const QString &part : value.split(QLatin1Char(','), SkipEmptyParts)) {
+        list << part.toInt();
+    }
+    return list;
+}
+
+static QList<QSize> sizeList(const QString &value)
+{
+    QList<QSize> list;
+    for (const QString &part : value.split(QLatin1Char(','), SkipEmptyParts)) {
+        QStringList wh = part.split(QLatin1Char('x'));
+        if (wh.size() == 2) {
+            list << QSize(wh[0].toInt(), wh[1].toInt());
+        }
+    }
+    return list;
+}
+
+/*!
+ * \brief moveCamera
+ * Put the camera where the path has it at t in [0, 1). "orbit" circles the
+ * globe or pans over the map, "zoom" moves in close and back out.
+ */
+static void moveCamera(QQuickItem *item, const QString &path, double t)
+{
+    if (auto earth = qobject_cast<Earth3D *>(item)) {
+        if (path == "orbit") {
+            earth->setCameraXRotate(25 + 360 * t);
+        } else if (path == "zoom") {
+            earth->setCameraDistance(1.2 + 1.3 * (1 + qCos(2 * M_PI * t)));
+        }
+    } else if (auto map = qobject_cast<ShowTextureMapping *>(item)) {
+        if (path == "orbit") {
+            map->setCameraPosition(QVector3D(20 * qSin(2 * M_PI * t),
+                                             10 * qSin(4 * M_PI * t), 25));
+        } else if (path == "zoom") {
+            map->setCameraPosition(QVector3D(0, 0, 5 + 10 * (1 + qCos(2 * M_PI * t))));
+        }
+    }
+}
+
+// nearest rank, times sorted ascending
+static QJsonObject percentiles(QVector<double> times)
+{
+    std::sort(times.begin(), times.end());
+    auto rank = [&times](double p) {
+        int i = qCeil(p / 100 * times.size()) - 1;
+        return times[qBound(0, i, times.size() - 1)];
+    };
+    double sum = 0;
+    for (double t : times) {
+        sum += t;
+    }
+    QJsonObject result;
+    result["min"] = times.first();
+    result["p50"] = rank(50);
+    result["p90"] = rank(90);
+    result["p99"] = rank(99);
+    result["max"] = times.last();
+    result["mean"] = sum / times.size();
+    return result;
+}
+
+/*!
+ * \brief addPoints
+ * Random markers all over the globe, the same ones on every run.
+ */
+static void addPoints(Earth3D *earth, int count)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> unit(0, 1);
+    QVector<PointLayer::Point> points(count);
+    for (PointLayer::Point &p : points) {
+        p.lon = 360 * unit(random) - 180;
+        // uniform over the sphere
+        p.lat = qRadiansToDegrees(qAsin(2 * unit(random) - 1));
+        p.color = qRgb(255, int(255 * unit(random)), 0);
+        p.size = 2 + int(6 * unit(random));
+    }
+    earth->pointLayer()->append(points);
+}
+
+/*!
+ * \brief addLines
+ * Random walks of a thousand vertices each, about 5 km apart, simplified
+ * into the levels of the PolylineLayer before the run.
+ * \return milliseconds taken to simplify them
+ */
+static double addLines(Earth3D *earth, int vertices)
+{
+    std::mt19937 random(3);
+    std::uniform_real_distribution<double> unit(0, 1);
+    QVector<PolylineLayer::Line> lines;
+    for (int first = 0; first < vertices; first += 1000) {
+        PolylineLayer::Line line;
+        line.color = qRgb(255, 220, 80);
+        line.width = 2;
+        double lon = 360 * unit(random) - 180;
+        QPointF p(lon, qRadiansToDegrees(qAsin(2 * unit(random) - 1)));
+        double heading = 2 * M_PI * unit(random);
+        for (int k = first; k < qMin(vertices, first + 1000); k++) {
+            line.lonLat << p;
+            heading += 0.5 * (unit(random) - 0.5);
+            p += 0.05 * QPointF(qCos(heading), qSin(heading));
+            p.setY(qBound(-89.0, p.y(), 89.0));
+        }
+        lines << line;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    earth->polylineLayer()->setLines(lines);
+    return timer.nsecsElapsed() / 1e6;
+}
+
+/*!
+ * \brief movePoints
+ * Nudge a contiguous tenth of a percent of the markers, a different part
+ * every frame, which is what incremental uploads are for.
+ */
+static void movePoints(Earth3D *earth, int frame)
+{
+    PointLayer *layer = earth->pointLayer();
+    int moving = qMax(1, layer->count() / 1000);
+    QVector<int> indices(moving);
+    QVector<QPointF> lonLat(moving);
+    for (int k = 0; k < moving; k++) {
+        indices[k] = (frame * moving + k) % layer->count();
+        lonLat[k] = QPointF(360.0 * k / moving - 180, 10 * qSin(0.1 * frame + k));
+    }
+    layer->setPositions(indices, lonLat);
+}
+
+/*!
+ * \brief checkIndex
+ * \return the places where nearest() or within() of the index disagree
+ * with a scan over all markers. Markers within a hair of the radius may
+ * go either way and are not held against it.
+ */
+static int checkIndex(const PointIndex &index, const QVector<float> &positions,
+                      const QVector<QVector3D> &places, double angle)
+{
+    QVector<QVector3D> directions(positions.size() / 2);
+    for (int k = 0; k < directions.size(); k++) {
+        directions[k] = PointIndex::direction(positions[2 * k], positions[2 * k + 1]);
+    }
+    const double hair = 1e-6;
+    auto between = [](const QVector3D &a, const QVector3D &b) {
+        return qAtan2(QVector3D::crossProduct(a, b).length(),
+                      QVector3D::dotProduct(a, b));
+    };
+
+    int mismatches = 0;
+    for (const QVector3D &place : places) {
+        int nearest = -1;
+        double nearestAngle = angle + hair;
+        QVector<int> inside;
+        QVector<int> edge;
+        for (int k = 0; k < directions.size(); k++) {
+            // cheap rejection before the exact angle
+            if (QVector3D::dotProduct(place, directions[k]) < qCos(angle + 2 * hair)) {
+                continue;
+            }
+            double a = between(place, directions[k]);
+            if (a < nearestAngle) {
+                nearest = k;
+                nearestAngle = a;
+            }
+            if (a < angle - hair) {
+                inside << k;
+            } else if (a < angle + hair) {
+                edge << k;
+            }
+        }
+
+        int found = index.nearest(place, angle);
+        bool ok = found < 0 ? nearest < 0 || nearestAngle > angle - hair
+                  : nearest >= 0
+                  && between(place, directions[found]) < nearestAngle + hair;
+
+        QVector<int> got = index.within(place, angle);
+        std::sort(got.begin(), got.end());
+        std::sort(edge.begin(), edge.end());
+        int i = 0;
+        for (int k : got) {
+            // every marker found is inside or on the edge, in order
+            while (i < inside.size() && inside[i] < k) {
+                ok = false;
+                i++;
+            }
+            if (i < inside.size() && inside[i] == k) {
+                i++;
+            } else if (!std::binary_search(edge.begin(), edge.end(), k)) {
+                ok = false;
+            }
+        }
+        ok = ok && i == inside.size();
+        mismatches += !ok;
+    }
+    return mismatches;
+}
+
+/*!
+ * \brief timeIndex
+ * Build a PointIndex over the markers, then time nearest point queries
+ * within one degree and queries for every marker within one degree, each
+ * at a thousand random places. The first hundred of each are checked
+ * against a scan over all markers.
+ */
+static QJsonObject timeIndex(Earth3D *earth)
+{
+    QElapsedTimer timer;
+    timer.start();
+    PointIndex index;
+    index.build(earth->pointLayer()->positionData());
+    double buildMs = timer.nsecsElapsed() / 1e6;
+
+    const int queries = 1000;
+    std::mt19937 random(2);
+    std::uniform_real_distribution<double> unit(0, 1);
+    QVector<QVector3D> places(queries);
+    for (QVector3D &place : places) {
+        place = PointIndex::direction(2 * M_PI * unit(random),
+                                      qAsin(2 * unit(random) - 1));
+    }
+    const double degree = qDegreesToRadians(1.0);
+
+    int found = 0;
+    timer.restart();
+    for (const QVector3D &place : places) {
+        found += index.nearest(place, degree) >= 0;
+    }
+    double nearestMs = timer.nsecsElapsed() / 1e6 / queries;
+
+    qint64 within = 0;
+    timer.restart();
+    for (const QVector3D &place : places) {
+        within += index.within(place, degree).size();
+    }
+    double withinMs = timer.nsecsElapsed() / 1e6 / queries;
+
+    QJsonObject result;
+    result["buildMs"] = buildMs;
+    result["nearestMs"] = nearestMs;
+    result["nearestFound"] = double(found) / queries;
+    result["withinMs"] = withinMs;
+    result["withinPoints"] = double(within) / queries;
+    result["mismatches"] = checkIndex(index, earth->pointLayer()->positionData(),
+                                      places.mid(0, 100), degree);
+    return result;
+}
+
+/*!
+ * \brief timePicking
+ * Pick a 100 by 100 grid over the view as one batch, with the camera of
+ * the last frame.
+ */
+static QJsonObject timePicking(Earth3D *earth, const QSize &size)
+{
+    // the camera is handed to the item with a queued call
+    QCoreApplication::processEvents();
+    const int side = 100;
+    QVector<QPointF> pos;
+    pos.reserve(side * side);
+    for (int j = 0; j < side; j++) {
+        for (int i = 0; i < side; i++) {
+            pos << QPointF((i + 0.5) * size.width() / side, (j + 0.5) * size.height() / side);
+        }
+    }
+    QVector<QPointF> lonLat(pos.size());
+
+    QElapsedTimer timer;
+    timer.start();
+    int hits = earth->picker().pick(pos.constData(), pos.size(), lonLat.data(), nullptr);
+    double us = timer.nsecsElapsed() / 1e3 / pos.size();
+
+    QJsonObject result;
+    result["usPerPoint"] = us;
+    result["hits"] = double(hits) / pos.size();
+    return result;
+}
+
+/*!
+ * \brief runOne
+ * Each run gets a fresh context and item, so the MSAA samples take effect
+ * and no GL state carries over. Frames before the sphere and texture are
+ * in place are not measured.
+ */
+static QJsonObject runOne(const Run &run, int frames, int warmup, QJsonObject *gl)
+{
+    OffscreenView view;
+    if (!view.isValid()) {
+        return QJsonObject();
+    }
+    QQuickItem *item;
+    double linesMs = 0;
+    if (run.item == "earth") {
+        auto earth = new Earth3D;
+        earth->setSphereResolution(run.resolution);
+        earth->setSamples(run.samples);
+        addPoints(earth, run.points);
+        linesMs = run.lines > 0 ? addLines(earth, run.lines) : 0;
+        item = earth;
+    } else {
+        auto map = new ShowTextureMapping;
+        map->setSphereResolution(run.resolution);
+        map->setSamples(run.samples);
+        item = map;
+    }
+    view.setItem(item, run.size);
+    if (gl->isEmpty()) {
+        (*gl)["vendor"] = view.glInfo(GL_VENDOR);
+        (*gl)["renderer"] = view.glInfo(GL_RENDERER);
+        (*gl)["version"] = view.glInfo(GL_VERSION);
+        (*gl)["gpuTimer"] = view.hasGpuTimer();
+    }
+
+    QElapsedTimer waited;
+    waited.start();
+    for (int i = 0; i < warmup || item->property("spherePending").toBool()
+                    || item->property("texturePending").toBool(); i++) {
+        view.renderFrame();
+        if (waited.elapsed() > 60000) {
+            qWarning("renderbench: gave up waiting for the sphere and texture");
+            break;
+        }
+    }
+
+    QVector<double> cpu;
+    QVector<double> gpu;
+    for (int i = 0; i < frames; i++) {
+        moveCamera(item, run.path, double(i) / frames);
+        auto earth = qobject_cast<Earth3D *>(item);
+        if (earth && run.points > 0) {
+            movePoints(earth, i);
+        }
+        OffscreenView::FrameTime time = view.renderFrame();
+        cpu << time.cpuMs;
+        if (time.gpuMs >= 0) {
+            gpu << time.gpuMs;
+        }
+    }
+
+    QJsonObject result;
+    result["item"] = run.item;
+    result["sphereResolution"] = run.resolution;
+    result["width"] = run.size.width();
+    result["height"] = run.size.height();
+    result["samples"] = run.samples;
+    result["path"] = run.path;
+    result["points"] = run.points;
+    result["lineVertices"] = run.lines;
+    if (run.lines > 0) {
+        result["lineBuildMs"] = linesMs;
+    }
+    result["frames"] = frames;
+    result["cpuMs"] = percentiles(cpu);
+    result["gpuMs"] = gpu.isEmpty() ? QJsonValue() : QJsonValue(percentiles(gpu));
+    // per pass, from one of the last frames
+    result["passMs"] = QJsonObject::fromVariantMap(item->property("passTimings").toMap());
+    auto earth = qobject_cast<Earth3D *>(item);
+    if (earth) {
+        result["picking"] = timePicking(earth, run.size);
+    }
+    if (earth && run.points > 0) {
+        result["pointIndex"] = timeIndex(earth);
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("renderbench"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Renders the globe and the texture mapping view offscreen over a sweep of "
+        "settings and prints per frame CPU and GPU time percentiles as JSON.\n"
+        "Without a GPU, run it with -platform offscreen on Mesa llvmpipe."));
+    parser.addHelpOption();
+    QCommandLineOption itemsOption("items", QStringLiteral("earth, texture or both."),
+                                   QStringLiteral("list"),
+                                   QStringLiteral("earth,texture"));
+    QCommandLineOption resolutionsOption("resolutions",
+                                         QStringLiteral("sphereResolution values."),
+                                         QStringLiteral("list"),
+                                         QStringLiteral("36,120,360"));
+    QCommandLineOption sizesOption("sizes", QStringLiteral("Viewport sizes."),
+                                   QStringLiteral("list"),
+                                   QStringLiteral("800x600,1920x1080"));
+    QCommandLineOption samplesOption("samples", QStringLiteral("MSAA sample counts."),
+                                     QStringLiteral("list"), QStringLiteral("0,4"));
+    QCommandLineOption pathsOption("paths", QStringLiteral("static, orbit and zoom."),
+                                   QStringLiteral("list"),
+                                   QStringLiteral("static,orbit,zoom"));
+    QCommandLineOption pointsOption("points",
+                                    QStringLiteral("Markers on the globe, a tenth of "
+                                                   "a percent moving every frame."),
+                                    QStringLiteral("list"), QStringLiteral("0"));
+    QCommandLineOption linesOption("lines",
+                                   QStringLiteral("Vertices of lines on the globe."),
+                                   QStringLiteral("list"), QStringLiteral("0"));
+    QCommandLineOption framesOption("frames", QStringLiteral("Measured frames per run."),
+                                    QStringLiteral("count"), QStringLiteral("300"));
+    QCommandLineOption warmupOption("warmup", QStringLiteral("Frames dropped per run."),
+                                    QStringLiteral("count"), QStringLiteral("30"));
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    QStringLiteral("JSON file, stdout by default."),
+                                    QStringLiteral("file"));
+    parser.addOptions(QList<QCommandLineOption>() << itemsOption << resolutionsOption
+                      << sizesOption << samplesOption << pathsOption << pointsOption
+                      << linesOption << framesOption
+                      << warmupOption << outputOption);
+    parser.process(app);
+
+    QStringList paths = parser.value(pathsOption).split(QLatin1Char(','));
+    QList<Run> runs;
+    for (const QString &item : parser.value(itemsOption).split(QLatin1Char(','))) {
+        for (int resolution : intList(parser.value(resolutionsOption))) {
+            for (const QSize &size : sizeList(parser.value(sizesOption))) {
+                for (int samples : intList(parser.value(samplesOption))) {
+                    for (const QString &path : paths) {
+                        for (int points : intList(parser.value(pointsOption))) {
+                            for (int lines : intList(parser.value(linesOption))) {
+                                // the texture view has no markers or lines
+                                if ((points > 0 || lines > 0) && item != "earth") {
+                                    continue;
+                                }
+                                runs << Run{item, resolution, size, samples, path, points,
+                                            lines};
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    int frames = qMax(1, parser.value(framesOption).toInt());
+    int warmup = qMax(0, parser.value(warmupOption).toInt());
+
+    QTextStream err(stderr);
+    QJsonObject gl;
+    QJsonArray results;
+    for (const Run &run : runs) {
+        if ((run.item != "earth" && run.item != "texture")
+            || (run.path != "static" && run.path != "orbit" && run.path != "zoom")) {
+            err << "renderbench: unknown item or path " << run.item << " " << run.path
+                << "\n";
+            return 1;
+        }
+        err << run.item << " " << run.resolution << " " << run.size.width() << "x"
+            << run.size.height() << " " << run.samples << "x " << run.path << " "
+            << run.points << " points " << run.lines << " line vertices\n";
+        // progress, while the run takes its time
+        err.flush();
+        QJsonObject result = runOne(run, frames, warmup, &gl);
+        if (result.isEmpty()) {
+            err << "renderbench: no OpenGL\n";
+            return 1;
+        }
+        results << result;
+    }
+
+    // the first run compiles, later ones load what it saved
+    ShaderCache::Stats stats = ShaderCache::instance()->stats();
+    QJsonObject shaders;
+    shaders["compiled"] = stats.compiled;
+    shaders["compileMs"] = stats.compileMs;
+    shaders["loaded"] = stats.loaded;
+    shaders["loadMs"] = stats.loadMs;
+
+    QJsonObject report;
+    report["qt"] = QString::fromLatin1(qVersion());
+    report["gl"] = gl;
+    report["shaders"] = shaders;
+    report["warmup"] = warmup;
+    report["runs"] = results;
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            err << "renderbench: can not write " << file.fileName() << "\n";
+            return 1;
+        }
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QOpenGLFunctions>
+#include "offscreenview.h"
+
+OffscreenView::OffscreenView()
+    : m_control(new QQuickRenderControl)
+    , m_window(new QQuickWindow(m_control))
+    , m_item(nullptr)
+    , m_valid(false)
+{
+    QSurfaceFormat format;
+    format.setDepthBufferSize(24);
+    format.setStencilBufferSize(8);
+    m_context.setFormat(format);
+    if (!m_context.create()) {
+        qWarning("OffscreenView: can not create an OpenGL context");
+        return;
+    }
+    m_surface.setFormat(m_context.format());
+    m_surface.create();
+    if (!m_context.makeCurrent(&m_surface)) {
+        qWarning("OffscreenView: can not make the context current");
+        return;
+    }
+    m_control->initialize(&m_context);
+#ifndef QT_OPENGL_ES_2
+    // needs GL 3.3 or ARB_timer_query, both of which llvmpipe has
+    if (!m_context.isOpenGLES()) {
+        m_query.create();
+    }
+#endif
+    m_valid = true;
+}
+
+OffscreenView::~OffscreenView()
+{
+    // renderers release their GL objects while the context is current
+    m_context.makeCurrent(&m_surface);
+#ifndef QT_OPENGL_ES_2
+    m_query.destroy();
+#endif
+    delete m_control;
+    delete m_item;
+    delete m_window;
+    m_fbo.reset();
+    m_context.doneCurrent();
+}
+
+bool OffscreenView::hasGpuTimer() const
+{
+#ifndef QT_OPENGL_ES_2
+    return m_query.isCreated();
+#else
+    return false;
+#endif
+}
+
+QString OffscreenView::glInfo(unsigned int name) const
+{
+    auto str = m_context.functions()->glGetString(name);
+    return str ? QString::fromLatin1(reinterpret_cast<const char *>(str)) : QString();
+}
+
+void OffscreenView::setItem(QQuickItem *item, const QSize &size)
+{
+    m_context.makeCurrent(&m_surface);
+    delete m_item;
+    m_item = item;
+    m_fbo.reset(new QOpenGLFramebufferObject(
+                    size, QOpenGLFramebufferObject::CombinedDepthStencil));
+    m_window->setRenderTarget(m_fbo.data());
+    m_window->setGeometry(0, 0, size.width(), size.height());
+    m_window->contentItem()->setSize(size);
+    item->setParentItem(m_window->contentItem());
+    item->setSize(size);
+}
+
+OffscreenView::FrameTime OffscreenView::renderFrame()
+{
+    // the items render on demand, so every frame has to be asked for;
+    // events deliver finished futures and the renderers' queued calls
+    m_item->update();
+    QCoreApplication::processEvents();
+    m_context.makeCurrent(&m_surface);
+
+    FrameTime time;
+    QElapsedTimer timer;
+    timer.start();
+    m_control->polishItems();
+    m_control->sync();
+#ifndef QT_OPENGL_ES_2
+    if (hasGpuTimer()) {
+        m_query.begin();
+    }
+#endif
+    m_control->render();
+#ifndef QT_OPENGL_ES_2
+    if (hasGpuTimer()) {
+        m_query.end();
+    }
+#endif
+    time.cpuMs = timer.nsecsElapsed() / 1e6;
+
+    m_context.functions()->glFinish();
+    time.gpuMs = -1;
+#ifndef QT_OPENGL_ES_2
+    if (hasGpuTimer()) {
+        time.gpuMs = m_query.waitForResult() / 1e6;
+    }
+#endif
+    return time;
+}
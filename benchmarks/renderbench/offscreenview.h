@@ -0,0 +1,58 @@
+#ifndef OFFSCREENVIEW_H
+#define OFFSCREENVIEW_H
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QQuickItem>
+#include <QQuickRenderControl>
+#include <QQuickWindow>
+#include <QScopedPointer>
+#include <QString>
+#ifndef QT_OPENGL_ES_2
+#include <QOpenGLTimerQuery>
+#endif
+
+/*!
+ * \brief The OffscreenView class
+ * A QQuickWindow driven through QQuickRenderControl into a framebuffer
+ * object, on a QOffscreenSurface. Frames are rendered on the calling thread
+ * only when renderFrame() asks for one, so every frame can be timed.
+ */
+class OffscreenView
+{
+public:
+    struct FrameTime {
+        // polish, sync and render as seen by the render thread
+        double cpuMs;
+        // GL_TIME_ELAPSED of the render, negative without timer queries
+        double gpuMs;
+    };
+
+    OffscreenView();
+    ~OffscreenView();
+
+    bool isValid() const { return m_valid; }
+    bool hasGpuTimer() const;
+    QString glInfo(unsigned int name) const;
+
+    // takes ownership, the item fills the view
+    void setItem(QQuickItem *item, const QSize &size);
+    QQuickItem *item() const { return m_item; }
+
+    FrameTime renderFrame();
+
+private:
+    QOpenGLContext m_context;
+    QOffscreenSurface m_surface;
+    QQuickRenderControl *m_control;
+    QQuickWindow *m_window;
+    QQuickItem *m_item;
+    QScopedPointer<QOpenGLFramebufferObject> m_fbo;
+#ifndef QT_OPENGL_ES_2
+    QOpenGLTimerQuery m_query;
+#endif
+    bool m_valid;
+};
+
+#endif // OFFSCREENVIEW_H
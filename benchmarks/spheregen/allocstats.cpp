@@ -0,0 +1,149 @@
+#include <atomic>
+#include "allocstats.h"
+
+#if defined(__GLIBC__)
+#include <cerrno>
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+}
+
+static std::atomic<quint64> s_allocations(0);
+static std::atomic<qint64> s_bytes(0);
+static std::atomic<qint64> s_base(0);
+static std::atomic<qint64> s_peak(0);
+
+static void added(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    s_allocations++;
+    qint64 bytes = s_bytes += malloc_usable_size(ptr);
+    qint64 peak = s_peak;
+    while (bytes > peak && !s_peak.compare_exchange_weak(peak, bytes)) {
+    }
+}
+
+static void removed(void *ptr)
+{
+    if (ptr) {
+        s_bytes -= malloc_usable_size(ptr);
+    }
+}
+
+extern "C" {
+
+void *malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+    added(ptr);
+    return ptr;
+}
+
+void *calloc(size_t count, size_t size)
+{
+    void *ptr = __libc_calloc(count, size);
+    added(ptr);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    removed(ptr);
+    void *moved = __libc_realloc(ptr, size);
+    // a failed realloc keeps the old block
+    added(moved ? moved : (size ? ptr : nullptr));
+    return moved;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *ptr = __libc_memalign(alignment, size);
+    added(ptr);
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **result, size_t alignment, size_t size)
+{
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    added(ptr);
+    *result = ptr;
+    return 0;
+}
+
+void free(void *ptr)
+{
+    removed(ptr);
+    __libc_free(ptr);
+}
+
+} // extern "C"
+
+bool AllocStats::isAvailable()
+{
+    return true;
+}
+
+void AllocStats::reset()
+{
+    s_allocations = 0;
+    s_base = s_bytes.load();
+    s_peak = s_base.load();
+}
+
+quint64 AllocStats::allocations()
+{
+    return s_allocations;
+}
+
+qint64 AllocStats::peakBytes()
+{
+    return s_peak - s_base;
+}
+
+qint64 AllocStats::currentBytes()
+{
+    return s_bytes - s_base;
+}
+
+#else
+
+bool AllocStats::isAvailable()
+{
+    return false;
+}
+
+void AllocStats::reset()
+{
+}
+
+quint64 AllocStats::allocations()
+{
+    return 0;
+}
+
+qint64 AllocStats::peakBytes()
+{
+    return 0;
+}
+
+qint64 AllocStats::currentBytes()
+{
+    return 0;
+}
+
+#endif
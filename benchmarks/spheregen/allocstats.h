@@ -0,0 +1,29 @@
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <QtGlobal>
+
+/*!
+ * \brief The AllocStats class
+ * Heap use of the whole process, counted by wrapping malloc and friends.
+ * QVector allocates through malloc rather than operator new, so wrapping
+ * new alone would miss the generator's buffers. Only glibc lets us wrap
+ * malloc; elsewhere isAvailable() is false and everything reads 0.
+ */
+class AllocStats
+{
+public:
+    static bool isAvailable();
+
+    // start counting allocations and take the current heap as the base of
+    // peakBytes()
+    static void reset();
+    // allocations since reset(), frees and reallocs not counted
+    static quint64 allocations();
+    // highest heap use above the base since reset()
+    static qint64 peakBytes();
+    // heap use above the base right now
+    static qint64 currentBytes();
+};
+
+#endif // ALLOCSTATS_H
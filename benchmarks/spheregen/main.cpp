@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <cstring>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QScopedPointer>
+#include <QTextStream>
+#include "allocstats.h"
+#include "spheregenerator.h"
+
+struct Config {
+    SphereGenerator::Shape shape;
+    SphereGenerator::Topology topology;
+    SphereGenerator::VertexLayout layout;
+};
+
+static SphereGenerator *createGenerator(const Config &config)
+{
+    SphereGenerator *sphere = SphereGenerator::create(config.shape);
+    sphere->setTopology(config.topology);
+    sphere->setVertexLayout(config.layout);
+    return sphere;
+}
+
+/*!
+ * \brief matchesReference
+ * Everything generate() hands out, against the straightforward
+ * implementation it replaced. UV spheres only.
+ */
+static bool matchesReference(const SphereGenerator &sphere, const Config &config,
+                             int resolution)
+{
+    QScopedPointer<SphereGenerator> reference(createGenerator(config));
+    reference->generateReference(1.0, resolution);
+    const auto &a = sphere.packedVertices();
+    const auto &b = reference->packedVertices();
+    return sphere.vertices() == reference->vertices()
+           && sphere.normals() == reference->normals()
+           && sphere.texcoords() == reference->texcoords()
+           && a.size() == b.size()
+           && memcmp(a.constData(), b.constData(), sphere.packedDataLength()) == 0
+           && sphere.indices() == reference->indices()
+           && sphere.restartPoints(true) == reference->restartPoints(true)
+           && sphere.restartPoints() == reference->restartPoints();
+}
+
+/*!
+ * \brief measure
+ * generate() on a fresh generator, as SphereCache does, repeat times. Time
+ * is the median; allocations and peak memory are the lowest seen, since
+ * the first run also pays for starting the thread pool.
+ */
+static QJsonObject measure(const Config &config, int resolution, int repeat,
+                           bool validate)
+{
+    QVector<double> times;
+    quint64 allocations = 0;
+    qint64 peak = 0;
+    qint64 retained = 0;
+    QScopedPointer<SphereGenerator> sphere;
+    for (int r = 0; r < repeat; r++) {
+        sphere.reset();
+        sphere.reset(createGenerator(config));
+        AllocStats::reset();
+        QElapsedTimer timer;
+        timer.start();
+        sphere->generate(1.0, resolution);
+        times << timer.nsecsElapsed() / 1e6;
+        if (r == 0 || AllocStats::allocations() < allocations) {
+            allocations = AllocStats::allocations();
+        }
+        if (r == 0 || AllocStats::peakBytes() < peak) {
+            peak = AllocStats::peakBytes();
+            retained = AllocStats::currentBytes();
+        }
+    }
+    std::sort(times.begin(), times.end());
+
+    const double vertices = qMax(1, sphere->vertexCount());
+    QJsonObject perVertex;
+    perVertex["vertices"] = sphere->vertexDataLength() / vertices;
+    perVertex["normals"] = sphere->normalDataLength() / vertices;
+    perVertex["texcoords"] = sphere->texcoordDataLength() / vertices;
+    perVertex["packedVertices"] = sphere->packedDataLength() / vertices;
+    perVertex["indices"] = sphere->indexDataLength() / vertices;
+    int restartBytes = sphere->restartPoints(true).size() * sizeof(int);
+    perVertex["restartPoints"] = restartBytes / vertices;
+    perVertex["total"] = (sphere->vertexDataLength() + sphere->normalDataLength()
+                          + sphere->texcoordDataLength() + sphere->packedDataLength()
+                          + sphere->indexDataLength() + restartBytes) / vertices;
+
+    QJsonObject result;
+    result["resolution"] = resolution;
+    result["vertexCount"] = sphere->vertexCount();
+    result["indexCount"] = sphere->indices().size();
+    result["minMs"] = times.first();
+    result["medianMs"] = times[times.size() / 2];
+    if (AllocStats::isAvailable()) {
+        result["allocations"] = double(allocations);
+        result["peakBytes"] = double(peak);
+        result["retainedBytes"] = double(retained);
+    }
+    result["bytesPerVertex"] = perVertex;
+    if (validate && config.shape == SphereGenerator::UvSphere) {
+        result["matchesReference"] = matchesReference(*sphere, config, resolution);
+    }
+    return result;
+}
+
+/*!
+ * \brief compare
+ * Print every result against the baseline entry of the same resolution.
+ * Sizes must not grow at all, allocations and peak memory by 5% at most
+ * and time by the given tolerance.
+ * \return the number of regressions
+ */
+static int compare(const QJsonArray &results, const QJsonArray &baseline,
+                   double tolerance, QTextStream &out)
+{
+    struct Row {
+        const char *name;
+        double before;
+        double after;
+        double allowed;
+    };
+
+    int regressions = 0;
+    for (const QJsonValue &value : results) {
+        QJsonObject result = value.toObject();
+        QJsonObject base;
+        for (const QJsonValue &b : baseline) {
+            if (b.toObject().value("resolution") == result.value("resolution")) {
+                base = b.toObject();
+            }
+        }
+        if (base.isEmpty()) {
+            continue;
+        }
+        auto row = [&](const char *name, double allowed) {
+            return Row{ name, base[name].toDouble(), result[name].toDouble(), allowed };
+        };
+        QVector<Row> rows;
+        QJsonObject basePerVertex = base["bytesPerVertex"].toObject();
+        QJsonObject perVertex = result["bytesPerVertex"].toObject();
+        rows << row("vertexCount", 0) << row("indexCount", 0)
+             << Row{ "bytesPerVertex", basePerVertex["total"].toDouble(),
+                     perVertex["total"].toDouble(), 0 };
+        if (base.contains("allocations") && result.contains("allocations")) {
+            rows << row("allocations", 0.05) << row("peakBytes", 0.05);
+        }
+        rows << row("medianMs", tolerance);
+
+        out << "resolution " << result["resolution"].toInt() << "\n";
+        for (const Row &r : rows) {
+            bool worse = r.after > r.before * (1 + r.allowed) + 1e-9;
+            regressions += worse;
+            out << "  " << r.name << ": " << r.before << " -> " << r.after;
+            if (r.before > 0) {
+                double change = (r.after / r.before - 1) * 100;
+                out << QStringLiteral(" (%1%)").arg(change, 0, 'f', 1);
+            }
+            out << (worse ? " REGRESSION" : "") << "\n";
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("spheregen"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Times SphereGenerator::generate() over a range of resolutions and reports "
+        "allocations, peak heap use and bytes per vertex of every output as JSON. "
+        "With --baseline, a previous report is compared against and the exit code "
+        "is 1 if anything got worse."));
+    parser.addHelpOption();
+    QCommandLineOption resolutionsOption("resolutions", QStringLiteral("Resolutions."),
+                                         QStringLiteral("list"),
+                                         QStringLiteral("10,30,100,300,1000,2000,4000"));
+    QCommandLineOption shapeOption("shape", QStringLiteral("uv, ico or cube."),
+                                   QStringLiteral("shape"), QStringLiteral("uv"));
+    QCommandLineOption topologyOption("topology", QStringLiteral("shared or separate."),
+                                      QStringLiteral("topology"),
+                                      QStringLiteral("shared"));
+    QCommandLineOption layoutOption("layout", QStringLiteral("floats or packed."),
+                                    QStringLiteral("layout"), QStringLiteral("floats"));
+    QCommandLineOption repeatOption("repeat", QStringLiteral("Runs per resolution."),
+                                    QStringLiteral("count"), QStringLiteral("5"));
+    QCommandLineOption noValidateOption("no-validate",
+                                        QStringLiteral("Skip the comparison with "
+                                                       "generateReference()."));
+    QCommandLineOption baselineOption("baseline",
+                                      QStringLiteral("Report to compare with."),
+                                      QStringLiteral("file"));
+    QCommandLineOption toleranceOption("tolerance", QStringLiteral(
+                                           "Allowed slowdown against the baseline, 0.25 "
+                                           "by default."),
+                                       QStringLiteral("fraction"),
+                                       QStringLiteral("0.25"));
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    QStringLiteral("JSON file, stdout by default."),
+                                    QStringLiteral("file"));
+    parser.addOptions(QList<QCommandLineOption>() << resolutionsOption << shapeOption
+                      << topologyOption << layoutOption << repeatOption
+                      << noValidateOption << baselineOption << toleranceOption
+                      << outputOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QStringList shapes = QStringList() << "uv" << "ico" << "cube";
+    Config config;
+    config.shape = SphereGenerator::Shape(shapes.indexOf(parser.value(shapeOption)));
+    config.topology = parser.value(topologyOption) == "separate"
+                      ? SphereGenerator::SeparateStrips : SphereGenerator::SharedGrid;
+    config.layout = parser.value(layoutOption) == "packed"
+                    ? SphereGenerator::PackedInterleaved : SphereGenerator::FloatStreams;
+    if (config.shape < 0) {
+        parser.showHelp(1);
+    }
+    int repeat = qMax(1, parser.value(repeatOption).toInt());
+
+    QJsonArray results;
+    for (const QString &part : parser.value(resolutionsOption).split(QLatin1Char(','))) {
+        int resolution = part.toInt();
+        if (resolution <= 0) {
+            continue;
+        }
+        err << "resolution " << resolution << "\n";
+        // progress, while the resolution takes its time
+        err.flush();
+        QJsonObject result = measure(config, resolution, repeat,
+                                     !parser.isSet(noValidateOption));
+        if (result.contains("matchesReference") && !result["matchesReference"].toBool()) {
+            err << "spheregen: resolution " << resolution
+                << " does not match generateReference()\n";
+        }
+        results << result;
+    }
+
+    QJsonObject report;
+    report["shape"] = parser.value(shapeOption);
+    report["topology"] = config.topology == SphereGenerator::SharedGrid
+                         ? "shared" : "separate";
+    report["layout"] = config.layout == SphereGenerator::FloatStreams
+                       ? "floats" : "packed";
+    report["repeat"] = repeat;
+    report["results"] = results;
+    QByteArray json = QJsonDocument(report).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            err << "spheregen: can not write " << file.fileName() << "\n";
+            return 1;
+        }
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    int failures = 0;
+    for (const QJsonValue &result : results) {
+        QJsonObject r = result.toObject();
+        failures += r.contains("matchesReference") && !r["matchesReference"].toBool();
+    }
+    if (parser.isSet(baselineOption)) {
+        QFile file(parser.value(baselineOption));
+        if (!file.open(QIODevice::ReadOnly)) {
+            err << "spheregen: can not read " << file.fileName() << "\n";
+            return 1;
+        }
+        QJsonObject baseline = QJsonDocument::fromJson(file.readAll()).object();
+        for (const char *key : { "shape", "topology", "layout" }) {
+            if (baseline.value(key) != report.value(key)) {
+                err << "spheregen: the baseline was taken with another " << key << "\n";
+                return 1;
+            }
+        }
+        failures += compare(results, baseline["results"].toArray(),
+                            parser.value(toleranceOption).toDouble(), err);
+    }
+    return failures ? 1 : 0;
+}
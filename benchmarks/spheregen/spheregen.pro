@@ -0,0 +1,23 @@
+TEMPLATE = app
+TARGET = spheregen
+
+QT += gui concurrent
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+# same code paths as the application
+DEFINES += TEST_ANDROID_LOCAL
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    allocstats.cpp \
+    ../../cubespheregenerator.cpp \
+    ../../icospheregenerator.cpp \
+    ../../spheregenerator.cpp
+
+HEADERS += \
+    allocstats.h \
+    ../../cubespheregenerator.h \
+    ../../icospheregenerator.h \
+    ../../spheregenerator.h
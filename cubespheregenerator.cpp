@@ -0,0 +1,87 @@
+#include <QtMath>
+#include <QHash>
+#include "cubespheregenerator.h"
+
+CubeSphereGenerator::CubeSphereGenerator()
+{
+}
+
+/*!
+ * \brief CubeSphereGenerator::cellsPerEdge
+ * \return cells along a cube edge giving about triangleBudget(resolution)
+ * triangles; always even, so the poles are vertices
+ */
+int CubeSphereGenerator::cellsPerEdge(int resolution)
+{
+    return qMax(2, 2 * qRound(qSqrt(triangleBudget(resolution) / 12.0) / 2));
+}
+
+void CubeSphereGenerator::generate(double radius, int resolution)
+{
+    const int n = cellsPerEdge(resolution);
+
+    // center, u and v of every face, with u x v = center
+    static const int frames[6][3][3] = {
+        { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+        { { -1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+        { { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 0 } },
+        { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+        { { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+        { { 0, 0, -1 }, { 0, 1, 0 }, { 1, 0, 0 } },
+    };
+    // the edge between +x and +z goes onto the seam
+    const float turn = M_SQRT1_2;
+
+    // cube points have integer coordinates in [-n, n], shared by the faces
+    // that meet there
+    QVector<QVector3D> directions;
+    QHash<quint64, unsigned int> ids;
+    const quint64 side = 2 * n + 1;
+    auto vertexAt = [&](const int p[3]) -> unsigned int {
+        quint64 key = ((p[0] + n) * side + (p[1] + n)) * side + (p[2] + n);
+        auto it = ids.constFind(key);
+        if (it != ids.constEnd()) {
+            return it.value();
+        }
+        float w[3];
+        for (int k = 0; k < 3; k++) {
+            w[k] = qTan(p[k] / (double) n * M_PI_4);
+        }
+        QVector3D d = QVector3D(w[0], w[1], w[2]).normalized();
+        directions << QVector3D(turn * (d.x() + d.z()), d.y(), turn * (d.z() - d.x()));
+        ids.insert(key, directions.size() - 1);
+        return directions.size() - 1;
+    };
+
+    // patches of t x t cells, about 22.5 degrees
+    const int t = qMax(1, n / 4);
+    const int tiles = (n + t - 1) / t;
+    QVector<QVector<unsigned int>> patches(6 * tiles * tiles);
+
+    for (int f = 0; f < 6; f++) {
+        const int (*frame)[3] = frames[f];
+        auto at = [&](int i, int j) {
+            int p[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = n * frame[0][k] + (2 * i - n) * frame[1][k] + (2 * j - n) * frame[2][k];
+            }
+            return vertexAt(p);
+        };
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i < n; i++) {
+                auto &patch = patches[(f * tiles + i / t) * tiles + j / t];
+                patch << at(i, j) << at(i + 1, j) << at(i, j + 1)
+                      << at(i + 1, j) << at(i + 1, j + 1) << at(i, j + 1);
+            }
+        }
+    }
+
+    QVector<unsigned int> triangles;
+    QVector<int> patchStarts;
+    triangles.reserve(6 * n * n * 6);
+    for (const QVector<unsigned int> &patch : patches) {
+        patchStarts << triangles.size();
+        triangles << patch;
+    }
+    buildTriangleMesh(radius, directions, triangles, patchStarts);
+}
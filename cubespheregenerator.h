@@ -0,0 +1,24 @@
+#ifndef CUBESPHEREGENERATOR_H
+#define CUBESPHEREGENERATOR_H
+
+#include "spheregenerator.h"
+
+/*!
+ * \brief The CubeSphereGenerator class
+ * Cube with n x n cells per face pushed onto the sphere. Cells are warped
+ * equi-angularly, which keeps their areas within about 1.4x of each other
+ * against 5.2x for the plain projection. The cube is turned so that face
+ * centers sit on the poles and a cube edge on the texture seam.
+ */
+class CubeSphereGenerator : public SphereGenerator
+{
+public:
+    CubeSphereGenerator();
+
+    Shape shape() const override { return CubeSphere; }
+    void generate(double radius, int resolution) override;
+
+    static int cellsPerEdge(int resolution);
+};
+
+#endif // CUBESPHEREGENERATOR_H
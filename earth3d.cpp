@@ -1,4 +1,6 @@
 #include <QSGSimpleTextureNode>
+#include <QtConcurrent>
+#include <QtMath>
 #include "earth3d.h"
 #include "earth3drenderer.h"
 
@@ -13,11 +15,42 @@ Earth3D::Earth3D()
     , m_useCamera2(false)
     , m_showVertices(false)
     , m_sphereResolution(360)
+    , m_sphereShape(UvSphere)
+    , m_proceduralSphere(false)
+    , m_lodEnabled(false)
+    , m_lodPixelError(2.0)
+    , m_samples(4)
+    , m_visiblePatches(0)
+    , m_culledPatches(0)
+    , m_spherePending(false)
+    , m_texturePending(true)
+    , m_framesRendered(0)
+    , m_picker(GlobePicker::Sphere)
+    , m_pointLoader(&m_pointLayer)
 {
+    connect(&m_sphereWatcher, &QFutureWatcher<void>::finished,
+            this, &Earth3D::updateSpherePending);
+    // let the renderer pick up the finished sphere
+    connect(&m_sphereWatcher, &QFutureWatcher<void>::finished,
+            this, &Earth3D::update);
+    // and the decoded texture
+    connect(&m_textureWatcher, &QFutureWatcher<void>::finished,
+            this, &Earth3D::update);
+    // and the edited markers
+    connect(&m_pointLayer, &PointLayer::changed, this, &Earth3D::update);
+    connect(&m_pointLoader, &PointLoader::finished, this, &Earth3D::pointsLoaded);
+    // and the loaded lines
+    connect(&m_polylineLayer, &PolylineLayer::changed, this, &Earth3D::update);
+    connect(&m_polylineLayer, &PolylineLayer::loadingChanged,
+            this, &Earth3D::linesLoadingChanged);
+    typedef QFutureWatcher<QSharedPointer<const PointIndex>> IndexWatcher;
+    connect(&m_pointIndexWatcher, &IndexWatcher::finished,
+            this, &Earth3D::swapPointIndex);
 }
 
 Earth3D::~Earth3D()
 {
+    m_pointIndexWatcher.waitForFinished();
 }
 
 FBO::Renderer *Earth3D::createRenderer() const
@@ -146,3 +179,240 @@ void Earth3D::setSphereResolution(int newResolution)
     emit sphereResolutionChanged();
     update();
 }
+
+void Earth3D::setSphereShape(SphereShape shape)
+{
+    // QML hands any number to an enum property
+    if (shape < UvSphere || shape > CubeSphere) {
+        qWarning("Earth3D: no sphere shape %d", int(shape));
+        return;
+    }
+    if (m_sphereShape == shape) {
+        return;
+    }
+    m_sphereShape = shape;
+    emit sphereShapeChanged();
+    update();
+}
+
+void Earth3D::setProceduralSphere(bool val)
+{
+    if (m_proceduralSphere == val) {
+        return;
+    }
+    m_proceduralSphere = val;
+    emit proceduralSphereChanged();
+    update();
+}
+
+void Earth3D::setLodEnabled(bool val)
+{
+    if (m_lodEnabled == val) {
+        return;
+    }
+    m_lodEnabled = val;
+    emit lodEnabledChanged();
+    update();
+}
+
+void Earth3D::setLodPixelError(double pixels)
+{
+    if (m_lodPixelError == pixels) {
+        return;
+    }
+    m_lodPixelError = pixels;
+    emit lodPixelErrorChanged();
+    update();
+}
+
+void Earth3D::setVirtualTexture(const QString &path)
+{
+    if (m_virtualTexture == path) {
+        return;
+    }
+    m_virtualTexture = path;
+    emit virtualTextureChanged();
+    update();
+}
+
+void Earth3D::setSamples(int samples)
+{
+    if (m_samples == samples) {
+        return;
+    }
+    m_samples = samples;
+    emit samplesChanged();
+    update();
+}
+
+void Earth3D::watchSphere(const QFuture<void> &future)
+{
+    m_sphereWatcher.setFuture(future);
+    // we are on the render thread here, notify from the gui thread
+    QMetaObject::invokeMethod(this, "updateSpherePending", Qt::QueuedConnection);
+}
+
+void Earth3D::watchTexture(const QFuture<void> &future)
+{
+    m_textureWatcher.setFuture(future);
+}
+
+void Earth3D::setFramesRendered(int frames)
+{
+    if (m_framesRendered == frames) {
+        return;
+    }
+    m_framesRendered = frames;
+    emit framesRenderedChanged();
+}
+
+void Earth3D::updateSpherePending()
+{
+    bool pending = !m_sphereWatcher.isFinished();
+    if (m_spherePending == pending) {
+        return;
+    }
+    m_spherePending = pending;
+    emit spherePendingChanged();
+}
+
+void Earth3D::setPatchCounts(int visible, int culled)
+{
+    if (m_visiblePatches == visible && m_culledPatches == culled) {
+        return;
+    }
+    m_visiblePatches = visible;
+    m_culledPatches = culled;
+    emit patchCountsChanged();
+}
+
+void Earth3D::setTexturePending(bool pending)
+{
+    if (m_texturePending == pending) {
+        return;
+    }
+    m_texturePending = pending;
+    emit texturePendingChanged();
+}
+
+void Earth3D::setPassTimings(const QVariantMap &timings)
+{
+    if (m_passTimings == timings) {
+        return;
+    }
+    m_passTimings = timings;
+    emit passTimingsChanged();
+}
+
+void Earth3D::setPickCamera(const QMatrix4x4 &projection, const QMatrix4x4 &modelView,
+                            const QSize &viewport)
+{
+    m_picker.setCamera(projection, modelView, viewport);
+}
+
+QVariant Earth3D::screenToLonLat(double x, double y) const
+{
+    QPointF lonLat;
+    if (!m_picker.pick(QPointF(x, y), &lonLat)) {
+        return QVariant();
+    }
+    return lonLat;
+}
+
+QVariantList Earth3D::screenToLonLatList(const QVariantList &positions) const
+{
+    QVector<QPointF> pos(positions.size());
+    for (int k = 0; k < positions.size(); k++) {
+        pos[k] = positions[k].toPointF();
+    }
+    QVector<QPointF> lonLat(pos.size());
+    QVector<bool> hit(pos.size());
+    m_picker.pick(pos.constData(), pos.size(), lonLat.data(), hit.data());
+
+    QVariantList out;
+    out.reserve(pos.size());
+    for (int k = 0; k < pos.size(); k++) {
+        out << (hit[k] ? QVariant(lonLat[k]) : QVariant());
+    }
+    return out;
+}
+
+void Earth3D::loadLines(const QString &fileName)
+{
+    m_polylineLayer.load(fileName);
+}
+
+void Earth3D::loadPoints(const QString &fileName)
+{
+    bool wasLoading = pointsLoading();
+    m_pointLoader.cancel();
+    m_pointLayer.clear();
+    if (m_pointIndex) {
+        m_pointIndex.reset();
+        emit pointIndexChanged();
+    }
+    m_pointLoader.load(fileName);
+    if (!wasLoading) {
+        emit pointsLoadingChanged();
+    }
+}
+
+void Earth3D::pointsLoaded(bool ok)
+{
+    emit pointsLoadingChanged();
+    if (ok) {
+        updatePointIndex();
+    }
+}
+
+/*!
+ * \brief Earth3D::updatePointIndex
+ * Builds on a worker from a copy of the positions, the index in use stays
+ * until the new one is done.
+ */
+void Earth3D::updatePointIndex()
+{
+    QVector<float> positions = m_pointLayer.positionData();
+    m_pointIndexWatcher.setFuture(QtConcurrent::run([positions]() {
+        QSharedPointer<PointIndex> index(new PointIndex());
+        index->build(positions);
+        return QSharedPointer<const PointIndex>(index);
+    }));
+}
+
+void Earth3D::swapPointIndex()
+{
+    QSharedPointer<const PointIndex> index = m_pointIndexWatcher.result();
+    // built before the layer was loaded again
+    if (index->count() != m_pointLayer.count()) {
+        return;
+    }
+    m_pointIndex = index;
+    emit pointIndexChanged();
+}
+
+int Earth3D::nearestPoint(double lon, double lat, double maxDegrees) const
+{
+    if (!m_pointIndex) {
+        return -1;
+    }
+    QPointF p = PointLayer::modelPosition(lon, lat);
+    return m_pointIndex->nearest(PointIndex::direction(p.x(), p.y()),
+                                 qDegreesToRadians(maxDegrees));
+}
+
+QVariantList Earth3D::pointsWithin(double lon, double lat, double radiusDegrees) const
+{
+    QVariantList out;
+    if (!m_pointIndex) {
+        return out;
+    }
+    QPointF p = PointLayer::modelPosition(lon, lat);
+    const QVector<int> points = m_pointIndex->within(PointIndex::direction(p.x(), p.y()),
+                                                     qDegreesToRadians(radiusDegrees));
+    out.reserve(points.size());
+    for (int index : points) {
+        out << index;
+    }
+    return out;
+}
@@ -1,11 +1,21 @@
 #ifndef EARTH3D_H
 #define EARTH3D_H
 
+#include <QFutureWatcher>
 #include <QQuickFramebufferObject>
+#include <QSharedPointer>
+#include <QVariantList>
+#include <QVariantMap>
+#include "globepicker.h"
+#include "pointindex.h"
+#include "pointlayer.h"
+#include "pointloader.h"
+#include "polylinelayer.h"
 
 class Earth3D : public QQuickFramebufferObject
 {
     Q_OBJECT
+    Q_ENUMS(SphereShape)
     Q_PROPERTY(double cameraXRotate
                READ cameraXRotate WRITE setCameraXRotate
                NOTIFY cameraXRotateChanged)
@@ -36,7 +46,56 @@ class Earth3D : public QQuickFramebufferObject
     Q_PROPERTY(int sphereResolution
                READ sphereResolution WRITE setSphereResolution
                NOTIFY sphereResolutionChanged)
+    Q_PROPERTY(SphereShape sphereShape
+               READ sphereShape WRITE setSphereShape
+               NOTIFY sphereShapeChanged)
+    Q_PROPERTY(bool proceduralSphere
+               READ proceduralSphere WRITE setProceduralSphere
+               NOTIFY proceduralSphereChanged)
+    Q_PROPERTY(bool lodEnabled
+               READ lodEnabled WRITE setLodEnabled
+               NOTIFY lodEnabledChanged)
+    Q_PROPERTY(double lodPixelError
+               READ lodPixelError WRITE setLodPixelError
+               NOTIFY lodPixelErrorChanged)
+    Q_PROPERTY(QString virtualTexture
+               READ virtualTexture WRITE setVirtualTexture
+               NOTIFY virtualTextureChanged)
+    Q_PROPERTY(int samples
+               READ samples WRITE setSamples
+               NOTIFY samplesChanged)
+    Q_PROPERTY(int visiblePatches
+               READ visiblePatches
+               NOTIFY patchCountsChanged)
+    Q_PROPERTY(int culledPatches
+               READ culledPatches
+               NOTIFY patchCountsChanged)
+    Q_PROPERTY(bool spherePending
+               READ spherePending
+               NOTIFY spherePendingChanged)
+    Q_PROPERTY(bool texturePending
+               READ texturePending
+               NOTIFY texturePendingChanged)
+    Q_PROPERTY(int framesRendered
+               READ framesRendered
+               NOTIFY framesRenderedChanged)
+    Q_PROPERTY(QVariantMap passTimings
+               READ passTimings
+               NOTIFY passTimingsChanged)
+    Q_PROPERTY(bool pointsLoading
+               READ pointsLoading
+               NOTIFY pointsLoadingChanged)
+    Q_PROPERTY(bool linesLoading
+               READ linesLoading
+               NOTIFY linesLoadingChanged)
 public:
+    // same values as SphereGenerator::Shape
+    enum SphereShape {
+        UvSphere,
+        Icosphere,
+        CubeSphere,
+    };
+
     Earth3D();
     ~Earth3D();
 
@@ -69,6 +128,76 @@ public:
     int sphereResolution() const { return m_sphereResolution; }
     void setSphereResolution(int newResolution);
 
+    // sphereResolution then sets the triangle budget of the shape
+    SphereShape sphereShape() const { return m_sphereShape; }
+    void setSphereShape(SphereShape shape);
+
+    bool proceduralSphere() const { return m_proceduralSphere; }
+    void setProceduralSphere(bool val);
+
+    bool lodEnabled() const { return m_lodEnabled; }
+    void setLodEnabled(bool val);
+
+    double lodPixelError() const { return m_lodPixelError; }
+    void setLodPixelError(double pixels);
+
+    // tile pyramid directory or image streamed onto the globe, empty for the
+    // ordinary texture; see TileSource::open
+    QString virtualTexture() const { return m_virtualTexture; }
+    void setVirtualTexture(const QString &path);
+
+    // MSAA samples the renderer draws with before resolving
+    int samples() const { return m_samples; }
+    void setSamples(int samples);
+
+    // patches drawn and dropped by culling in the last frame
+    int visiblePatches() const { return m_visiblePatches; }
+    int culledPatches() const { return m_culledPatches; }
+
+    bool spherePending() const { return m_spherePending; }
+    // until the texture is decoded and fully uploaded, as of the last frame
+    bool texturePending() const { return m_texturePending; }
+    // frames the renderer has drawn, stays put while nothing changes
+    int framesRendered() const { return m_framesRendered; }
+    // GPU milliseconds per render pass of a recent frame, see PassTimer
+    QVariantMap passTimings() const { return m_passTimings; }
+    // markers on the globe, filled from C++; every edit schedules a frame
+    PointLayer *pointLayer() { return &m_pointLayer; }
+
+    // replaces the markers with those of a CSV or .points file, see
+    // PointLoader; they show up while the file is read, and are indexed
+    // for the queries below once it is done
+    Q_INVOKABLE void loadPoints(const QString &fileName);
+    bool pointsLoading() const { return m_pointLoader.isLoading(); }
+    // indexes the markers again after they were edited from C++
+    void updatePointIndex();
+    // null until the first index is built
+    QSharedPointer<const PointIndex> pointIndex() const { return m_pointIndex; }
+    // marker nearest to a place on the globe no more than maxDegrees of arc
+    // away, -1 if there is none
+    Q_INVOKABLE int nearestPoint(double lon, double lat, double maxDegrees) const;
+    // markers within radiusDegrees of arc, as indices into the layer
+    Q_INVOKABLE QVariantList pointsWithin(double lon, double lat,
+                                          double radiusDegrees) const;
+
+    // coastlines, borders and routes, loaded once; see PolylineLayer
+    PolylineLayer *polylineLayer() { return &m_polylineLayer; }
+    // replaces the lines with those of a GeoJSON file, read on a worker
+    Q_INVOKABLE void loadLines(const QString &fileName);
+    bool linesLoading() const { return m_polylineLayer.isLoading(); }
+
+    // longitude and latitude in degrees of the globe at an item position,
+    // as a point, undefined off the globe; see GlobePicker
+    Q_INVOKABLE QVariant screenToLonLat(double x, double y) const;
+    // the same for a list of points
+    Q_INVOKABLE QVariantList screenToLonLatList(const QVariantList &positions) const;
+    // camera of the last synchronized frame, for picking from C++
+    const GlobePicker &picker() const { return m_picker; }
+
+    // called by the renderer during synchronize
+    void watchSphere(const QFuture<void> &future);
+    void watchTexture(const QFuture<void> &future);
+
 signals:
     void cameraXRotateChanged();
     void cameraYRotateChanged();
@@ -80,9 +209,35 @@ signals:
     void showCameraChanged();
     void showVerticesChanged();
     void sphereResolutionChanged();
+    void sphereShapeChanged();
+    void proceduralSphereChanged();
+    void lodEnabledChanged();
+    void lodPixelErrorChanged();
+    void virtualTextureChanged();
+    void samplesChanged();
+    void patchCountsChanged();
+    void spherePendingChanged();
+    void texturePendingChanged();
+    void framesRenderedChanged();
+    void passTimingsChanged();
+    void pointsLoadingChanged();
+    void pointIndexChanged();
+    void linesLoadingChanged();
 
 public slots:
 
+private slots:
+    void updateSpherePending();
+    void pointsLoaded(bool ok);
+    void swapPointIndex();
+    // queued from the renderer
+    void setFramesRendered(int frames);
+    void setTexturePending(bool pending);
+    void setPatchCounts(int visible, int culled);
+    void setPassTimings(const QVariantMap &timings);
+    void setPickCamera(const QMatrix4x4 &projection, const QMatrix4x4 &modelView,
+                       const QSize &viewport);
+
 private:
     double m_cameraXRotate;
     double m_cameraYRotate;
@@ -97,6 +252,27 @@ private:
     bool m_showVertices;
 
     int m_sphereResolution;
+    SphereShape m_sphereShape;
+    bool m_proceduralSphere;
+    bool m_lodEnabled;
+    double m_lodPixelError;
+    QString m_virtualTexture;
+    int m_samples;
+    int m_visiblePatches;
+    int m_culledPatches;
+
+    QFutureWatcher<void> m_sphereWatcher;
+    QFutureWatcher<void> m_textureWatcher;
+    bool m_spherePending;
+    bool m_texturePending;
+    int m_framesRendered;
+    QVariantMap m_passTimings;
+    GlobePicker m_picker;
+    PointLayer m_pointLayer;
+    PointLoader m_pointLoader;
+    QSharedPointer<const PointIndex> m_pointIndex;
+    QFutureWatcher<QSharedPointer<const PointIndex>> m_pointIndexWatcher;
+    PolylineLayer m_polylineLayer;
 };
 
 #endif // EARTH3D_H
@@ -1,6 +1,8 @@
-#include <QImage>
+#include <cstddef>
+#include <cstring>
 #include <QtMath>
 #include <QMatrix4x4>
+#include <QOpenGLContext>
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLFramebufferObjectFormat>
 #include "earth3d.h"
@@ -8,19 +10,35 @@
 
 #define TO_OFFSET(x) reinterpret_cast<const void*>(x)
 
+// in model space, the light never moves
+static const QVector3D LightPosition(-3, 3, 2);
+
 Earth3DRenderer::Earth3DRenderer()
-    : vbo_camera(), ebo_camera(QOpenGLBuffer::IndexBuffer)
+    : vbo_camera()
     , vbo_axis(), ebo_axis(QOpenGLBuffer::IndexBuffer)
-    , vbo_sphere(), ebo_sphere(QOpenGLBuffer::IndexBuffer), pTex_sphere(nullptr)
+    , m_spherePending(false)
+    , m_frameBlock("Frame", "frame", UniformBlock::FrameBinding)
+    , m_materialBlock("Material", "material", UniformBlock::MaterialBinding)
 {
-    showVertices = showCamera = useCamera2 = false;
+    showVertices = showCamera = useCamera2 = proceduralSphere = lodEnabled = false;
     resolution = 360;
+    shape = SphereGenerator::UvSphere;
+    m_pixelScale = 1.0;
+    m_visiblePatches = m_culledPatches = 0;
+    m_sphereDirty = true;
+    m_samples = 4;
+    m_frames = 0;
+    m_virtualTextureDirty = false;
+    m_feedbackPass = false;
+    m_textureWatched = false;
+    m_texturePending = true;
+    m_pointReference = 1.0;
+    m_linePixelError = 1.0;
     initialize();
 }
 
 Earth3DRenderer::~Earth3DRenderer()
 {
-    if (pTex_sphere) { delete pTex_sphere; }
 }
 
 void Earth3DRenderer::initialize()
@@ -30,40 +48,90 @@ void Earth3DRenderer::initialize()
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
 
-    // Simple program use solid color
-    m_colorProg.addShaderFromSourceFile(QOpenGLShader::Vertex,
-                                        QStringLiteral(":/shaders/coloring.vert"));
-    m_colorProg.addShaderFromSourceFile(QOpenGLShader::Fragment,
-                                        QStringLiteral(":/shaders/coloring.frag"));
-    m_colorProg.link();
+    // Simple program use solid color, programs are shared between renderers
+    // and take the camera and material from m_frameBlock and m_materialBlock
+    auto shaders = ShaderCache::instance();
+    auto dialect = ShaderCache::preferredDialect();
+    m_colorProg = shaders->program(QStringLiteral(":/shaders/coloring.vert"),
+                                   QStringLiteral(":/shaders/coloring.frag"), dialect);
 
-    vertex_loc_0 = m_colorProg.attributeLocation("vPosition");
-    color_loc_0 = m_colorProg.attributeLocation("vColor");
-    mv_matrix_loc_0 = m_colorProg.uniformLocation("vModelView");
-    proj_matrix_loc_0 = m_colorProg.uniformLocation("vProjection");
+    vertex_loc_0 = m_colorProg->attributeLocation("vPosition");
+    color_loc_0 = m_colorProg->attributeLocation("vColor");
+    model_matrix_loc_0 = m_colorProg->uniformLocation("vModel");
 
     // Program with texture and lighting (Gourand algorithm)
-    m_texLightProg.addShaderFromSourceFile(QOpenGLShader::Vertex,
-                                           QStringLiteral(":/shaders/texlighting.vert"));
-    m_texLightProg.addShaderFromSourceFile(QOpenGLShader::Fragment,
-                                           QStringLiteral(":/shaders/texlighting.frag"));
-    m_texLightProg.link();
-
-    vertex_loc_1 = m_texLightProg.attributeLocation("vPosition");
-    texcoord_loc_1 = m_texLightProg.attributeLocation("vTexCoord");
-    normal_loc_1 = m_texLightProg.attributeLocation("vNormal");
-    mv_matrix_loc_1 = m_texLightProg.uniformLocation("vModelView");
-    proj_matrix_loc_1 = m_texLightProg.uniformLocation("vProjection");
-    nm_matrix_loc_1 = m_texLightProg.uniformLocation("vNormalMatrix");
-    lpos_loc_1 = m_texLightProg.uniformLocation("vLightPosition");
-
-    ami_color_loc_1 = m_texLightProg.uniformLocation("fAmbientColor");
-    dif_color_loc_1 = m_texLightProg.uniformLocation("fDiffuseColor");
-    spec_color_loc_1 = m_texLightProg.uniformLocation("fSpecularColor");
-    ami_ref_loc_1 = m_texLightProg.uniformLocation("fAmbientReflection");
-    dif_ref_loc_1 = m_texLightProg.uniformLocation("fDiffuseReflection");
-    spec_ref_loc_1 = m_texLightProg.uniformLocation("fSpecularReflection");
-    shininess_loc_1 = m_texLightProg.uniformLocation("fShininess");
+    m_texLightProg = shaders->program(QStringLiteral(":/shaders/texlighting.vert"),
+                                      QStringLiteral(":/shaders/texlighting.frag"),
+                                      dialect);
+
+    vertex_loc_1 = m_texLightProg->attributeLocation("vPosition");
+    texcoord_loc_1 = m_texLightProg->attributeLocation("vTexCoord");
+    normal_loc_1 = m_texLightProg->attributeLocation("vNormal");
+    model_matrix_loc_1 = m_texLightProg->uniformLocation("vModel");
+
+    // Same lighting, but the sphere is computed from gl_VertexID
+    if (ShaderCache::hasModernGlsl()) {
+        m_proceduralProg = shaders->program(
+                               QStringLiteral(":/shaders/texlighting_procedural.vert"),
+                               QStringLiteral(":/shaders/texlighting.frag"),
+                               ShaderCache::Modern);
+    }
+    if (m_proceduralProg && m_proceduralProg->isLinked()) {
+        model_matrix_loc_2 = m_proceduralProg->uniformLocation("vModel");
+        resolution_loc_2 = m_proceduralProg->uniformLocation("vResolution");
+    }
+
+    // Same lighting again, on one level of detail patch at a time
+    m_patchProg = shaders->program(QStringLiteral(":/shaders/texlighting_patch.vert"),
+                                   QStringLiteral(":/shaders/texlighting.frag"), dialect);
+
+    grid_loc_3 = m_patchProg->attributeLocation("vGrid");
+    model_matrix_loc_3 = m_patchProg->uniformLocation("vModel");
+    patch_loc_3 = m_patchProg->uniformLocation("vPatch");
+    morph_loc_3 = m_patchProg->uniformLocation("vMorph");
+    eye_loc_3 = m_patchProg->uniformLocation("vEye");
+
+    // Markers of the point layer, instanced quads or point sprites
+    m_pointProg = shaders->program(QStringLiteral(":/shaders/points.vert"),
+                                   m_points.method() == PointDrawer::Instanced
+                                   ? QStringLiteral(":/shaders/points.frag")
+                                   : QStringLiteral(":/shaders/points_sprite.frag"),
+                                   dialect);
+
+    PointDrawer::Locations points;
+    points.corner = m_pointProg->attributeLocation("vCorner");
+    points.position = m_pointProg->attributeLocation("vLonLat");
+    points.color = m_pointProg->attributeLocation("vColor");
+    points.size = m_pointProg->attributeLocation("vSize");
+    m_points.setLocations(points);
+    corner_loc_4 = points.corner;
+    model_matrix_loc_4 = m_pointProg->uniformLocation("vModel");
+    viewport_loc_4 = m_pointProg->uniformLocation("vViewport");
+    ref_distance_loc_4 = m_pointProg->uniformLocation("vReferenceDistance");
+
+    // Lines of the polyline layer, instanced quads or triangles
+    m_lineProg = shaders->program(QStringLiteral(":/shaders/lines.vert"),
+                                  QStringLiteral(":/shaders/lines.frag"), dialect);
+
+    PolylineDrawer::Locations lines;
+    lines.corner = m_lineProg->attributeLocation("vCorner");
+    lines.start = m_lineProg->attributeLocation("vStart");
+    lines.end = m_lineProg->attributeLocation("vEnd");
+    lines.color = m_lineProg->attributeLocation("vColor");
+    lines.width = m_lineProg->attributeLocation("vWidth");
+    m_lines.setLocations(lines);
+    model_matrix_loc_5 = m_lineProg->uniformLocation("vModel");
+    viewport_loc_5 = m_lineProg->uniformLocation("vViewport");
+    lift_loc_5 = m_lineProg->uniformLocation("vLift");
+
+    // the sphere has a single material, which never changes
+    MaterialUniforms material = {
+        { 100 / 255.0f, 100 / 255.0f, 100 / 255.0f, 1 },
+        { 128 / 255.0f, 128 / 255.0f, 128 / 255.0f, 1 },
+        { 1, 1, 1, 1 },
+        { 1, 1, 1, 100 },
+    };
+    m_materialBlock.setData(material);
 
     createGeometry();
 }
@@ -72,6 +140,8 @@ void Earth3DRenderer::createGeometry()
 {
     createAxis();
     createCamera();
+    createPatchGrid();
+    createSphereTexture();
     // can safely comment out here.
     // at least one sync is done before any render
     // createSphere is called at that time.
@@ -80,9 +150,9 @@ void Earth3DRenderer::createGeometry()
 
 QOpenGLFramebufferObject *Earth3DRenderer::createFramebufferObject(const QSize &size)
 {
+    // single sampled, m_msaa resolves into it
     QOpenGLFramebufferObjectFormat format;
     format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
-    format.setSamples(4);
     return new QOpenGLFramebufferObject(size, format);
 }
 
@@ -97,6 +167,10 @@ void Earth3DRenderer::synchronize(QQuickFramebufferObject *item)
     showCamera = earth3d->showCamera();
     useCamera2 = earth3d->useCamera2();
     showVertices = earth3d->showVertices();
+    proceduralSphere = earth3d->proceduralSphere();
+    lodEnabled = earth3d->lodEnabled();
+    m_samples = earth3d->samples();
+    m_lod.setPixelError(earth3d->lodPixelError());
     updateCamera(0, earth3d->cameraXRotate(), earth3d->cameraYRotate(),
                  earth3d->cameraDistance());
     if (useCamera2) {
@@ -105,11 +179,49 @@ void Earth3DRenderer::synchronize(QQuickFramebufferObject *item)
     }
     if (resolution != earth3d->sphereResolution()) {
         resolution = earth3d->sphereResolution();
-        createSphere();
+        m_sphereDirty = true;
+    }
+    if (shape != SphereGenerator::Shape(earth3d->sphereShape())) {
+        shape = SphereGenerator::Shape(earth3d->sphereShape());
+        m_sphereDirty = true;
+    }
+    if (m_virtualTexturePath != earth3d->virtualTexture()) {
+        m_virtualTexturePath = earth3d->virtualTexture();
+        m_virtualTextureDirty = true;
+    }
+    if (m_sphereDirty && needsSphereMesh()) {
+        requestSphere();
+        earth3d->watchSphere(m_pendingSphere);
+        m_sphereDirty = false;
     }
 
+    if (!m_textureWatched) {
+        earth3d->watchTexture(pTex_sphere->decoded());
+        m_textureWatched = true;
+    }
+
+    // only the chunks of points edited since the last frame
+    PointLayer *layer = earth3d->pointLayer();
+    m_points.sync(layer);
+    m_pointReference = layer->referenceDistance();
+    // the lines only when they were loaded again
+    m_lines.sync(earth3d->polylineLayer());
+    m_linePixelError = earth3d->polylineLayer()->pixelError();
+
+    m_item = earth3d;
+
     // update view matrix
     updateViewMatrix();
+
+    // the camera just synchronized, for picking on the gui thread
+    GlobePicker picker(GlobePicker::Sphere);
+    picker.setCamera(m_projMatrix, m_viewMatrix, m_viewportSize);
+    if (picker != earth3d->picker()) {
+        QMetaObject::invokeMethod(earth3d, "setPickCamera", Qt::QueuedConnection,
+                                  Q_ARG(QMatrix4x4, m_projMatrix),
+                                  Q_ARG(QMatrix4x4, m_viewMatrix),
+                                  Q_ARG(QSize, m_viewportSize));
+    }
 }
 
 void Earth3DRenderer::updateProjection(int width, int height)
@@ -123,6 +235,7 @@ void Earth3DRenderer::updateProjection(int width, int height)
         m_projMatrix.perspective(60.0f,
                                  size.width() / float(h),
                                  0.001f, 1000.0f);
+        m_pixelScale = h / (2 * qTan(qDegreesToRadians(30.0)));
         glViewport(0, 0, size.width(), size.height());
     }
 }
@@ -144,23 +257,137 @@ void Earth3DRenderer::updateViewMatrix()
     m_viewMatrix.lookAt(m_cameraPos[idx], QVector3D(0, 0, 0), m_cameraUp[idx]);
 }
 
+/*!
+ * \brief Earth3DRenderer::updateFrameBlock
+ * Hand the camera and the light to the programs, the block only uploads
+ * them when they moved since the last frame.
+ */
+void Earth3DRenderer::updateFrameBlock()
+{
+    FrameUniforms frame;
+    memcpy(frame.projection, m_projMatrix.constData(), sizeof(frame.projection));
+    memcpy(frame.view, m_viewMatrix.constData(), sizeof(frame.view));
+    QVector3D light = m_viewMatrix * LightPosition;
+    frame.lightPosition[0] = light.x();
+    frame.lightPosition[1] = light.y();
+    frame.lightPosition[2] = light.z();
+    frame.lightPosition[3] = 1;
+    m_frameBlock.setData(frame);
+}
+
+/*!
+ * \brief Earth3DRenderer::updateCuller
+ * \return the eye position in the model space of the sphere
+ */
+QVector3D Earth3DRenderer::updateCuller(const QMatrix4x4 &model)
+{
+    QMatrix4x4 mv = m_viewMatrix * model;
+    QVector3D eye = mv.inverted() * QVector3D(0, 0, 0);
+    // sphere meshes and patches are all unit sized
+    m_culler.setView(m_projMatrix * mv, eye, 1.0);
+    return eye;
+}
+
 void Earth3DRenderer::render()
 {
+    m_passTimer.beginFrame();
+    // swap in the new sphere once its generation is done
+    if (m_spherePending && m_pendingSphere.isFinished()) {
+        createSphere();
+    }
+    bool streaming = pTex_sphere->advance();
+    if (m_virtualTextureDirty) {
+        createVirtualTexture();
+    }
+    updateFrameBlock();
+    if (m_virtualTexture) {
+        PassTimer::Scope pass(m_passTimer, "feedback");
+        paintFeedback();
+    }
+
+    m_msaa.bind(framebufferObject(), m_samples);
     glDepthMask(true);
     glClearColor(0.5f, 0.5f, 0.7f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // actual paint here
     //    paintAxis();
-    paintSphere();
+    {
+        PassTimer::Scope pass(m_passTimer, "sphere");
+        paintSphere();
+    }
+    if (!m_lines.isEmpty()) {
+        PassTimer::Scope pass(m_passTimer, "lines");
+        paintLines();
+    }
+    if (m_points.count() > 0) {
+        PassTimer::Scope pass(m_passTimer, "points");
+        paintPoints();
+    }
     if (showCamera) {
+        PassTimer::Scope pass(m_passTimer, "camera");
         paintCamera();
     }
     if (showVertices) {
+        PassTimer::Scope pass(m_passTimer, "vertices");
         paintSphereVertices();
     }
+    if (m_msaa.isActive()) {
+        PassTimer::Scope pass(m_passTimer, "resolve");
+        m_msaa.resolve(framebufferObject());
+    }
+    m_passTimer.endFrame();
+
+    // no update() here: the item asks for frames when its state changes,
+    // only textures and tiles still streaming in keep the frames coming,
+    // and one more frame for timings still on the GPU
+    m_texturePending = streaming || !pTex_sphere->decoded().isFinished()
+                       || (m_virtualTexture && m_virtualTexture->isBusy());
+    if (streaming || (m_virtualTexture && m_virtualTexture->isBusy())
+        || m_passTimer.needsFrame()) {
+        update();
+    }
+    m_frames++;
+    publish();
+}
+
+/*!
+ * \brief Earth3DRenderer::publish
+ * Hand the counters of the frame just drawn to the item. Done here rather
+ * than in the next synchronize, which never comes once the view is idle.
+ */
+void Earth3DRenderer::publish()
+{
+    if (!m_item) {
+        return;
+    }
+    // queued, and the item ignores values it already has
+    QMetaObject::invokeMethod(m_item, "setFramesRendered", Qt::QueuedConnection,
+                              Q_ARG(int, m_frames));
+    QMetaObject::invokeMethod(m_item, "setPatchCounts", Qt::QueuedConnection,
+                              Q_ARG(int, m_visiblePatches), Q_ARG(int, m_culledPatches));
+    QMetaObject::invokeMethod(m_item, "setTexturePending", Qt::QueuedConnection,
+                              Q_ARG(bool, m_texturePending));
+    QMetaObject::invokeMethod(m_item, "setPassTimings", Qt::QueuedConnection,
+                              Q_ARG(QVariantMap, m_passTimer.timings()));
+}
 
-    update();
+/*!
+ * \brief Earth3DRenderer::paintFeedback
+ * Draw the sphere into the feedback buffer of the virtual texture, which
+ * then requests the tiles it saw and uploads the ones that arrived.
+ */
+void Earth3DRenderer::paintFeedback()
+{
+    m_feedbackPass = true;
+    m_virtualTexture->beginFeedback(framebufferObject()->size());
+    paintSphere();
+    m_virtualTexture->endFeedback();
+    m_feedbackPass = false;
+
+    framebufferObject()->bind();
+    glViewport(0, 0, framebufferObject()->width(), framebufferObject()->height());
+    m_virtualTexture->update();
 }
 
 void Earth3DRenderer::paintAxis()
@@ -169,9 +396,9 @@ void Earth3DRenderer::paintAxis()
     // Model transform
     m.scale(0.5);
 
-    m_colorProg.bind();
-    m_colorProg.setUniformValue(proj_matrix_loc_0, m_projMatrix);
-    m_colorProg.setUniformValue(mv_matrix_loc_0, m_viewMatrix * m);
+    m_colorProg->bind();
+    m_frameBlock.bind(m_colorProg.data());
+    m_colorProg->setUniformValue(model_matrix_loc_0, m);
 
     vao_axis.bind();
     //    glEnable(GL_LINE_SMOOTH);
@@ -180,7 +407,7 @@ void Earth3DRenderer::paintAxis()
     //    glDisable(GL_LINE_SMOOTH);
 
     vao_axis.release();
-    m_colorProg.release();
+    m_colorProg->release();
 }
 
 void Earth3DRenderer::paintCamera()
@@ -192,113 +419,220 @@ void Earth3DRenderer::paintCamera()
     m.scale(0.1);
     m = m_cameraTransform[0] * m;
 
-    m_colorProg.bind();
-    m_colorProg.setUniformValue(proj_matrix_loc_0, m_projMatrix);
-    m_colorProg.setUniformValue(mv_matrix_loc_0, m_viewMatrix * m);
+    m_colorProg->bind();
+    m_frameBlock.bind(m_colorProg.data());
+    m_colorProg->setUniformValue(model_matrix_loc_0, m);
 
     vao_camera.bind();
-    // draw box and cylinder with strip
-    //    glEnable(GL_PRIMITIVE_RESTART);
-    //    glPrimitiveRestartIndex(0xFFFFFFFF);
-    //    glDrawElements(GL_TRIANGLE_STRIP, stripCount, GL_UNSIGNED_INT, TO_OFFSET(0));
-    //    glDisable(GL_PRIMITIVE_RESTART);
+    // box, cylinder and cap are all strips
+    cameraStrips.draw();
 
-    int lastIdx = 0;
-    for (auto idx : camera_restartPoints) {
-        int count = idx - lastIdx;
-        glDrawElements(GL_TRIANGLE_STRIP, count, GL_UNSIGNED_INT,
-                       TO_OFFSET(lastIdx * sizeof(GLuint)));
-        lastIdx = idx + 1;
-    }
+    vao_camera.release();
+    m_colorProg->release();
+}
+
+bool Earth3DRenderer::useProceduralSphere() const
+{
+    // the shader only knows the UV sphere
+    return proceduralSphere && shape == SphereGenerator::UvSphere
+           && m_proceduralProg && m_proceduralProg->isLinked();
+}
 
-    // draw cycle
-    glDrawElements(GL_TRIANGLE_FAN, fanCount, GL_UNSIGNED_INT,
-                   TO_OFFSET(stripCount * sizeof(GLuint)));
+bool Earth3DRenderer::useLodSphere() const
+{
+    return lodEnabled && m_patchProg->isLinked();
+}
 
-    vao_camera.release();
-    m_colorProg.release();
+/*!
+ * \brief Earth3DRenderer::needsSphereMesh
+ * The procedural and patch paths need no mesh, except for showing the vertices
+ */
+bool Earth3DRenderer::needsSphereMesh() const
+{
+    return showVertices || !(useProceduralSphere() || useLodSphere());
 }
 
 void Earth3DRenderer::paintSphere()
 {
+    if (useLodSphere()) {
+        paintLodSphere();
+        return;
+    }
+    // the procedural sphere is not cut into patches
+    m_visiblePatches = m_culledPatches = 0;
+    if (useProceduralSphere()) {
+        paintProceduralSphere();
+        return;
+    }
+    if (!m_sphereMesh) {
+        return;
+    }
+
     QMatrix4x4 m;
     // Model transform
     //    m.scale(0.5);
 
-    // Lighting position
-    QMatrix4x4 lightTransform;
-    //    lightTransform.rotate(0, 0, 1, 0);
-    QVector3D lightPos = lightTransform * QVector3D(-3, 3, 2);
-
-    m_texLightProg.bind();
-    m_texLightProg.setUniformValue(proj_matrix_loc_1, m_projMatrix);
-    m_texLightProg.setUniformValue(mv_matrix_loc_1, m_viewMatrix * m);
-    m_texLightProg.setUniformValue(nm_matrix_loc_1, (m_viewMatrix * m).normalMatrix());
-    m_texLightProg.setUniformValue(lpos_loc_1, m_viewMatrix * lightPos);
-
-    m_texLightProg.setUniformValue(ami_color_loc_1, QColor(100, 100, 100));
-    m_texLightProg.setUniformValue(dif_color_loc_1, QColor(128, 128, 128));
-    m_texLightProg.setUniformValue(spec_color_loc_1, QColor(255, 255, 255));
-    m_texLightProg.setUniformValue(ami_ref_loc_1, 1.0f);
-    m_texLightProg.setUniformValue(dif_ref_loc_1, 1.0f);
-    m_texLightProg.setUniformValue(spec_ref_loc_1, 1.0f);
-    m_texLightProg.setUniformValue(shininess_loc_1, 100.0f);
+    m_texLightProg->bind();
+    m_frameBlock.bind(m_texLightProg.data());
+    m_materialBlock.bind(m_texLightProg.data());
+    m_texLightProg->setUniformValue(model_matrix_loc_1, m);
+
+    // drop the patches behind the horizon or out of the frustum
+    updateCuller(m);
+    const QVector<SphereGenerator::Patch> &patches = m_sphereMesh->patches();
+    m_patchVisible.resize(patches.size());
+    m_visiblePatches = 0;
+    for (int k = 0; k < patches.size(); k++) {
+        const SphereGenerator::Patch &p = patches[k];
+        m_patchVisible[k] = m_culler.isVisible(p.boxMin, p.boxMax, p.axis, p.coneAngle);
+        m_visiblePatches += m_patchVisible[k];
+    }
+    m_culledPatches = patches.size() - m_visiblePatches;
 
     vao_sphere.bind();
-    pTex_sphere->bind();
+    bindSphereTexture(*m_texLightProg);
     // draw
-    //    glEnable(GL_PRIMITIVE_RESTART);
-    //    glPrimitiveRestartIndex(0xFFFFFFFF);
-    //    glDrawElements(GL_TRIANGLE_STRIP, sphere.indices().size(), GL_UNSIGNED_INT, TO_OFFSET(0));
-    //    glDisable(GL_PRIMITIVE_RESTART);
-    int lastIdx = 0;
-    for (auto idx : sphere.restartPoints()) {
-        int count = idx - lastIdx;
-        glDrawElements(GL_TRIANGLE_STRIP, count, GL_UNSIGNED_INT,
-                       TO_OFFSET(lastIdx * sizeof(GLuint)));
-        lastIdx = idx + 1;
-    }
-
-    pTex_sphere->release();
+    m_sphereMesh->strips().drawGroups(m_patchVisible);
+
+    releaseSphereTexture();
     vao_sphere.release();
-    m_texLightProg.release();
+    m_texLightProg->release();
+}
+
+void Earth3DRenderer::paintProceduralSphere()
+{
+    QMatrix4x4 m;
+    // Model transform
+    //    m.scale(0.5);
+
+    m_proceduralProg->bind();
+    m_frameBlock.bind(m_proceduralProg.data());
+    m_materialBlock.bind(m_proceduralProg.data());
+    m_proceduralProg->setUniformValue(model_matrix_loc_2, m);
+    m_proceduralProg->setUniformValue(resolution_loc_2, resolution);
+
+    // core profiles refuse to draw without a vertex array object bound
+    if (!vao_sphere_proc.isCreated()) { vao_sphere_proc.create(); }
+    vao_sphere_proc.bind();
+    bindSphereTexture(*m_proceduralProg);
+    // 2 * res * res quads, 6 vertices each
+    glDrawArrays(GL_TRIANGLES, 0, 12 * resolution * resolution);
+
+    releaseSphereTexture();
+    vao_sphere_proc.release();
+    m_proceduralProg->release();
+}
+
+void Earth3DRenderer::paintLodSphere()
+{
+    QMatrix4x4 m;
+    // Model transform
+    //    m.scale(0.5);
+
+    // pick the visible patches for this frame from the eye in model space
+    QVector3D eye = updateCuller(m);
+    m_lod.select(eye, m_pixelScale, &m_culler);
+    m_visiblePatches = m_lod.patches().size();
+    m_culledPatches = m_lod.culledCount();
+
+    m_patchProg->bind();
+    m_frameBlock.bind(m_patchProg.data());
+    m_materialBlock.bind(m_patchProg.data());
+    m_patchProg->setUniformValue(model_matrix_loc_3, m);
+    m_patchProg->setUniformValue(eye_loc_3, eye);
+
+    vao_patch.bind();
+    bindSphereTexture(*m_patchProg);
+    // same grid for every patch, only the placement changes
+    for (const GlobeLod::Patch &p : m_lod.patches()) {
+        m_patchProg->setUniformValue(patch_loc_3,
+                                    QVector4D(p.lon, p.lat, p.size / m_lod.gridSize(),
+                                              m_lod.skirtDepth(p.level)));
+        m_patchProg->setUniformValue(morph_loc_3, QVector2D(p.morphStart, p.morphEnd));
+        patchStrips.draw();
+    }
+
+    releaseSphereTexture();
+    vao_patch.release();
+    m_patchProg->release();
+}
+
+/*!
+ * \brief Earth3DRenderer::paintLines
+ * The level is picked so that a pixel at the nearest point of the globe
+ * covers more than the error of its simplification.
+ */
+void Earth3DRenderer::paintLines()
+{
+    int idx = useCamera2 ? 1 : 0;
+    double altitude = qMax(m_cameraDistance[idx] - 1.0, 1e-6);
+    int level = PolylineLayer::level(m_linePixelError * altitude / m_pixelScale);
+
+    QMatrix4x4 m;
+    // Model transform, same as the sphere
+
+    m_lineProg->bind();
+    m_frameBlock.bind(m_lineProg.data());
+    m_lineProg->setUniformValue(model_matrix_loc_5, m);
+    m_lineProg->setUniformValue(viewport_loc_5, QVector2D(m_viewportSize.width(),
+                                                          m_viewportSize.height()));
+    // chords of a level stay within its tolerance of the globe
+    m_lineProg->setUniformValue(lift_loc_5,
+                                GLfloat(1.0005 + PolylineLayer::tolerance(level)));
+
+    m_lines.draw(level);
+
+    m_lineProg->release();
+}
+
+void Earth3DRenderer::paintPoints()
+{
+    QMatrix4x4 m;
+    // Model transform, same as the sphere
+
+    m_pointProg->bind();
+    m_frameBlock.bind(m_pointProg.data());
+    m_pointProg->setUniformValue(model_matrix_loc_4, m);
+    m_pointProg->setUniformValue(viewport_loc_4, QVector2D(m_viewportSize.width(),
+                                                           m_viewportSize.height()));
+    m_pointProg->setUniformValue(ref_distance_loc_4, GLfloat(m_pointReference));
+    if (m_points.method() == PointDrawer::Sprites && corner_loc_4 >= 0) {
+        // no quads, every point is a sprite centered on its position
+        m_pointProg->setAttributeValue(corner_loc_4, QVector2D(0, 0));
+    }
+
+    m_points.draw();
+
+    m_pointProg->release();
 }
 
 void Earth3DRenderer::paintSphereVertices()
 {
+    if (!m_sphereMesh) {
+        return;
+    }
+
     QMatrix4x4 m;
     // Model transform
     m.scale(1.001);
 
-    m_colorProg.bind();
-    m_colorProg.setUniformValue(proj_matrix_loc_0, m_projMatrix);
-    m_colorProg.setUniformValue(mv_matrix_loc_0, m_viewMatrix * m);
-    m_colorProg.setAttributeValue(color_loc_0, QColor(255, 128, 0));
+    m_colorProg->bind();
+    m_frameBlock.bind(m_colorProg.data());
+    m_colorProg->setUniformValue(model_matrix_loc_0, m);
+    m_colorProg->setAttributeValue(color_loc_0, QColor(255, 128, 0));
 
     vao_sphere_fw.bind();
     // draw
 #if defined(Q_OS_ANDROID) || defined(TEST_ANDROID_LOCAL)
-    int lastIdx = 0;
-    for (auto idx : sphere.restartPoints(true)) {
-        int count = idx - lastIdx;
-        glDrawElements(GL_LINE_STRIP, count, GL_UNSIGNED_INT,
-                       TO_OFFSET(lastIdx * sizeof(GLuint)));
-        lastIdx = idx + 1;
-    }
+    m_sphereMesh->wireStrips().draw();
 #else
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    int lastIdx = 0;
-    for (auto idx : sphere.restartPoints()) {
-        int count = idx - lastIdx;
-        glDrawElements(GL_TRIANGLE_STRIP, count, GL_UNSIGNED_INT,
-                       TO_OFFSET(lastIdx * sizeof(GLuint)));
-        lastIdx = idx + 1;
-    }
+    m_sphereMesh->strips().draw();
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 #endif
 
     vao_sphere_fw.release();
-    m_colorProg.release();
+    m_colorProg->release();
 }
 
 void Earth3DRenderer::createAxis()
@@ -340,8 +674,8 @@ void Earth3DRenderer::createAxis()
                           GL_FALSE, 0, // normalize, stride
                           TO_OFFSET(sizeof(vertices)) // offset
                          );
-    m_colorProg.enableAttributeArray(vertex_loc_0);
-    m_colorProg.enableAttributeArray(color_loc_0);
+    m_colorProg->enableAttributeArray(vertex_loc_0);
+    m_colorProg->enableAttributeArray(color_loc_0);
 
     vao_axis.release();
 }
@@ -351,7 +685,6 @@ void Earth3DRenderer::createCamera()
     QVector<QVector3D> vertices;
     QVector<QVector3D> colors;
     QVector<GLuint> indices;
-    camera_restartPoints.clear();
 
     // first the rectagular box
     vertices << QVector3D(1, 0.5, 0) << QVector3D(1, 0.5, -0.5)
@@ -366,7 +699,6 @@ void Earth3DRenderer::createCamera()
             << 0xFFFFFFFF
             << 3 << 5 << 6 << 0 << 7 << 1 << 4 << 2
             << 0xFFFFFFFF;
-    camera_restartPoints << 8 << 17;
     // then generate a cylinder
     int count = vertices.size();
     for (int i = 0; i <= 360; i++) {
@@ -378,32 +710,31 @@ void Earth3DRenderer::createCamera()
         indices.append(count++);
         indices.append(count++);
     }
-    camera_restartPoints << indices.size();
     indices << 0xFFFFFFFF;
-    stripCount = indices.size();
-    // then a cycle
+    // then a cycle, as a strip walking the rim backwards through the center:
+    // r360, c, r359, c, ... r0 gives every fan triangle plus degenerate ones
+    GLuint center = count++;
     vertices << QVector3D(0, 0, 0.3);
     colors << QVector3D(1, 0.5, 0);
-    indices << count++;
     for (int i = 0; i <= 360; i++) {
         double alpha = (double) i / 360 * 2 * M_PI;
         double x = 0.4 * qCos(alpha);
         double y = 0.4 * qSin(alpha);
         vertices << QVector3D(x, y, 0.3);
         colors << QVector3D(1, 0.5, 0);
-        indices << count++;
     }
-    fanCount = indices.size() - stripCount;
+    for (int i = 360; i >= 0; i--) {
+        indices << center + 1 + i;
+        if (i > 0) {
+            indices << center;
+        }
+    }
 
     if (vao_camera.isCreated()) { vao_camera.destroy(); }
     vao_camera.create();
     vao_camera.bind();
 
-    if (ebo_camera.isCreated()) { ebo_camera.destroy(); }
-    ebo_camera.create();
-    ebo_camera.bind();
-    ebo_camera.setUsagePattern(QOpenGLBuffer::StaticDraw);
-    ebo_camera.allocate(indices.constData(), indices.size() * sizeof(GLuint));
+    cameraStrips.setStrips(GL_TRIANGLE_STRIP, indices.constData(), indices.size());
 
     vbo_camera.create();
     vbo_camera.bind();
@@ -422,74 +753,172 @@ void Earth3DRenderer::createCamera()
                           GL_FALSE, 0, // normalize, stride
                           TO_OFFSET(vertices.size() * sizeof(QVector3D)) // offset
                          );
-    m_colorProg.enableAttributeArray(vertex_loc_0);
-    m_colorProg.enableAttributeArray(color_loc_0);
+    m_colorProg->enableAttributeArray(vertex_loc_0);
+    m_colorProg->enableAttributeArray(color_loc_0);
 
     vao_camera.release();
 }
 
-void Earth3DRenderer::createSphere()
+void Earth3DRenderer::createPatchGrid()
 {
-    sphere.generate(1.0, resolution);
+    if (!m_patchProg->isLinked()) {
+        return;
+    }
 
-    if (!vao_sphere.isCreated()) { vao_sphere.create(); }
-    vao_sphere.bind();
+    QVector<float> vertices = GlobeLod::gridVertices(m_lod.gridSize());
+    QVector<uint> indices = GlobeLod::gridIndices(m_lod.gridSize());
 
-    if (!ebo_sphere.isCreated()) { ebo_sphere.create(); }
-    ebo_sphere.bind();
-    ebo_sphere.setUsagePattern(QOpenGLBuffer::StaticDraw);
-    ebo_sphere.allocate(sphere.indices().constData(), sphere.indexDataLength());
-
-    if (!vbo_sphere.isCreated()) { vbo_sphere.create(); }
-    vbo_sphere.bind();
-    vbo_sphere.setUsagePattern(QOpenGLBuffer::StaticDraw);
-    vbo_sphere.allocate(sphere.vertexDataLength()
-                        + sphere.normalDataLength()
-                        + sphere.texcoordDataLength());
-    int offset = 0;
-    vbo_sphere.write(offset, sphere.vertices().constData(), sphere.vertexDataLength());
-    glVertexAttribPointer(vertex_loc_1,
-                          3, GL_FLOAT, // tupleSize, type
-                          GL_FALSE, 0, // normalize, stride
-                          TO_OFFSET(offset) // offset
-                         );
-    offset += sphere.vertexDataLength();
-    vbo_sphere.write(offset, sphere.texcoords().constData(), sphere.texcoordDataLength());
-    glVertexAttribPointer(texcoord_loc_1,
-                          2, GL_FLOAT, // tupleSize, type
-                          GL_FALSE, 0, // normalize, stride
-                          TO_OFFSET(offset) // offset
-                         );
-    offset += sphere.texcoordDataLength();
-    vbo_sphere.write(offset, sphere.normals().constData(), sphere.normalDataLength());
-    glVertexAttribPointer(normal_loc_1,
+    if (vao_patch.isCreated()) { vao_patch.destroy(); }
+    vao_patch.create();
+    vao_patch.bind();
+
+    patchStrips.setStrips(GL_TRIANGLE_STRIP, indices.constData(), indices.size(),
+                          GlobeLod::restartIndex());
+
+    vbo_patch.create();
+    vbo_patch.bind();
+    vbo_patch.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    vbo_patch.allocate(vertices.constData(), vertices.size() * sizeof(float));
+    glVertexAttribPointer(grid_loc_3,
                           3, GL_FLOAT, // tupleSize, type
                           GL_FALSE, 0, // normalize, stride
-                          TO_OFFSET(offset) // offset
+                          TO_OFFSET(0) // offset
                          );
-    m_texLightProg.enableAttributeArray(vertex_loc_1);
-    m_texLightProg.enableAttributeArray(texcoord_loc_1);
-    m_texLightProg.enableAttributeArray(normal_loc_1);
+    m_patchProg->enableAttributeArray(grid_loc_3);
 
-    vao_sphere.release();
+    vao_patch.release();
+}
+
+void Earth3DRenderer::createSphereTexture()
+{
+    if (pTex_sphere.isNull())
+        pTex_sphere = TextureCache::instance()->texture(
+                          QStringLiteral(":/assets/land_shallow_topo_2048.png"));
+}
+
+void Earth3DRenderer::createVirtualTexture()
+{
+    m_virtualTexture.reset();
+    if (!m_virtualTexturePath.isEmpty()) {
+        TileSource *source = TileSource::open(m_virtualTexturePath);
+        if (source && source->format() != QImage::Format_RGBA8888) {
+            qWarning("Earth3DRenderer: %s is not imagery",
+                     qPrintable(m_virtualTexturePath));
+            delete source;
+        } else if (source) {
+            m_virtualTexture.reset(new VirtualTexture(source));
+        } else {
+            qWarning("Earth3DRenderer: no tiles at %s", qPrintable(m_virtualTexturePath));
+        }
+    }
+    m_virtualTextureDirty = false;
+}
+
+void Earth3DRenderer::bindSphereTexture(QOpenGLShaderProgram &prog)
+{
+    if (m_virtualTexture) {
+        m_virtualTexture->bind(prog, m_pixelScale, m_feedbackPass);
+    } else {
+        VirtualTexture::disable(prog);
+        pTex_sphere->bind();
+    }
+}
+
+void Earth3DRenderer::releaseSphereTexture()
+{
+    if (m_virtualTexture) {
+        m_virtualTexture->release();
+    } else {
+        pTex_sphere->release();
+    }
+}
+
+SphereKey Earth3DRenderer::sphereKey() const
+{
+    SphereKey key = { 1.0, resolution,
+                      SphereGenerator::SharedGrid, SphereGenerator::PackedInterleaved, shape
+                    };
+    return key;
+}
+
+void Earth3DRenderer::requestSphere()
+{
+    m_pendingKey = sphereKey();
+    m_pendingSphere = SphereCache::instance()->requestGeometry(m_pendingKey);
+    m_spherePending = true;
+}
+
+void Earth3DRenderer::createSphere()
+{
+    // the finished future keeps the geometry alive, so this only uploads
+    m_sphereMesh = SphereCache::instance()->mesh(m_pendingKey);
+    m_pendingSphere = QFuture<SphereCache::Geometry>();
+    m_spherePending = false;
+
+    if (!vao_sphere.isCreated()) { vao_sphere.create(); }
+    vao_sphere.bind();
+
+    m_sphereMesh->vertexBuffer().bind();
+    if (m_sphereMesh->vertexLayout() == SphereGenerator::PackedInterleaved) {
+        // on the unit sphere the normal is the position itself,
+        // so both attributes read the same shorts
+        glVertexAttribPointer(vertex_loc_1,
+                              4, GL_SHORT, // tupleSize, type
+                              GL_TRUE, sizeof(SphereGenerator::PackedVertex), // normalize, stride
+                              TO_OFFSET(offsetof(SphereGenerator::PackedVertex, position)) // offset
+                             );
+        glVertexAttribPointer(texcoord_loc_1,
+                              2, GL_UNSIGNED_SHORT, // tupleSize, type
+                              GL_TRUE, sizeof(SphereGenerator::PackedVertex), // normalize, stride
+                              TO_OFFSET(offsetof(SphereGenerator::PackedVertex, texcoord)) // offset
+                             );
+        glVertexAttribPointer(normal_loc_1,
+                              3, GL_SHORT, // tupleSize, type
+                              GL_TRUE, sizeof(SphereGenerator::PackedVertex), // normalize, stride
+                              TO_OFFSET(offsetof(SphereGenerator::PackedVertex, position)) // offset
+                             );
+    } else {
+        glVertexAttribPointer(vertex_loc_1,
+                              3, GL_FLOAT, // tupleSize, type
+                              GL_FALSE, 0, // normalize, stride
+                              TO_OFFSET(m_sphereMesh->vertexOffset()) // offset
+                             );
+        glVertexAttribPointer(texcoord_loc_1,
+                              2, GL_FLOAT, // tupleSize, type
+                              GL_FALSE, 0, // normalize, stride
+                              TO_OFFSET(m_sphereMesh->texcoordOffset()) // offset
+                             );
+        glVertexAttribPointer(normal_loc_1,
+                              3, GL_FLOAT, // tupleSize, type
+                              GL_FALSE, 0, // normalize, stride
+                              TO_OFFSET(m_sphereMesh->normalOffset()) // offset
+                             );
+    }
+    m_texLightProg->enableAttributeArray(vertex_loc_1);
+    m_texLightProg->enableAttributeArray(texcoord_loc_1);
+    m_texLightProg->enableAttributeArray(normal_loc_1);
 
-    if (pTex_sphere == nullptr)
-        pTex_sphere = new QOpenGLTexture(
-            QImage(":/assets/land_shallow_topo_2048.png").mirrored());
+    vao_sphere.release();
 
     // A firmwire version
     if (!vao_sphere_fw.isCreated()) { vao_sphere_fw.create(); }
     vao_sphere_fw.bind();
 
-    ebo_sphere.bind();
-    vbo_sphere.bind();
-
-    glVertexAttribPointer(vertex_loc_0,
-                          3, GL_FLOAT, // tupleSize, type
-                          GL_FALSE, 0, // normalize, stride
-                          TO_OFFSET(0) // offset
-                         );
-    m_texLightProg.enableAttributeArray(vertex_loc_0);
+    m_sphereMesh->vertexBuffer().bind();
+    if (m_sphereMesh->vertexLayout() == SphereGenerator::PackedInterleaved) {
+        glVertexAttribPointer(vertex_loc_0,
+                              4, GL_SHORT, // tupleSize, type
+                              GL_TRUE, sizeof(SphereGenerator::PackedVertex), // normalize, stride
+                              TO_OFFSET(offsetof(SphereGenerator::PackedVertex, position)) // offset
+                             );
+    } else {
+        glVertexAttribPointer(vertex_loc_0,
+                              3, GL_FLOAT, // tupleSize, type
+                              GL_FALSE, 0, // normalize, stride
+                              TO_OFFSET(m_sphereMesh->vertexOffset()) // offset
+                             );
+    }
+    m_texLightProg->enableAttributeArray(vertex_loc_0);
 
     vao_sphere_fw.release();
 }
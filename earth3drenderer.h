@@ -7,12 +7,27 @@
 #include <QOpenGLShaderProgram>
 #include <QOpenGLTexture>
 #include <QOpenGLVertexArrayObject>
+#include <QPointer>
 #include <QQuickFramebufferObject>
 #include <QSize>
-#include "spheregenerator.h"
+#include "globelod.h"
+#include "msaatarget.h"
+#include "passtimer.h"
+#include "patchculler.h"
+#include "pointdrawer.h"
+#include "pointlayer.h"
+#include "polylinedrawer.h"
+#include "shadercache.h"
+#include "spherecache.h"
+#include "stripdrawer.h"
+#include "texturecache.h"
+#include "uniformblock.h"
+#include "virtualtexture.h"
 
 using FBO = QQuickFramebufferObject;
 
+class Earth3D;
+
 class Earth3DRenderer : public FBO::Renderer, protected QOpenGLFunctions
 {
 public:
@@ -26,18 +41,37 @@ public:
 protected:
     void initialize();
     void createGeometry();
+    void publish();
 
     void updateProjection(int width, int height);
     void updateCamera(int idx, double xrot, double yrot, double dist);
     void updateViewMatrix();
+    void updateFrameBlock();
+    QVector3D updateCuller(const QMatrix4x4 &model);
 
     void createAxis();
     void createCamera();
+    void createPatchGrid();
+    SphereKey sphereKey() const;
+    void requestSphere();
     void createSphere();
+    void createSphereTexture();
+    void createVirtualTexture();
+    void bindSphereTexture(QOpenGLShaderProgram &prog);
+    void releaseSphereTexture();
+
+    bool useProceduralSphere() const;
+    bool useLodSphere() const;
+    bool needsSphereMesh() const;
 
     void paintAxis();
     void paintCamera();
     void paintSphere();
+    void paintFeedback();
+    void paintProceduralSphere();
+    void paintLodSphere();
+    void paintLines();
+    void paintPoints();
     void paintSphereVertices();
 
 private:
@@ -45,12 +79,30 @@ private:
     bool showVertices;
     bool showCamera;
     bool useCamera2;
+    bool proceduralSphere;
+    bool lodEnabled;
     int resolution;
+    SphereGenerator::Shape shape;
+    bool m_sphereDirty;
     QSize m_viewportSize;
+    int m_samples;
+    int m_frames;
+    // set during synchronize, render() publishes its counters to it
+    QPointer<Earth3D> m_item;
+    // drawn multisampled and resolved here, each pass timed on the GPU
+    MsaaTarget m_msaa;
+    PassTimer m_passTimer;
 
     // projection and view matrix and camera
     QMatrix4x4 m_viewMatrix;
     QMatrix4x4 m_projMatrix;
+    // pixels per unit of size at unit distance, for the screen space error
+    double m_pixelScale;
+    // patch culling, counts are published at the end of the frame
+    PatchCuller m_culler;
+    QVector<bool> m_patchVisible;
+    int m_visiblePatches;
+    int m_culledPatches;
     QVector3D m_cameraPos[2];
     QVector3D m_cameraUp[2];
     QMatrix4x4 m_cameraTransform[2];
@@ -59,45 +111,81 @@ private:
     // camera shape
     QOpenGLVertexArrayObject vao_camera;
     QOpenGLBuffer vbo_camera;
-    QOpenGLBuffer ebo_camera;
-    QVector<int> camera_restartPoints;
-    int stripCount;
-    int fanCount;
+    StripDrawer cameraStrips;
     // axis
     QOpenGLVertexArrayObject vao_axis;
     QOpenGLBuffer vbo_axis;
     QOpenGLBuffer ebo_axis;
-    // sphere
-    SphereGenerator sphere;
+    // sphere, buffers are shared with other views through SphereCache
+    // the old mesh is drawn until the requested one is generated
+    QSharedPointer<SphereMesh> m_sphereMesh;
+    QFuture<SphereCache::Geometry> m_pendingSphere;
+    SphereKey m_pendingKey;
+    bool m_spherePending;
     QOpenGLVertexArrayObject vao_sphere;
-    QOpenGLBuffer vbo_sphere;
-    QOpenGLBuffer ebo_sphere;
-    QOpenGLTexture *pTex_sphere;
+    QSharedPointer<StreamedTexture> pTex_sphere;
+    bool m_textureWatched;
+    // the texture or its tiles were still coming in the last frame
+    bool m_texturePending;
+    // streamed imagery replacing pTex_sphere when set
+    QString m_virtualTexturePath;
+    bool m_virtualTextureDirty;
+    QScopedPointer<VirtualTexture> m_virtualTexture;
+    bool m_feedbackPass;
     // sphere vertices
     QOpenGLVertexArrayObject vao_sphere_fw;
+    // procedural sphere, has no attributes at all
+    QOpenGLVertexArrayObject vao_sphere_proc;
+    // level of detail patches, all share one grid
+    GlobeLod m_lod;
+    QOpenGLVertexArrayObject vao_patch;
+    QOpenGLBuffer vbo_patch;
+    StripDrawer patchStrips;
+    // markers, uploaded from the PointLayer of the item
+    PointDrawer m_points;
+    double m_pointReference;
+    // lines, all levels uploaded once from the PolylineLayer of the item
+    PolylineDrawer m_lines;
+    double m_linePixelError;
 
-    // shaders and attributes locations
-    QOpenGLShaderProgram m_colorProg;
-    QOpenGLShaderProgram m_texLightProg;
+    // camera and light, and the sphere material, for every program
+    UniformBlock m_frameBlock;
+    UniformBlock m_materialBlock;
+
+    // shaders, from ShaderCache, and attributes locations
+    QSharedPointer<QOpenGLShaderProgram> m_colorProg;
+    QSharedPointer<QOpenGLShaderProgram> m_texLightProg;
+    // null without GLSL 1.40 / ES 3.00
+    QSharedPointer<QOpenGLShaderProgram> m_proceduralProg;
+    QSharedPointer<QOpenGLShaderProgram> m_patchProg;
+    QSharedPointer<QOpenGLShaderProgram> m_pointProg;
+    QSharedPointer<QOpenGLShaderProgram> m_lineProg;
     int vertex_loc_0;
     int color_loc_0;
-    int mv_matrix_loc_0;
-    int proj_matrix_loc_0;
+    int model_matrix_loc_0;
 
     int vertex_loc_1;
     int texcoord_loc_1;
     int normal_loc_1;
-    int mv_matrix_loc_1;
-    int proj_matrix_loc_1;
-    int nm_matrix_loc_1;
-    int lpos_loc_1;
-    int ami_color_loc_1;
-    int ami_ref_loc_1;
-    int dif_color_loc_1;
-    int dif_ref_loc_1;
-    int spec_color_loc_1;
-    int spec_ref_loc_1;
-    int shininess_loc_1;
+    int model_matrix_loc_1;
+
+    int model_matrix_loc_2;
+    int resolution_loc_2;
+
+    int grid_loc_3;
+    int model_matrix_loc_3;
+    int patch_loc_3;
+    int morph_loc_3;
+    int eye_loc_3;
+
+    int corner_loc_4;
+    int model_matrix_loc_4;
+    int viewport_loc_4;
+    int ref_distance_loc_4;
+
+    int model_matrix_loc_5;
+    int viewport_loc_5;
+    int lift_loc_5;
 };
 
 #endif // EARTH3DRENDERER_H
@@ -0,0 +1,176 @@
+#include <QtMath>
+#include "globelod.h"
+#include "patchculler.h"
+
+// 8 x 4 root patches of 45 degrees
+static const int RootColumns = 8;
+static const int RootRows = 4;
+static const double RootSize = M_PI / RootRows;
+
+static QVector3D fromLonLat(double lon, double lat)
+{
+    double r = qCos(lat);
+    return QVector3D(r * qCos(lon), qSin(lat), r * qSin(lon));
+}
+
+GlobeLod::GlobeLod()
+    : m_gridSize(16)
+    , m_pixelError(2.0)
+    , m_maxLevel(10)
+    , m_culled(0)
+{
+}
+
+void GlobeLod::setGridSize(int cells)
+{
+    // geomorphing collapses odd vertices onto even ones
+    m_gridSize = qMax(2, cells & ~1);
+}
+
+void GlobeLod::setPixelError(double pixels)
+{
+    m_pixelError = qMax(0.1, pixels);
+}
+
+void GlobeLod::setMaxLevel(int level)
+{
+    m_maxLevel = qMax(0, level);
+}
+
+/*!
+ * \brief GlobeLod::geometricError
+ * Largest distance between the unit sphere and the chords of a grid cell
+ * at the given level.
+ */
+double GlobeLod::geometricError(int level) const
+{
+    double step = RootSize / (1 << level) / m_gridSize;
+    return 1 - qCos(step / 2);
+}
+
+/*!
+ * \brief GlobeLod::splitDistance
+ * \param pixelScale: viewport height / (2 * tan(fovy / 2))
+ * \return eye distance below which a node at the level is refined
+ */
+double GlobeLod::splitDistance(int level, double pixelScale) const
+{
+    return geometricError(level) * pixelScale / m_pixelError;
+}
+
+/*!
+ * \brief GlobeLod::skirtDepth
+ * Deep enough to cover the crack against a neighbour one level coarser.
+ */
+double GlobeLod::skirtDepth(int level) const
+{
+    return 2 * geometricError(qMax(0, level - 1));
+}
+
+GlobeLod::Patch GlobeLod::makePatch(float lon, float lat, float size, int level) const
+{
+    Patch p;
+    p.lon = lon;
+    p.lat = lat;
+    p.size = size;
+    p.level = level;
+    p.morphStart = 1e20f;
+    p.morphEnd = 2e20f;
+    p.center = fromLonLat(lon + size / 2, lat + size / 2);
+    p.radius = 0;
+    for (int i = 0; i <= 2; i++) {
+        for (int j = 0; j <= 2; j++) {
+            QVector3D corner = fromLonLat(lon + i * size / 2, lat + j * size / 2);
+            p.radius = qMax(p.radius, (corner - p.center).length());
+        }
+    }
+    return p;
+}
+
+/*!
+ * \brief GlobeLod::select
+ * Refill patches() for an eye position in model space. Nodes the culler
+ * rejects are dropped along with their whole subtree.
+ */
+void GlobeLod::select(const QVector3D &eye, double pixelScale, const PatchCuller *culler)
+{
+    m_patches.clear();
+    m_culled = 0;
+    for (int j = 0; j < RootRows; j++) {
+        for (int i = 0; i < RootColumns; i++) {
+            selectNode(makePatch(i * RootSize, j * RootSize - M_PI_2, RootSize, 0),
+                       eye, pixelScale, culler);
+        }
+    }
+}
+
+void GlobeLod::selectNode(const Patch &node, const QVector3D &eye, double pixelScale,
+                          const PatchCuller *culler)
+{
+    if (culler) {
+        // the box around the bounding sphere, which also holds the skirts
+        float r = node.radius + skirtDepth(node.level);
+        QVector3D extent(r, r, r);
+        // chords of the grid bend normals by up to one cell
+        float angle = 2 * qAsin(qMin(1.0f, node.radius / 2)) + node.size / m_gridSize;
+        if (!culler->isVisible(node.center - extent, node.center + extent,
+                               node.center, angle)) {
+            m_culled++;
+            return;
+        }
+    }
+    float dist = qMax(0.0f, (eye - node.center).length() - node.radius);
+    if (node.level >= m_maxLevel || dist >= splitDistance(node.level, pixelScale)) {
+        m_patches.append(node);
+        return;
+    }
+
+    // children fade into this node's grid as they approach its split distance
+    float half = node.size / 2;
+    float morphEnd = splitDistance(node.level, pixelScale);
+    for (int j = 0; j < 2; j++) {
+        for (int i = 0; i < 2; i++) {
+            Patch child = makePatch(node.lon + i * half, node.lat + j * half,
+                                    half, node.level + 1);
+            child.morphEnd = morphEnd;
+            child.morphStart = 0.7f * morphEnd;
+            selectNode(child, eye, pixelScale, culler);
+        }
+    }
+}
+
+/*!
+ * \brief GlobeLod::gridVertices
+ * (s, t, skirt) for (cells + 3)^2 vertices. The outer ring repeats the
+ * border with skirt set to 1, the shader pulls those below the surface.
+ */
+QVector<float> GlobeLod::gridVertices(int cells)
+{
+    QVector<float> vertices;
+    vertices.reserve((cells + 3) * (cells + 3) * 3);
+    for (int t = -1; t <= cells + 1; t++) {
+        for (int s = -1; s <= cells + 1; s++) {
+            bool skirt = s < 0 || t < 0 || s > cells || t > cells;
+            vertices << qBound(0, s, cells) << qBound(0, t, cells) << (skirt ? 1 : 0);
+        }
+    }
+    return vertices;
+}
+
+/*!
+ * \brief GlobeLod::gridIndices
+ * One triangle strip per row, wound like SphereGenerator's grid.
+ */
+QVector<uint> GlobeLod::gridIndices(int cells)
+{
+    int columns = cells + 3;
+    QVector<uint> indices;
+    indices.reserve((columns - 1) * (2 * columns + 1));
+    for (int t = 0; t < columns - 1; t++) {
+        for (int s = 0; s < columns; s++) {
+            indices << t * columns + s << (t + 1) * columns + s;
+        }
+        indices << restartIndex();
+    }
+    return indices;
+}
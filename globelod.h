@@ -0,0 +1,71 @@
+#ifndef GLOBELOD_H
+#define GLOBELOD_H
+
+#include <QVector>
+#include <QVector3D>
+
+class PatchCuller;
+
+/*!
+ * \brief The GlobeLod class
+ * Splits the unit sphere into lon/lat patches, each the root of a quadtree,
+ * and picks per frame the nodes whose geometric error projects to no more
+ * than a given number of pixels. Every node is drawn with the same grid,
+ * see gridVertices() and gridIndices().
+ */
+class GlobeLod
+{
+public:
+    struct Patch {
+        // south west corner and edge length, in radians
+        float lon;
+        float lat;
+        float size;
+        int level;
+        // eye distances over which vertices morph into the parent grid
+        float morphStart;
+        float morphEnd;
+        // bounding sphere
+        QVector3D center;
+        float radius;
+    };
+
+    GlobeLod();
+
+    int gridSize() const { return m_gridSize; }
+    void setGridSize(int cells);
+
+    double pixelError() const { return m_pixelError; }
+    void setPixelError(double pixels);
+
+    int maxLevel() const { return m_maxLevel; }
+    void setMaxLevel(int level);
+
+    void select(const QVector3D &eye, double pixelScale,
+                const PatchCuller *culler = nullptr);
+    const QVector<Patch> &patches() const { return m_patches; }
+    // nodes dropped by the culler in the last select()
+    int culledCount() const { return m_culled; }
+
+    double geometricError(int level) const;
+    double splitDistance(int level, double pixelScale) const;
+    double skirtDepth(int level) const;
+
+    static QVector<float> gridVertices(int cells);
+    static QVector<uint> gridIndices(int cells);
+    static uint restartIndex() { return 0xFFFFFFFF; }
+
+protected:
+    Patch makePatch(float lon, float lat, float size, int level) const;
+    void selectNode(const Patch &node, const QVector3D &eye, double pixelScale,
+                    const PatchCuller *culler);
+
+private:
+    int m_gridSize;
+    double m_pixelError;
+    int m_maxLevel;
+    QVector<Patch> m_patches;
+    int m_culled;
+};
+
+#endif // GLOBELOD_H
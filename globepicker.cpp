@@ -0,0 +1,107 @@
+#include <QtMath>
+#include "globepicker.h"
+
+GlobePicker::GlobePicker(Surface surface)
+    : m_surface(surface), m_valid(false)
+{
+}
+
+void GlobePicker::setCamera(const QMatrix4x4 &projection, const QMatrix4x4 &modelView,
+                            const QSize &viewport)
+{
+    m_projection = projection;
+    m_modelView = modelView;
+    m_viewport = viewport;
+    bool invertible = false;
+    m_viewToModel = modelView.inverted(&invertible);
+    m_eye = m_viewToModel * QVector3D(0, 0, 0);
+    m_valid = invertible && !viewport.isEmpty()
+              && projection(0, 0) != 0 && projection(1, 1) != 0;
+}
+
+/*!
+ * \brief GlobePicker::ray
+ * The direction is found in view space from the projection terms, rather
+ * than by unprojecting a near and a far point, which loses most of the
+ * precision of a float depth range of 0.001 to 1000.
+ */
+bool GlobePicker::ray(const QPointF &pos, QVector3D *origin, QVector3D *direction) const
+{
+    if (!m_valid) {
+        return false;
+    }
+    // item coordinates run down, normalized device coordinates up
+    float x = 2 * pos.x() / m_viewport.width() - 1;
+    float y = 1 - 2 * pos.y() / m_viewport.height();
+    QVector3D d((x + m_projection(0, 2)) / m_projection(0, 0),
+                (y + m_projection(1, 2)) / m_projection(1, 1), -1);
+    *origin = m_eye;
+    *direction = m_viewToModel.mapVector(d).normalized();
+    return true;
+}
+
+bool GlobePicker::pick(const QPointF &pos, QPointF *lonLat) const
+{
+    QVector3D origin;
+    QVector3D direction;
+    return ray(pos, &origin, &direction) && intersect(origin, direction, lonLat);
+}
+
+int GlobePicker::pick(const QPointF *pos, int count, QPointF *lonLat, bool *hit) const
+{
+    int hits = 0;
+    for (int k = 0; k < count; k++) {
+        bool h = pick(pos[k], &lonLat[k]);
+        if (hit) {
+            hit[k] = h;
+        }
+        hits += h;
+    }
+    return hits;
+}
+
+bool GlobePicker::intersect(const QVector3D &origin, const QVector3D &direction,
+                            QPointF *lonLat) const
+{
+    if (m_surface == Map) {
+        if (qFuzzyIsNull(direction.z())) {
+            return false;
+        }
+        float t = -origin.z() / direction.z();
+        QVector3D p = origin + t * direction;
+        if (t < 0 || p.x() < 0 || p.x() > 1 || p.y() < 0 || p.y() > 1) {
+            return false;
+        }
+        *lonLat = QPointF(360.0 * p.x() - 180, 180.0 * p.y() - 90);
+        return true;
+    }
+
+    // |origin + t direction| = 1, the nearer root unless the eye is inside
+    double b = QVector3D::dotProduct(origin, direction);
+    double c = origin.lengthSquared() - 1.0;
+    double discriminant = b * b - c;
+    if (discriminant < 0) {
+        return false;
+    }
+    double root = qSqrt(discriminant);
+    double t = -b - root < 0 ? -b + root : -b - root;
+    if (t < 0) {
+        return false;
+    }
+    QVector3D p = origin + float(t) * direction;
+    // back from the model space longitude, see PointLayer::modelPosition
+    double lon = 180.0 - qRadiansToDegrees(qAtan2(p.z(), p.x()));
+    if (lon > 180) {
+        lon -= 360;
+    }
+    double lat = qRadiansToDegrees(qAsin(qBound(-1.0f, p.y(), 1.0f)));
+    *lonLat = QPointF(lon, lat);
+    return true;
+}
+
+bool GlobePicker::operator==(const GlobePicker &other) const
+{
+    return m_surface == other.m_surface && m_valid == other.m_valid
+           && m_viewport == other.m_viewport && m_projection == other.m_projection
+           && m_modelView == other.m_modelView;
+}
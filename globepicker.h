@@ -0,0 +1,58 @@
+#ifndef GLOBEPICKER_H
+#define GLOBEPICKER_H
+
+#include <QMatrix4x4>
+#include <QPointF>
+#include <QSize>
+#include <QVector3D>
+
+/*!
+ * \brief The GlobePicker class
+ * Maps item coordinates to longitude and latitude without reading back
+ * any pixels: a ray from the camera is intersected with the unit sphere, or
+ * with the flat map, in their model space. The camera is the one the
+ * renderer last synchronized, so picks match what is on screen.
+ */
+class GlobePicker
+{
+public:
+    enum Surface {
+        // unit sphere around the origin, textured as in texlighting_patch.vert
+        Sphere,
+        // unit square from the origin in the plane z = 0, north up
+        Map,
+    };
+
+    explicit GlobePicker(Surface surface = Sphere);
+
+    // projection must be a perspective one, modelView is that of the surface
+    void setCamera(const QMatrix4x4 &projection, const QMatrix4x4 &modelView,
+                   const QSize &viewport);
+    bool isValid() const { return m_valid; }
+
+    // ray through an item position, in model space, direction normalized
+    bool ray(const QPointF &pos, QVector3D *origin, QVector3D *direction) const;
+    // degrees east and north of what is seen at pos, false off the surface
+    bool pick(const QPointF &pos, QPointF *lonLat) const;
+    // count positions at once, hit may be null; returns the number of hits
+    int pick(const QPointF *pos, int count, QPointF *lonLat, bool *hit) const;
+
+    bool operator==(const GlobePicker &other) const;
+    bool operator!=(const GlobePicker &other) const { return !(*this == other); }
+
+protected:
+    bool intersect(const QVector3D &origin, const QVector3D &direction,
+                   QPointF *lonLat) const;
+
+private:
+    Surface m_surface;
+    bool m_valid;
+    QMatrix4x4 m_projection;
+    QMatrix4x4 m_modelView;
+    QSize m_viewport;
+    // eye and view space to model space
+    QVector3D m_eye;
+    QMatrix4x4 m_viewToModel;
+};
+
+#endif // GLOBEPICKER_H
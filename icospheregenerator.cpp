@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <QtMath>
+#include <QHash>
+#include "icospheregenerator.h"
+
+IcosphereGenerator::IcosphereGenerator()
+{
+}
+
+/*!
+ * \brief IcosphereGenerator::frequency
+ * \return edge subdivisions giving about triangleBudget(resolution) triangles
+ */
+int IcosphereGenerator::frequency(int resolution)
+{
+    return qMax(1, qRound(qSqrt(triangleBudget(resolution) / 20.0)));
+}
+
+void IcosphereGenerator::generate(double radius, int resolution)
+{
+    const int n = frequency(resolution);
+
+    // poles, then the upper and the lower ring of five
+    QVector3D base[12];
+    base[0] = QVector3D(0, 1, 0);
+    base[1] = QVector3D(0, -1, 0);
+    const double ringLat = qAtan(0.5);
+    for (int k = 0; k < 5; k++) {
+        double upper = k * 2 * M_PI / 5;
+        double lower = upper + M_PI / 5;
+        base[2 + k] = fromPoleCoord(upper, ringLat, 1.0);
+        base[7 + k] = fromPoleCoord(lower, -ringLat, 1.0);
+    }
+    int faces[20][3];
+    for (int k = 0; k < 5; k++) {
+        int u0 = 2 + k, u1 = 2 + (k + 1) % 5;
+        int l0 = 7 + k, l1 = 7 + (k + 1) % 5;
+        int *f = faces[4 * k];
+        f[0] = 0;  f[1] = u0; f[2] = u1;
+        f[3] = u0; f[4] = l0; f[5] = u1;
+        f[6] = u1; f[7] = l0; f[8] = l1;
+        f[9] = 1;  f[10] = l1; f[11] = l0;
+    }
+
+    // vertices shared between faces are keyed by their weighted corners
+    QVector<QVector3D> directions;
+    QHash<quint64, unsigned int> ids;
+    auto vertexAt = [&](const int corner[3], const int weight[3]) -> unsigned int {
+        int order[3] = { 0, 1, 2 };
+        std::sort(order, order + 3, [&](int a, int b) { return corner[a] < corner[b]; });
+        quint64 key = 0;
+        QVector3D p;
+        for (int o : order) {
+            if (weight[o] > 0) {
+                key = (key << 20) | (quint64(corner[o]) << 16) | weight[o];
+                p += base[corner[o]] * weight[o];
+            }
+        }
+        auto it = ids.constFind(key);
+        if (it != ids.constEnd()) {
+            return it.value();
+        }
+        directions << p.normalized();
+        ids.insert(key, directions.size() - 1);
+        return directions.size() - 1;
+    };
+
+    // patches are super triangles of about m x m triangles, a bit over 20 degrees
+    const int m = qMax(1, (n + 2) / 3);
+    const int superCells = (n + m - 1) / m;
+    QVector<QVector<unsigned int>> patches(20 * superCells * superCells * 2);
+
+    for (int f = 0; f < 20; f++) {
+        int corner[3] = { faces[f][0], faces[f][1], faces[f][2] };
+        // keep every face counter clockwise seen from outside
+        QVector3D a = base[corner[0]], b = base[corner[1]], c = base[corner[2]];
+        if (QVector3D::dotProduct(QVector3D::crossProduct(b - a, c - a), a + b + c) < 0) {
+            qSwap(corner[1], corner[2]);
+        }
+        auto at = [&](int i, int j) {
+            const int weight[3] = { n - i - j, i, j };
+            return vertexAt(corner, weight);
+        };
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i + j < n; i++) {
+                int cell = (f * superCells + i / m) * superCells + j / m;
+                int local = i % m + j % m;
+                // upward triangle, then the downward one next to it
+                auto &up = patches[2 * cell + (local < m ? 0 : 1)];
+                up << at(i, j) << at(i + 1, j) << at(i, j + 1);
+                if (i + j + 1 < n) {
+                    auto &down = patches[2 * cell + (local + 1 < m ? 0 : 1)];
+                    down << at(i + 1, j) << at(i + 1, j + 1) << at(i, j + 1);
+                }
+            }
+        }
+    }
+
+    QVector<unsigned int> triangles;
+    QVector<int> patchStarts;
+    triangles.reserve(20 * n * n * 3);
+    for (const QVector<unsigned int> &patch : patches) {
+        if (!patch.isEmpty()) {
+            patchStarts << triangles.size();
+            triangles << patch;
+        }
+    }
+    buildTriangleMesh(radius, directions, triangles, patchStarts);
+}
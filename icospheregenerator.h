@@ -0,0 +1,23 @@
+#ifndef ICOSPHEREGENERATOR_H
+#define ICOSPHEREGENERATOR_H
+
+#include "spheregenerator.h"
+
+/*!
+ * \brief The IcosphereGenerator class
+ * Geodesic sphere: every face of an icosahedron split into n x n
+ * triangles, with n picked to match triangleBudget(resolution).
+ * Two vertices sit on the poles so the texture seam meets few triangles.
+ */
+class IcosphereGenerator : public SphereGenerator
+{
+public:
+    IcosphereGenerator();
+
+    Shape shape() const override { return Icosphere; }
+    void generate(double radius, int resolution) override;
+
+    static int frequency(int resolution);
+};
+
+#endif // ICOSPHEREGENERATOR_H
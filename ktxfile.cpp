@@ -0,0 +1,168 @@
+#include <cstring>
+#include <QFile>
+#include <QtEndian>
+#include "ktxfile.h"
+
+static const char KtxIdentifier[12] = {
+    '\xAB', 'K', 'T', 'X', ' ', '1', '1', '\xBB', '\r', '\n', '\x1A', '\n'
+};
+static const quint32 KtxEndianness = 0x04030201;
+// larger than any texture a GPU takes, keeps the level sizes within int
+static const quint32 MaxSize = 1 << 15;
+
+// header fields after the identifier, in file order
+enum HeaderField {
+    Endianness, GlType, GlTypeSize, GlFormat, GlInternalFormat, GlBaseInternalFormat,
+    PixelWidth, PixelHeight, PixelDepth, NumberOfArrayElements, NumberOfFaces,
+    NumberOfMipmapLevels, BytesOfKeyValueData, HeaderFieldCount
+};
+
+KtxFile::KtxFile()
+    : m_glType(0), m_glFormat(0)
+    , m_internalFormat(0), m_baseInternalFormat(0)
+    , m_width(0), m_height(0)
+{
+}
+
+void KtxFile::setFormat(quint32 internalFormat, quint32 baseInternalFormat)
+{
+    // compressed data has neither a type nor a format
+    m_glType = 0;
+    m_glFormat = 0;
+    m_internalFormat = internalFormat;
+    m_baseInternalFormat = baseInternalFormat;
+}
+
+void KtxFile::setSize(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+}
+
+int KtxFile::blockDataSize(int width, int height, int blockBytes)
+{
+    return ((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+int KtxFile::blockBytes(quint32 internalFormat)
+{
+    switch (internalFormat) {
+    case RGB_DXT1:
+    case ETC1_RGB8:
+    case RGB8_ETC2:
+        return 8;
+    }
+    return 0;
+}
+
+bool KtxFile::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray data = file.readAll();
+    const int headerSize = sizeof(KtxIdentifier) + HeaderFieldCount * 4;
+    if (data.size() < headerSize
+        || memcmp(data.constData(), KtxIdentifier, sizeof(KtxIdentifier)) != 0) {
+        qWarning("KtxFile: %s is not a KTX file", qPrintable(fileName));
+        return false;
+    }
+
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+    quint32 header[HeaderFieldCount];
+    for (int i = 0; i < HeaderFieldCount; i++) {
+        header[i] = qFromLittleEndian<quint32>(p + sizeof(KtxIdentifier) + i * 4);
+    }
+    // written by a big endian machine
+    bool swap = header[Endianness] != KtxEndianness;
+    if (swap) {
+        for (int i = 0; i < HeaderFieldCount; i++) {
+            header[i] = qbswap(header[i]);
+        }
+    }
+    if (header[Endianness] != KtxEndianness || header[PixelDepth] > 1
+        || header[NumberOfArrayElements] > 0 || header[NumberOfFaces] != 1) {
+        qWarning("KtxFile: %s is not a plain 2D texture", qPrintable(fileName));
+        return false;
+    }
+    // every field is checked before it is used as a size or an offset
+    const int block = header[GlType] == 0 ? blockBytes(header[GlInternalFormat]) : 0;
+    const quint32 width = header[PixelWidth];
+    const quint32 height = qMax(1u, header[PixelHeight]);
+    quint32 maxLevels = 1;
+    while (maxLevels < 32 && (qMax(width, height) >> maxLevels) > 0) {
+        maxLevels++;
+    }
+    if (block == 0 || width == 0 || width > MaxSize || height > MaxSize
+        || header[NumberOfMipmapLevels] > maxLevels
+        || header[BytesOfKeyValueData] > quint32(data.size() - headerSize)) {
+        qWarning("KtxFile: %s is damaged or not block compressed", qPrintable(fileName));
+        return false;
+    }
+
+    m_glType = header[GlType];
+    m_glFormat = header[GlFormat];
+    m_internalFormat = header[GlInternalFormat];
+    m_baseInternalFormat = header[GlBaseInternalFormat];
+    m_width = int(width);
+    m_height = int(height);
+    m_levels.clear();
+
+    qint64 offset = headerSize + qint64(header[BytesOfKeyValueData]);
+    int levels = qMax(1u, header[NumberOfMipmapLevels]);
+    for (int i = 0; i < levels; i++) {
+        if (offset + 4 > data.size()) {
+            return false;
+        }
+        quint32 size = qFromLittleEndian<quint32>(p + offset);
+        if (swap) {
+            size = qbswap(size);
+        }
+        offset += 4;
+        int expected = blockDataSize(qMax(1, m_width >> i), qMax(1, m_height >> i),
+                                     block);
+        if (size != quint32(expected) || size > quint64(data.size() - offset)) {
+            qWarning("KtxFile: level %d of %s has the wrong size", i,
+                     qPrintable(fileName));
+            return false;
+        }
+        m_levels << data.mid(offset, size);
+        // mipPadding
+        offset += (size + 3) & ~3;
+    }
+    return true;
+}
+
+bool KtxFile::save(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    quint32 header[HeaderFieldCount] = {};
+    header[Endianness] = KtxEndianness;
+    header[GlType] = m_glType;
+    header[GlTypeSize] = 1;
+    header[GlFormat] = m_glFormat;
+    header[GlInternalFormat] = m_internalFormat;
+    header[GlBaseInternalFormat] = m_baseInternalFormat;
+    header[PixelWidth] = m_width;
+    header[PixelHeight] = m_height;
+    header[NumberOfFaces] = 1;
+    header[NumberOfMipmapLevels] = m_levels.size();
+
+    file.write(KtxIdentifier, sizeof(KtxIdentifier));
+    for (int i = 0; i < HeaderFieldCount; i++) {
+        quint32 le = qToLittleEndian(header[i]);
+        file.write(reinterpret_cast<const char *>(&le), 4);
+    }
+    for (const QByteArray &level : m_levels) {
+        quint32 le = qToLittleEndian(quint32(level.size()));
+        file.write(reinterpret_cast<const char *>(&le), 4);
+        file.write(level);
+        file.write(QByteArray((4 - level.size() % 4) % 4, '\0'));
+    }
+    return file.error() == QFile::NoError;
+}
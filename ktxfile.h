@@ -0,0 +1,58 @@
+#ifndef KTXFILE_H
+#define KTXFILE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/*!
+ * \brief The KtxFile class
+ * Reader and writer for KTX 1.1 containers holding a single 2D image and
+ * its mip chain, as written by tools/texconv. Faces, array layers and key
+ * value data are not supported, and load() only takes the formats of
+ * CompressedFormat, whose level sizes it checks against the image size.
+ */
+class KtxFile
+{
+public:
+    // glInternalFormat values of the block compressed formats we write
+    enum CompressedFormat {
+        RGB_DXT1 = 0x83F0,
+        ETC1_RGB8 = 0x8D64,
+        RGB8_ETC2 = 0x9274,
+    };
+
+    KtxFile();
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    quint32 internalFormat() const { return m_internalFormat; }
+    quint32 baseInternalFormat() const { return m_baseInternalFormat; }
+    void setFormat(quint32 internalFormat, quint32 baseInternalFormat);
+    bool isCompressed() const { return m_glType == 0; }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    void setSize(int width, int height);
+
+    int levelCount() const { return m_levels.size(); }
+    const QByteArray &level(int i) const { return m_levels.at(i); }
+    void addLevel(const QByteArray &data) { m_levels << data; }
+
+    // bytes of one level for 4x4 block formats of the given block size
+    static int blockDataSize(int width, int height, int blockBytes);
+    // bytes per 4x4 block of a CompressedFormat, 0 for anything else
+    static int blockBytes(quint32 internalFormat);
+
+private:
+    quint32 m_glType;
+    quint32 m_glFormat;
+    quint32 m_internalFormat;
+    quint32 m_baseInternalFormat;
+    int m_width;
+    int m_height;
+    QVector<QByteArray> m_levels;
+};
+
+#endif // KTXFILE_H
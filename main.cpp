@@ -1,5 +1,8 @@
+#include <QDir>
+#include <QFileInfo>
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
+#include <QQmlContext>
 #include <QQuickWindow>
 #include <earth3d.h>
 #include <showtexturemapping.h>
@@ -8,11 +11,31 @@ void registerQMLTypes();
 
 int main(int argc, char *argv[])
 {
+    // all views share one context group, so they can share sphere buffers
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
     QGuiApplication app(argc, argv);
 
     registerQMLTypes();
 
     QQmlApplicationEngine engine;
+    // imagery packed by tools/tilepack is mapped, not decoded, so it can be
+    // any size without slowing down startup
+    QString pack = QDir(app.applicationDirPath()).filePath(QStringLiteral("earth.tilepack"));
+    engine.rootContext()->setContextProperty(QStringLiteral("imageryPack"),
+                                             QFileInfo(pack).isFile() ? pack : QString());
+    // markers, as packed by tools/pointpack or as CSV
+    QString points;
+    for (const char *name : { "earth.points", "earth.csv" }) {
+        QString path = QDir(app.applicationDirPath()).filePath(QLatin1String(name));
+        if (points.isEmpty() && QFileInfo(path).isFile()) {
+            points = path;
+        }
+    }
+    engine.rootContext()->setContextProperty(QStringLiteral("pointFile"), points);
+    // lines, such as coastlines, as GeoJSON
+    QString lines = QDir(app.applicationDirPath()).filePath(QStringLiteral("earth.geojson"));
+    engine.rootContext()->setContextProperty(QStringLiteral("lineFile"),
+                                             QFileInfo(lines).isFile() ? lines : QString());
     engine.load(QUrl(QStringLiteral("qrc:/main.qml")));
 
     return app.exec();
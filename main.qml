@@ -9,6 +9,14 @@ ApplicationWindow {
     height: 480
     visible: true
 
+    // "sphere 1.20 ms  frame 1.35 ms" from the passTimings of a view
+    function formatTimings(timings) {
+        var parts = []
+        for (var pass in timings)
+            parts.push(pass + " " + timings[pass].toFixed(2) + " ms")
+        return qsTr("GPU 耗时: %1").arg(parts.length ? parts.join("  ") : "-")
+    }
+
     menuBar: MenuBar {
         Menu {
             title: qsTr("&File")
@@ -39,6 +47,15 @@ ApplicationWindow {
 
             property real defaultCameraDistance: 2.5;
             property real zoomFactor: 1;
+            // longitude and latitude under the mouse, undefined off the globe
+            property var hoverLonLat
+
+            Component.onCompleted: {
+                if (pointFile)
+                    loadPoints(pointFile)
+                if (lineFile)
+                    loadLines(lineFile)
+            }
 
             function zoomIn() {
                 zoomFactor *= 1.1;
@@ -66,6 +83,7 @@ ApplicationWindow {
 
             MouseArea {
                 anchors.fill: parent
+                hoverEnabled: true
 
                 property int lastX
                 property int lastY
@@ -86,6 +104,7 @@ ApplicationWindow {
                     captureMouse(mouse)
                 }
                 onPositionChanged: {
+                    earth.hoverLonLat = earth.screenToLonLat(mouse.x, mouse.y)
                     if (mouse.buttons & Qt.LeftButton != 0) {
                         var deltaX = mouse.x - lastX
                         var deltaY = mouse.y - lastY
@@ -111,6 +130,52 @@ ApplicationWindow {
                 }
             }
 
+            BusyIndicator {
+                anchors.centerIn: parent
+                running: earth.spherePending || earth.pointsLoading || earth.linesLoading
+            }
+
+            Text {
+                id: earthStats
+                anchors {
+                    left: parent.left
+                    top: parent.top
+                    margins: 10
+                }
+                text: qsTr("可见块: %1  剔除块: %2  帧数: %3")
+                      .arg(earth.visiblePatches).arg(earth.culledPatches)
+                      .arg(earth.framesRendered)
+            }
+
+            Text {
+                id: earthTimings
+                anchors {
+                    left: earthStats.left
+                    top: earthStats.bottom
+                    topMargin: 4
+                }
+                text: formatTimings(earth.passTimings)
+            }
+
+            Text {
+                anchors {
+                    left: earthStats.left
+                    top: earthTimings.bottom
+                    topMargin: 4
+                }
+                visible: earth.hoverLonLat !== undefined
+                text: {
+                    var p = earth.hoverLonLat
+                    if (!p)
+                        return ""
+                    var s = qsTr("经度: %1  纬度: %2").arg(p.x.toFixed(3)).arg(p.y.toFixed(3))
+                    var marker = earth.nearestPoint(p.x, p.y, 0.5)
+                    if (marker >= 0)
+                        s += qsTr("  标记: %1").arg(marker)
+                    return s
+                }
+            }
+
             Rectangle {
                 anchors.fill: bottomRow
                 anchors.margins: -10
@@ -158,6 +223,15 @@ ApplicationWindow {
                     text: slider.value * slider.value * 2
                     horizontalAlignment: Text.AlignRight
                 }
+                ComboBox {
+                    id: shapeBox
+                    model: [qsTr("经纬球"), qsTr("二十面体"), qsTr("立方体球")]
+                    Binding {
+                        target: earth
+                        property: "sphereShape"
+                        value: shapeBox.currentIndex
+                    }
+                }
             }
         }
 
@@ -171,6 +245,9 @@ ApplicationWindow {
                 cameraYRotate: earth.cameraYRotate
                 cameraDistance: earth.cameraDistance
                 sphereResolution: earth.sphereResolution
+                sphereShape: earth.sphereShape
+                proceduralSphere: earth.proceduralSphere
+                lodEnabled: earth.lodEnabled
                 showCamera: true
                 useCamera2: true
                 camera2XRotate: 60
@@ -184,9 +261,19 @@ ApplicationWindow {
                 Layout.fillHeight: true
 
                 sphereResolution: earth.sphereResolution
+                sphereShape: earth.sphereShape
                 contentScale: 1.0
                 cameraPosition: "0, 0, 1000"
 
+                Text {
+                    anchors {
+                        left: parent.left
+                        top: parent.top
+                        margins: 10
+                    }
+                    text: formatTimings(textureMapping.passTimings)
+                }
+
                 function zoomIn() {
                     var z = cameraPosition.z * 0.9
                     if (z < 25)
@@ -270,6 +357,37 @@ ApplicationWindow {
                             value: chk2.checked
                         }
                     }
+                    CheckBox {
+                        id: chk3
+                        text: qsTr("在着色器中生成球面")
+                        Binding {
+                            target: earth
+                            property: "proceduralSphere"
+                            value: chk3.checked
+                        }
+                    }
+                    CheckBox {
+                        id: chk4
+                        text: qsTr("按屏幕误差细分球面")
+                        Binding {
+                            target: earth
+                            property: "lodEnabled"
+                            value: chk4.checked
+                        }
+                    }
+                    CheckBox {
+                        id: chk5
+                        text: qsTr("分块流式加载纹理")
+                        // a tile pack is only used when streaming
+                        checked: imageryPack !== ""
+                        Binding {
+                            target: earth
+                            property: "virtualTexture"
+                            value: !chk5.checked ? ""
+                                   : imageryPack ? imageryPack
+                                   : ":/assets/land_shallow_topo_2048.png"
+                        }
+                    }
                 }
             }
         }
@@ -0,0 +1,33 @@
+#include "msaatarget.h"
+
+MsaaTarget::MsaaTarget()
+    : m_samples(0)
+{
+}
+
+void MsaaTarget::bind(QOpenGLFramebufferObject *target, int samples)
+{
+    if (samples <= 0 || !QOpenGLFramebufferObject::hasOpenGLFramebufferMultisample()
+        || !QOpenGLFramebufferObject::hasOpenGLFramebufferBlit()) {
+        m_fbo.reset();
+        target->bind();
+        return;
+    }
+    // the driver may round the samples, so compare against what was asked
+    if (!m_fbo || m_fbo->size() != target->size() || m_samples != samples) {
+        QOpenGLFramebufferObjectFormat format;
+        format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+        format.setSamples(samples);
+        m_fbo.reset(new QOpenGLFramebufferObject(target->size(), format));
+        m_samples = samples;
+    }
+    m_fbo->bind();
+}
+
+void MsaaTarget::resolve(QOpenGLFramebufferObject *target)
+{
+    if (m_fbo) {
+        QOpenGLFramebufferObject::blitFramebuffer(target, m_fbo.data());
+    }
+    target->bind();
+}
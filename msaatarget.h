@@ -0,0 +1,30 @@
+#ifndef MSAATARGET_H
+#define MSAATARGET_H
+
+#include <QOpenGLFramebufferObject>
+#include <QScopedPointer>
+
+/*!
+ * \brief The MsaaTarget class
+ * A multisampled framebuffer a renderer draws into and resolves itself,
+ * instead of handing QQuickFramebufferObject a multisampled one, so the
+ * resolve is part of render() and can be timed like any other pass.
+ */
+class MsaaTarget
+{
+public:
+    MsaaTarget();
+
+    // bind a multisampled buffer the size of target, or target itself when
+    // samples is 0 or the context can not blit between framebuffers
+    void bind(QOpenGLFramebufferObject *target, int samples);
+    bool isActive() const { return !m_fbo.isNull(); }
+    // blit into target and leave target bound
+    void resolve(QOpenGLFramebufferObject *target);
+
+private:
+    QScopedPointer<QOpenGLFramebufferObject> m_fbo;
+    int m_samples;
+};
+
+#endif // MSAATARGET_H
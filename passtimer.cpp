@@ -0,0 +1,199 @@
+#include <QOpenGLContext>
+#include "passtimer.h"
+
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP 0x8E28
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+PassTimer::PassTimer()
+    : m_initialized(false), m_supported(false), m_disjoint(false)
+    , m_genQueries(nullptr), m_deleteQueries(nullptr), m_queryCounter(nullptr)
+    , m_getQueryObjectiv(nullptr), m_getQueryObjectui64v(nullptr)
+    , m_current(0), m_inPass(false), m_draining(false), m_drainRequested(false)
+{
+    for (Frame &frame : m_frames) {
+        frame.count = 0;
+        frame.pending = false;
+    }
+}
+
+PassTimer::~PassTimer()
+{
+    if (!m_supported) {
+        return;
+    }
+    for (Frame &frame : m_frames) {
+        if (!frame.queries.isEmpty()) {
+            m_deleteQueries(frame.queries.size(), frame.queries.constData());
+        }
+    }
+}
+
+void PassTimer::resolveFunctions()
+{
+    if (m_initialized) {
+        return;
+    }
+    initializeOpenGLFunctions();
+    m_initialized = true;
+
+    auto ctx = QOpenGLContext::currentContext();
+    QByteArray suffix;
+    if (ctx->isOpenGLES()) {
+        if (!ctx->hasExtension(QByteArrayLiteral("GL_EXT_disjoint_timer_query"))) {
+            return;
+        }
+        // timestamps are worthless across a disjoint event, see collect()
+        suffix = "EXT";
+        m_disjoint = true;
+    } else if (ctx->format().version() < qMakePair(3, 3)
+               && !ctx->hasExtension(QByteArrayLiteral("GL_ARB_timer_query"))) {
+        return;
+    }
+    m_genQueries = reinterpret_cast<GenQueries>(
+                       ctx->getProcAddress("glGenQueries" + suffix));
+    m_deleteQueries = reinterpret_cast<DeleteQueries>(
+                          ctx->getProcAddress("glDeleteQueries" + suffix));
+    m_queryCounter = reinterpret_cast<QueryCounter>(
+                         ctx->getProcAddress("glQueryCounter" + suffix));
+    m_getQueryObjectiv = reinterpret_cast<GetQueryObjectiv>(
+                             ctx->getProcAddress("glGetQueryObjectiv" + suffix));
+    m_getQueryObjectui64v = reinterpret_cast<GetQueryObjectui64v>(
+                                ctx->getProcAddress("glGetQueryObjectui64v" + suffix));
+    m_supported = m_genQueries && m_deleteQueries && m_queryCounter
+                  && m_getQueryObjectiv && m_getQueryObjectui64v;
+}
+
+bool PassTimer::isSupported()
+{
+    resolveFunctions();
+    return m_supported;
+}
+
+void PassTimer::beginFrame()
+{
+    if (!isSupported()) {
+        return;
+    }
+    collect();
+    m_draining = m_drainRequested;
+    m_drainRequested = false;
+    m_current = (m_current + 1) % RingSize;
+    Frame &frame = m_frames[m_current];
+    // still not back after RingSize frames, drop it rather than wait
+    frame.pending = false;
+    frame.count = 0;
+    if (frame.queries.isEmpty()) {
+        frame.queries.resize(2 * MaxPasses);
+        m_genQueries(frame.queries.size(), frame.queries.data());
+    }
+}
+
+void PassTimer::endFrame()
+{
+    if (!m_supported) {
+        return;
+    }
+    if (m_inPass) {
+        end();
+    }
+    Frame &frame = m_frames[m_current];
+    frame.pending = frame.count > 0;
+    // earlier frames are likely back by now
+    collect();
+}
+
+bool PassTimer::needsFrame()
+{
+    if (!m_supported || m_draining) {
+        return false;
+    }
+    for (const Frame &frame : m_frames) {
+        if (frame.pending) {
+            m_drainRequested = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void PassTimer::begin(const char *pass)
+{
+    Frame &frame = m_frames[m_current];
+    if (!m_supported || m_inPass || frame.count >= MaxPasses || frame.queries.isEmpty()) {
+        return;
+    }
+    frame.passes[frame.count] = pass;
+    m_queryCounter(frame.queries[2 * frame.count], GL_TIMESTAMP);
+    m_inPass = true;
+}
+
+void PassTimer::end()
+{
+    if (!m_inPass) {
+        return;
+    }
+    Frame &frame = m_frames[m_current];
+    m_queryCounter(frame.queries[2 * frame.count + 1], GL_TIMESTAMP);
+    frame.count++;
+    m_inPass = false;
+}
+
+/*!
+ * \brief PassTimer::collect
+ * Read the pending frames, oldest first, as far as their results are
+ * available. Queries complete in order, so the first frame still waiting
+ * ends the walk.
+ */
+void PassTimer::collect()
+{
+    if (m_disjoint) {
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (disjoint) {
+            for (Frame &frame : m_frames) {
+                frame.pending = false;
+            }
+            return;
+        }
+    }
+    for (int k = 1; k <= RingSize; k++) {
+        Frame &frame = m_frames[(m_current + k) % RingSize];
+        if (!frame.pending) {
+            continue;
+        }
+        GLint available = 0;
+        m_getQueryObjectiv(frame.queries[2 * frame.count - 1], GL_QUERY_RESULT_AVAILABLE,
+                           &available);
+        if (!available) {
+            return;
+        }
+
+        QVariantMap timings;
+        quint64 first = 0;
+        quint64 last = 0;
+        for (int i = 0; i < frame.count; i++) {
+            quint64 begin = 0;
+            quint64 end = 0;
+            m_getQueryObjectui64v(frame.queries[2 * i], GL_QUERY_RESULT, &begin);
+            m_getQueryObjectui64v(frame.queries[2 * i + 1], GL_QUERY_RESULT, &end);
+            // a pass run twice in a frame counts once, with both times
+            QString pass = QString::fromLatin1(frame.passes[i]);
+            timings[pass] = timings.value(pass).toDouble() + (end - begin) / 1e6;
+            first = i == 0 ? begin : first;
+            last = end;
+        }
+        timings[QStringLiteral("frame")] = (last - first) / 1e6;
+        m_timings = timings;
+        frame.pending = false;
+    }
+}
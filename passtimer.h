@@ -0,0 +1,95 @@
+#ifndef PASSTIMER_H
+#define PASSTIMER_H
+
+#include <QOpenGLFunctions>
+#include <QVariantMap>
+#include <QVector>
+
+/*!
+ * \brief The PassTimer class
+ * GPU time of the render passes of a frame, from timestamp queries. Every
+ * frame writes its queries into the next slot of a small ring and results
+ * are collected only once the GPU has them, a few frames later, so reading
+ * them never stalls the pipeline. Passes must not nest. endFrame() collects
+ * what is back already; needsFrame() asks for one more frame when the view
+ * would otherwise idle with results still out.
+ *
+ * Needs GL 3.3, ARB_timer_query or EXT_disjoint_timer_query; without them
+ * every call does nothing and timings() stays empty.
+ */
+class PassTimer : protected QOpenGLFunctions
+{
+public:
+    // frames a query may be in flight before its slot is reused
+    static const int RingSize = 4;
+    static const int MaxPasses = 16;
+
+    class Scope
+    {
+    public:
+        Scope(PassTimer &timer, const char *pass)
+            : m_timer(timer) { m_timer.begin(pass); }
+        ~Scope() { m_timer.end(); }
+
+    private:
+        PassTimer &m_timer;
+    };
+
+    PassTimer();
+    // deletes the queries, the context must be current
+    ~PassTimer();
+
+    bool isSupported();
+
+    void beginFrame();
+    void endFrame();
+    void begin(const char *pass);
+    void end();
+    // true after a frame that left results pending, unless that frame was
+    // itself drawn for them; the caller then asks for one more frame
+    bool needsFrame();
+
+    // milliseconds per pass and "frame" for the whole frame, of the newest
+    // frame whose results came back
+    QVariantMap timings() const { return m_timings; }
+
+protected:
+    void resolveFunctions();
+    void collect();
+
+private:
+    typedef void (QOPENGLF_APIENTRYP GenQueries)(GLsizei n, GLuint *ids);
+    typedef void (QOPENGLF_APIENTRYP DeleteQueries)(GLsizei n, const GLuint *ids);
+    typedef void (QOPENGLF_APIENTRYP QueryCounter)(GLuint id, GLenum target);
+    typedef void (QOPENGLF_APIENTRYP GetQueryObjectiv)(GLuint id, GLenum pname,
+                                                       GLint *params);
+    typedef void (QOPENGLF_APIENTRYP GetQueryObjectui64v)(GLuint id, GLenum pname,
+                                                          quint64 *params);
+
+    struct Frame {
+        // two timestamps per pass
+        QVector<GLuint> queries;
+        const char *passes[MaxPasses];
+        int count;
+        bool pending;
+    };
+
+    bool m_initialized;
+    bool m_supported;
+    bool m_disjoint;
+    GenQueries m_genQueries;
+    DeleteQueries m_deleteQueries;
+    QueryCounter m_queryCounter;
+    GetQueryObjectiv m_getQueryObjectiv;
+    GetQueryObjectui64v m_getQueryObjectui64v;
+
+    Frame m_frames[RingSize];
+    int m_current;
+    bool m_inPass;
+    // the frame is drawn only to collect the results of the one before
+    bool m_draining;
+    bool m_drainRequested;
+    QVariantMap m_timings;
+};
+
+#endif // PASSTIMER_H
@@ -0,0 +1,69 @@
+#include <QtMath>
+#include "patchculler.h"
+
+PatchCuller::PatchCuller()
+    : m_horizonAngle(-1)
+{
+}
+
+/*!
+ * \brief PatchCuller::setView
+ * Extract the clip planes from the combined matrix (Gribb & Hartmann)
+ * and the horizon angle for an eye outside a sphere of the given radius.
+ */
+void PatchCuller::setView(const QMatrix4x4 &modelViewProjection, const QVector3D &eye,
+                          double radius)
+{
+    const QVector4D x = modelViewProjection.row(0);
+    const QVector4D y = modelViewProjection.row(1);
+    const QVector4D z = modelViewProjection.row(2);
+    const QVector4D w = modelViewProjection.row(3);
+    m_planes[0] = w + x;
+    m_planes[1] = w - x;
+    m_planes[2] = w + y;
+    m_planes[3] = w - y;
+    m_planes[4] = w + z;
+    m_planes[5] = w - z;
+
+    double dist = eye.length();
+    m_eyeDir = eye / dist;
+    m_horizonAngle = dist > radius ? qAcos(radius / dist) : -1;
+}
+
+bool PatchCuller::isVisible(const QVector3D &boxMin, const QVector3D &boxMax,
+                            const QVector3D &axis, float coneAngle) const
+{
+    return !isBeyondHorizon(axis, coneAngle) && !isOutsideFrustum(boxMin, boxMax);
+}
+
+/*!
+ * \brief PatchCuller::isOutsideFrustum
+ * \return whether the box is completely behind one of the clip planes
+ */
+bool PatchCuller::isOutsideFrustum(const QVector3D &boxMin, const QVector3D &boxMax) const
+{
+    for (const QVector4D &p : m_planes) {
+        // the corner furthest along the plane normal
+        QVector3D corner(p.x() >= 0 ? boxMax.x() : boxMin.x(),
+                         p.y() >= 0 ? boxMax.y() : boxMin.y(),
+                         p.z() >= 0 ? boxMax.z() : boxMin.z());
+        if (QVector3D::dotProduct(p.toVector3D(), corner) + p.w() < 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+ * \brief PatchCuller::isBeyondHorizon
+ * A point of the sphere is visible only if its normal is closer than the
+ * horizon angle to the eye direction; test the closest normal of the cone.
+ */
+bool PatchCuller::isBeyondHorizon(const QVector3D &axis, float coneAngle) const
+{
+    if (m_horizonAngle < 0) {
+        return false;
+    }
+    float cosAngle = qBound(-1.0f, QVector3D::dotProduct(axis, m_eyeDir), 1.0f);
+    return qAcos(cosAngle) - coneAngle > m_horizonAngle;
+}
@@ -0,0 +1,35 @@
+#ifndef PATCHCULLER_H
+#define PATCHCULLER_H
+
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QVector4D>
+
+/*!
+ * \brief The PatchCuller class
+ * Conservative visibility of sphere patches against the view frustum,
+ * using their bounding boxes, and against the horizon of the sphere,
+ * using their normal cones.
+ */
+class PatchCuller
+{
+public:
+    PatchCuller();
+
+    // modelViewProjection and eye are in the model space of the patches
+    void setView(const QMatrix4x4 &modelViewProjection, const QVector3D &eye,
+                 double radius);
+
+    bool isVisible(const QVector3D &boxMin, const QVector3D &boxMax,
+                   const QVector3D &axis, float coneAngle) const;
+    bool isOutsideFrustum(const QVector3D &boxMin, const QVector3D &boxMax) const;
+    bool isBeyondHorizon(const QVector3D &axis, float coneAngle) const;
+
+private:
+    QVector4D m_planes[6];
+    QVector3D m_eyeDir;
+    // angle from the eye direction to the horizon, negative inside the sphere
+    float m_horizonAngle;
+};
+
+#endif // PATCHCULLER_H
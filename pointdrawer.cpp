@@ -0,0 +1,214 @@
+#include <QOpenGLContext>
+#include "pointdrawer.h"
+#include "pointlayer.h"
+
+#ifndef GL_PROGRAM_POINT_SIZE
+#define GL_PROGRAM_POINT_SIZE 0x8642
+#endif
+#ifndef GL_POINT_SPRITE
+#define GL_POINT_SPRITE 0x8861
+#endif
+
+PointDrawer::PointDrawer()
+    : m_initialized(false), m_isES(false), m_method(Sprites)
+    , m_drawArraysInstanced(nullptr), m_vertexAttribDivisor(nullptr)
+    , m_capacity(0), m_count(0)
+{
+    m_locations.corner = m_locations.position = -1;
+    m_locations.color = m_locations.size = -1;
+}
+
+void PointDrawer::resolveFunctions()
+{
+    if (m_initialized) {
+        return;
+    }
+    initializeOpenGLFunctions();
+    m_initialized = true;
+
+    auto ctx = QOpenGLContext::currentContext();
+    auto version = ctx->format().version();
+    m_isES = ctx->isOpenGLES();
+    QByteArray suffix;
+    if (m_isES && version < qMakePair(3, 0)) {
+        if (ctx->hasExtension(QByteArrayLiteral("GL_ANGLE_instanced_arrays"))) {
+            suffix = "ANGLE";
+        } else if (ctx->hasExtension(QByteArrayLiteral("GL_EXT_instanced_arrays"))) {
+            suffix = "EXT";
+        } else {
+            return;
+        }
+    } else if (!m_isES && version < qMakePair(3, 3)) {
+        if (!ctx->hasExtension(QByteArrayLiteral("GL_ARB_instanced_arrays"))) {
+            return;
+        }
+        suffix = "ARB";
+    }
+    m_drawArraysInstanced = reinterpret_cast<DrawArraysInstanced>(
+                                ctx->getProcAddress("glDrawArraysInstanced" + suffix));
+    m_vertexAttribDivisor = reinterpret_cast<VertexAttribDivisor>(
+                                ctx->getProcAddress("glVertexAttribDivisor" + suffix));
+    if (m_drawArraysInstanced && m_vertexAttribDivisor) {
+        m_method = Instanced;
+    }
+}
+
+PointDrawer::Method PointDrawer::method()
+{
+    resolveFunctions();
+    return m_method;
+}
+
+void PointDrawer::setLocations(const Locations &locations)
+{
+    m_locations = locations;
+}
+
+void PointDrawer::createBuffers()
+{
+    m_vao.create();
+    m_vao.bind();
+
+    if (m_method == Instanced && m_locations.corner >= 0) {
+        // one triangle strip quad, instanced for every point
+        static const GLfloat corners[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+        m_corners.create();
+        m_corners.bind();
+        m_corners.allocate(corners, sizeof(corners));
+        glVertexAttribPointer(m_locations.corner, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glEnableVertexAttribArray(m_locations.corner);
+    }
+
+    struct {
+        QOpenGLBuffer *buffer;
+        int location;
+        int components;
+        GLenum type;
+        GLboolean normalized;
+    } attributes[] = {
+        { &m_positions, m_locations.position, 2, GL_FLOAT, GL_FALSE },
+        { &m_colors, m_locations.color, 4, GL_UNSIGNED_BYTE, GL_TRUE },
+        { &m_sizes, m_locations.size, 1, GL_UNSIGNED_BYTE, GL_FALSE },
+    };
+    for (auto &a : attributes) {
+        a.buffer->create();
+        a.buffer->bind();
+        a.buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
+        if (a.location < 0) {
+            continue;
+        }
+        glVertexAttribPointer(a.location, a.components, a.type, a.normalized, 0, nullptr);
+        glEnableVertexAttribArray(a.location);
+        if (m_method == Instanced) {
+            m_vertexAttribDivisor(a.location, 1);
+        }
+    }
+
+    m_vao.release();
+}
+
+/*!
+ * \brief PointDrawer::sync
+ * Grow the buffers by half, or to the capacity reserved in the layer, when
+ * the layer no longer fits, which uploads everything, otherwise upload runs
+ * of dirty chunks per attribute.
+ */
+void PointDrawer::sync(PointLayer *layer)
+{
+    resolveFunctions();
+    if (!m_vao.isCreated()) {
+        createBuffers();
+    }
+
+    int count = layer->count();
+    if (count > m_capacity) {
+        // a layer reserved for a streamed file is allocated once
+        m_capacity = qMax(qMax(count, layer->capacity()), m_capacity + m_capacity / 2);
+        m_positions.bind();
+        m_positions.allocate(m_capacity * 2 * sizeof(float));
+        m_colors.bind();
+        m_colors.allocate(m_capacity * 4);
+        m_sizes.bind();
+        m_sizes.allocate(m_capacity);
+        upload(layer, 0, count, PointLayer::AllAttributes);
+    } else {
+        const int chunks = layer->chunkCount();
+        for (int attribute : { PointLayer::Position, PointLayer::Color, PointLayer::Size }) {
+            for (int c = 0; c < chunks; c++) {
+                if (!(layer->dirty(c) & attribute)) {
+                    continue;
+                }
+                int end = c + 1;
+                while (end < chunks && (layer->dirty(end) & attribute)) {
+                    end++;
+                }
+                int first = c * PointLayer::ChunkSize;
+                upload(layer, first, qMin(count, end * PointLayer::ChunkSize) - first,
+                       attribute);
+                c = end;
+            }
+        }
+    }
+    layer->clearDirty();
+    m_count = count;
+}
+
+void PointDrawer::upload(PointLayer *layer, int first, int count, int attributes)
+{
+    if (count <= 0) {
+        return;
+    }
+    if (attributes & PointLayer::Position) {
+        m_positions.bind();
+        m_positions.write(first * 2 * sizeof(float), layer->positions() + first * 2,
+                          count * 2 * sizeof(float));
+    }
+    if (attributes & PointLayer::Color) {
+        m_colors.bind();
+        m_colors.write(first * 4, layer->colors() + first * 4, count * 4);
+    }
+    if (attributes & PointLayer::Size) {
+        m_sizes.bind();
+        m_sizes.write(first, layer->sizes() + first, count);
+    }
+}
+
+void PointDrawer::draw()
+{
+    if (m_count == 0) {
+        return;
+    }
+
+    m_vao.bind();
+    if (m_method == Instanced) {
+        m_drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_count);
+    } else {
+        // both are always on in ES, and the sprite switch is gone from core
+        bool legacy = !m_isES && QOpenGLContext::currentContext()->format().profile()
+                      != QSurfaceFormat::CoreProfile;
+        if (!m_isES) {
+            glEnable(GL_PROGRAM_POINT_SIZE);
+        }
+        if (legacy) {
+            glEnable(GL_POINT_SPRITE);
+        }
+        glDrawArrays(GL_POINTS, 0, m_count);
+        if (legacy) {
+            glDisable(GL_POINT_SPRITE);
+        }
+        if (!m_isES) {
+            glDisable(GL_PROGRAM_POINT_SIZE);
+        }
+    }
+    m_vao.release();
+}
+
+void PointDrawer::destroy()
+{
+    m_vao.destroy();
+    m_corners.destroy();
+    m_positions.destroy();
+    m_colors.destroy();
+    m_sizes.destroy();
+    m_capacity = m_count = 0;
+}
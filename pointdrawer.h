@@ -0,0 +1,74 @@
+#ifndef POINTDRAWER_H
+#define POINTDRAWER_H
+
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QOpenGLVertexArrayObject>
+
+class PointLayer;
+
+/*!
+ * \brief The PointDrawer class
+ * GPU side of a PointLayer: one buffer per attribute, grown by half when
+ * the layer outgrows it and otherwise patched chunk by chunk, and a single
+ * draw call for all points.
+ */
+class PointDrawer : protected QOpenGLFunctions
+{
+public:
+    enum Method {
+        // a screen aligned quad per point, GL 3.3 / ES 3.0 or instanced_arrays
+        Instanced,
+        // GL_POINTS with gl_PointSize, limited to the point sizes of the driver
+        Sprites,
+    };
+
+    struct Locations {
+        int corner;
+        int position;
+        int color;
+        int size;
+    };
+
+    PointDrawer();
+
+    Method method();
+    // attributes of the program that draws the points, before the first sync()
+    void setLocations(const Locations &locations);
+
+    // upload what changed since the last call, in synchronize
+    void sync(PointLayer *layer);
+    void draw();
+    void destroy();
+
+    int count() const { return m_count; }
+
+protected:
+    void resolveFunctions();
+    void createBuffers();
+    void upload(PointLayer *layer, int first, int count, int attributes);
+
+private:
+    typedef void (QOPENGLF_APIENTRYP DrawArraysInstanced)(GLenum mode, GLint first,
+                                                          GLsizei count,
+                                                          GLsizei instanceCount);
+    typedef void (QOPENGLF_APIENTRYP VertexAttribDivisor)(GLuint index, GLuint divisor);
+
+    bool m_initialized;
+    bool m_isES;
+    Method m_method;
+    DrawArraysInstanced m_drawArraysInstanced;
+    VertexAttribDivisor m_vertexAttribDivisor;
+
+    Locations m_locations;
+    QOpenGLVertexArrayObject m_vao;
+    QOpenGLBuffer m_corners;
+    QOpenGLBuffer m_positions;
+    QOpenGLBuffer m_colors;
+    QOpenGLBuffer m_sizes;
+    // points the buffers have room for, and points drawn
+    int m_capacity;
+    int m_count;
+};
+
+#endif // POINTDRAWER_H
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <queue>
+#include <QPair>
+#include <QtMath>
+#include "pointindex.h"
+
+// Z-order: the bits of i on even positions, those of j on odd ones
+static quint64 spread(quint32 x)
+{
+    quint64 v = x;
+    v = (v | (v << 16)) & Q_UINT64_C(0x0000FFFF0000FFFF);
+    v = (v | (v << 8)) & Q_UINT64_C(0x00FF00FF00FF00FF);
+    v = (v | (v << 4)) & Q_UINT64_C(0x0F0F0F0F0F0F0F0F);
+    v = (v | (v << 2)) & Q_UINT64_C(0x3333333333333333);
+    v = (v | (v << 1)) & Q_UINT64_C(0x5555555555555555);
+    return v;
+}
+
+static quint64 cellId(int face, int level, quint32 i, quint32 j)
+{
+    int shift = 2 * (PointIndex::MaxLevel - level);
+    return (quint64(face) << (2 * PointIndex::MaxLevel))
+           | ((spread(i) | (spread(j) << 1)) << shift);
+}
+
+// through the chord, which stays exact for the small angles between
+// neighbouring points where acos of the dot product does not
+static double angleBetween(const QVector3D &a, const QVector3D &b)
+{
+    return 2 * qAsin(qMin(1.0, double((a - b).length()) / 2));
+}
+
+// faces 0 to 2 look down +x, +y and +z, faces 3 to 5 down -x, -y and -z
+static int faceOf(const QVector3D &p)
+{
+    int axis = 0;
+    for (int a = 1; a < 3; a++) {
+        if (qAbs(p[a]) > qAbs(p[axis])) {
+            axis = a;
+        }
+    }
+    return p[axis] < 0 ? axis + 3 : axis;
+}
+
+static QVector3D fromFace(int face, double u, double v)
+{
+    int axis = face % 3;
+    QVector3D p;
+    p[axis] = face < 3 ? 1 : -1;
+    p[(axis + 1) % 3] = u;
+    p[(axis + 2) % 3] = v;
+    return p.normalized();
+}
+
+PointIndex::PointIndex()
+{
+}
+
+QVector3D PointIndex::direction(float lon, float lat)
+{
+    // as in points.vert
+    float r = qCos(lat);
+    return QVector3D(r * qCos(lon), qSin(lat), r * qSin(lon));
+}
+
+quint64 PointIndex::leafId(const QVector3D &direction)
+{
+    const quint32 cells = 1u << MaxLevel;
+    int face = faceOf(direction);
+    int axis = face % 3;
+    double w = qAbs(direction[axis]);
+    double s = (direction[(axis + 1) % 3] / w + 1) / 2;
+    double t = (direction[(axis + 2) % 3] / w + 1) / 2;
+    quint32 i = quint32(qBound(0.0, s * cells, cells - 1.0));
+    quint32 j = quint32(qBound(0.0, t * cells, cells - 1.0));
+    return cellId(face, MaxLevel, i, j);
+}
+
+void PointIndex::build(const QVector<float> &positions)
+{
+    const int n = positions.size() / 2;
+    QVector<QPair<quint64, int>> entries(n);
+    QVector<QVector3D> directions(n);
+    for (int k = 0; k < n; k++) {
+        directions[k] = direction(positions[2 * k], positions[2 * k + 1]);
+        entries[k] = qMakePair(leafId(directions[k]), k);
+    }
+    std::sort(entries.begin(), entries.end());
+
+    m_ids.resize(n);
+    m_points.resize(n);
+    m_directions.resize(n);
+    for (int k = 0; k < n; k++) {
+        m_ids[k] = entries[k].first;
+        m_points[k] = entries[k].second;
+        m_directions[k] = directions[entries[k].second];
+    }
+}
+
+PointIndex::Cell PointIndex::faceCell(int face) const
+{
+    Cell cell = { face, 0, 0, 0, 0, 0 };
+    quint64 begin = quint64(face) << (2 * MaxLevel);
+    quint64 end = quint64(face + 1) << (2 * MaxLevel);
+    cell.begin = std::lower_bound(m_ids.begin(), m_ids.end(), begin) - m_ids.begin();
+    cell.end = std::lower_bound(m_ids.begin(), m_ids.end(), end) - m_ids.begin();
+    return cell;
+}
+
+/*!
+ * \brief PointIndex::child
+ * \param k: 0 to 3, bit 0 for the upper half in i, bit 1 in j
+ */
+PointIndex::Cell PointIndex::child(const Cell &cell, int k) const
+{
+    Cell c = { cell.face, cell.level + 1, cell.i * 2 + (k & 1), cell.j * 2 + (k >> 1),
+               0, 0 };
+    quint64 begin = cellId(c.face, c.level, c.i, c.j);
+    quint64 end = begin + (Q_UINT64_C(1) << (2 * (MaxLevel - c.level)));
+    auto first = m_ids.begin() + cell.begin;
+    auto last = m_ids.begin() + cell.end;
+    c.begin = std::lower_bound(first, last, begin) - m_ids.begin();
+    c.end = std::lower_bound(first, last, end) - m_ids.begin();
+    return c;
+}
+
+/*!
+ * \brief PointIndex::bound
+ * Cell edges are great circles, so the corners are the points of a cell
+ * farthest from its center.
+ */
+void PointIndex::bound(const Cell &cell, QVector3D *center, double *radius) const
+{
+    double size = 2.0 / (1u << cell.level);
+    double u = cell.i * size - 1;
+    double v = cell.j * size - 1;
+    *center = fromFace(cell.face, u + size / 2, v + size / 2);
+    *radius = 0;
+    for (int k = 0; k < 4; k++) {
+        QVector3D corner = fromFace(cell.face, u + (k & 1) * size, v + (k >> 1) * size);
+        *radius = qMax(*radius, angleBetween(*center, corner));
+    }
+    // float directions
+    *radius += 1e-6;
+}
+
+int PointIndex::nearest(const QVector3D &direction, double maxAngle) const
+{
+    struct Candidate {
+        double bound;
+        Cell cell;
+        // std::priority_queue puts the largest on top
+        bool operator<(const Candidate &other) const { return bound > other.bound; }
+    };
+
+    // cells by the least angle any of their points can have
+    std::priority_queue<Candidate> queue;
+    for (int face = 0; face < 6; face++) {
+        Cell cell = faceCell(face);
+        if (cell.begin < cell.end) {
+            queue.push(Candidate{ 0, cell });
+        }
+    }
+
+    int best = -1;
+    double bestAngle = maxAngle;
+    while (!queue.empty()) {
+        Candidate top = queue.top();
+        queue.pop();
+        if (top.bound > bestAngle) {
+            break;
+        }
+        const Cell &cell = top.cell;
+        if (cell.end - cell.begin <= ScanSize || cell.level == MaxLevel) {
+            for (int k = cell.begin; k < cell.end; k++) {
+                double angle = angleBetween(direction, m_directions[k]);
+                if (angle <= bestAngle) {
+                    bestAngle = angle;
+                    best = m_points[k];
+                }
+            }
+            continue;
+        }
+        for (int k = 0; k < 4; k++) {
+            Cell c = child(cell, k);
+            if (c.begin == c.end) {
+                continue;
+            }
+            QVector3D center;
+            double radius;
+            bound(c, &center, &radius);
+            double lower = qMax(0.0, angleBetween(direction, center) - radius);
+            if (lower <= bestAngle) {
+                queue.push(Candidate{ lower, c });
+            }
+        }
+    }
+    return best;
+}
+
+QVector<int> PointIndex::within(const QVector3D &center, double angle) const
+{
+    QVector<int> out;
+    for (int face = 0; face < 6; face++) {
+        Cell cell = faceCell(face);
+        if (cell.begin < cell.end) {
+            collect(cell, center, angle, out);
+        }
+    }
+    return out;
+}
+
+void PointIndex::collect(const Cell &cell, const QVector3D &center, double angle,
+                         QVector<int> &out) const
+{
+    QVector3D cellCenter;
+    double radius;
+    bound(cell, &cellCenter, &radius);
+    double distance = angleBetween(center, cellCenter);
+    if (distance - radius > angle) {
+        return;
+    }
+    // whole cells inside the cap need no test per point
+    if (distance + radius <= angle) {
+        for (int k = cell.begin; k < cell.end; k++) {
+            out << m_points[k];
+        }
+        return;
+    }
+    if (cell.end - cell.begin <= ScanSize || cell.level == MaxLevel) {
+        for (int k = cell.begin; k < cell.end; k++) {
+            if (angleBetween(center, m_directions[k]) <= angle) {
+                out << m_points[k];
+            }
+        }
+        return;
+    }
+    for (int k = 0; k < 4; k++) {
+        Cell c = child(cell, k);
+        if (c.begin < c.end) {
+            collect(c, center, angle, out);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef POINTINDEX_H
+#define POINTINDEX_H
+
+#include <QVector>
+#include <QVector3D>
+
+/*!
+ * \brief The PointIndex class
+ * Spatial index over the points of a PointLayer, in the manner of S2: the
+ * sphere is projected onto the six faces of a cube, each face is a
+ * quadtree, and every point gets the Z-order id of its leaf cell. Points
+ * are kept sorted by id, so any cell is one contiguous range and queries
+ * descend from the faces, pruning cells by their bounding caps.
+ *
+ * Immutable once built, so any thread may query it.
+ */
+class PointIndex
+{
+public:
+    // leaf cells are about 10 m across on the earth
+    static const int MaxLevel = 20;
+    // cells with fewer points are scanned instead of split further
+    static const int ScanSize = 32;
+
+    PointIndex();
+
+    // from PointLayer::positions(), two model space radians per point
+    void build(const QVector<float> &positions);
+    int count() const { return m_points.size(); }
+
+    // nearest point no farther than maxAngle radians, -1 if there is none
+    int nearest(const QVector3D &direction, double maxAngle) const;
+    // every point within angle radians, in no particular order
+    QVector<int> within(const QVector3D &center, double angle) const;
+
+    static QVector3D direction(float lon, float lat);
+    static quint64 leafId(const QVector3D &direction);
+
+protected:
+    struct Cell {
+        int face;
+        int level;
+        quint32 i;
+        quint32 j;
+        // of m_ids
+        int begin;
+        int end;
+    };
+
+    Cell faceCell(int face) const;
+    Cell child(const Cell &cell, int k) const;
+    void bound(const Cell &cell, QVector3D *center, double *radius) const;
+    void collect(const Cell &cell, const QVector3D &center, double angle,
+                 QVector<int> &out) const;
+
+private:
+    // sorted leaf ids, with the layer index and direction of each point
+    QVector<quint64> m_ids;
+    QVector<int> m_points;
+    QVector<QVector3D> m_directions;
+};
+
+#endif // POINTINDEX_H
@@ -0,0 +1,125 @@
+#include <QtMath>
+#include "pointlayer.h"
+
+PointLayer::PointLayer(QObject *parent)
+    : QObject(parent)
+    , m_referenceDistance(2.5)
+{
+}
+
+void PointLayer::clear()
+{
+    if (m_sizes.isEmpty()) {
+        return;
+    }
+    m_positions.clear();
+    m_colors.clear();
+    m_sizes.clear();
+    m_dirty.clear();
+    emit changed();
+}
+
+void PointLayer::reserve(int count)
+{
+    m_positions.reserve(count * 2);
+    m_colors.reserve(count * 4);
+    m_sizes.reserve(count);
+    m_dirty.reserve((count + ChunkSize - 1) / ChunkSize);
+}
+
+void PointLayer::append(const QVector<Point> &points)
+{
+    if (points.isEmpty()) {
+        return;
+    }
+    int first = count();
+    int total = first + points.size();
+    m_positions.resize(total * 2);
+    m_colors.resize(total * 4);
+    m_sizes.resize(total);
+    m_dirty.resize((total + ChunkSize - 1) / ChunkSize);
+    for (int k = 0; k < points.size(); k++) {
+        store(first + k, points[k]);
+    }
+    emit changed();
+}
+
+void PointLayer::setPoint(int index, const Point &point)
+{
+    Q_ASSERT(index >= 0 && index < count());
+    store(index, point);
+    emit changed();
+}
+
+void PointLayer::setPositions(const QVector<int> &indices, const QVector<QPointF> &lonLat)
+{
+    Q_ASSERT(indices.size() == lonLat.size());
+    for (int k = 0; k < indices.size(); k++) {
+        storePosition(indices[k], lonLat[k].x(), lonLat[k].y());
+        markDirty(indices[k], Position);
+    }
+    emit changed();
+}
+
+void PointLayer::setColors(const QVector<int> &indices, const QVector<QRgb> &colors)
+{
+    Q_ASSERT(indices.size() == colors.size());
+    for (int k = 0; k < indices.size(); k++) {
+        uchar *c = m_colors.data() + indices[k] * 4;
+        c[0] = qRed(colors[k]);
+        c[1] = qGreen(colors[k]);
+        c[2] = qBlue(colors[k]);
+        c[3] = qAlpha(colors[k]);
+        markDirty(indices[k], Color);
+    }
+    emit changed();
+}
+
+void PointLayer::setReferenceDistance(double distance)
+{
+    if (m_referenceDistance == distance) {
+        return;
+    }
+    m_referenceDistance = distance;
+    emit changed();
+}
+
+void PointLayer::clearDirty()
+{
+    m_dirty.fill(0);
+}
+
+void PointLayer::store(int index, const Point &point)
+{
+    storePosition(index, point.lon, point.lat);
+    uchar *c = m_colors.data() + index * 4;
+    c[0] = qRed(point.color);
+    c[1] = qGreen(point.color);
+    c[2] = qBlue(point.color);
+    c[3] = qAlpha(point.color);
+    m_sizes[index] = uchar(qBound(1, point.size, 255));
+    markDirty(index, AllAttributes);
+}
+
+/*!
+ * \brief PointLayer::modelPosition
+ * The globe texture starts at 180 degrees west and runs westward in model
+ * space, see texlighting_patch.vert.
+ */
+QPointF PointLayer::modelPosition(double lon, double lat)
+{
+    return QPointF(M_PI - qDegreesToRadians(lon),
+                   qDegreesToRadians(qBound(-90.0, lat, 90.0)));
+}
+
+void PointLayer::storePosition(int index, double lon, double lat)
+{
+    QPointF p = modelPosition(lon, lat);
+    m_positions[index * 2] = float(p.x());
+    m_positions[index * 2 + 1] = float(p.y());
+}
+
+void PointLayer::markDirty(int index, int attributes)
+{
+    m_dirty[index / ChunkSize] |= attributes;
+}
@@ -0,0 +1,90 @@
+#ifndef POINTLAYER_H
+#define POINTLAYER_H
+
+#include <QObject>
+#include <QPointF>
+#include <QRgb>
+#include <QVector>
+
+/*!
+ * \brief The PointLayer class
+ * Geo-located markers drawn on the globe, kept as one array per attribute
+ * in the layout PointDrawer uploads: longitude and latitude as floats, an
+ * RGBA8 colour and a size in pixels of one byte each. Edits mark chunks of
+ * points dirty, so only those are uploaded again.
+ *
+ * Lives on the GUI thread, renderers read it during synchronize.
+ */
+class PointLayer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Point {
+        // degrees, east and north
+        double lon;
+        double lat;
+        QRgb color;
+        // pixels at the reference distance, up to 255
+        int size;
+    };
+
+    enum Attribute {
+        Position = 0x1,
+        Color = 0x2,
+        Size = 0x4,
+        AllAttributes = Position | Color | Size,
+    };
+
+    // points per dirty flag
+    static const int ChunkSize = 1024;
+
+    explicit PointLayer(QObject *parent = nullptr);
+
+    int count() const { return m_sizes.size(); }
+    void clear();
+    // room for this many points without reallocating, see PointDrawer::sync
+    void reserve(int count);
+    int capacity() const { return m_sizes.capacity(); }
+    void append(const QVector<Point> &points);
+    void setPoint(int index, const Point &point);
+    // a moving subset, only their positions are uploaded again
+    void setPositions(const QVector<int> &indices, const QVector<QPointF> &lonLat);
+    void setColors(const QVector<int> &indices, const QVector<QRgb> &colors);
+
+    // eye distance, in globe radii, up to which markers have their full size
+    double referenceDistance() const { return m_referenceDistance; }
+    void setReferenceDistance(double distance);
+
+    // model space longitude and latitude in radians, two per point
+    const float *positions() const { return m_positions.constData(); }
+    // the same as a shared copy, for PointIndex::build on another thread
+    QVector<float> positionData() const { return m_positions; }
+    // four per point
+    const uchar *colors() const { return m_colors.constData(); }
+    const uchar *sizes() const { return m_sizes.constData(); }
+
+    int chunkCount() const { return m_dirty.size(); }
+    // Attribute flags changed in a chunk since the last clearDirty()
+    int dirty(int chunk) const { return m_dirty[chunk]; }
+    void clearDirty();
+
+    // degrees to the model space radians of positions()
+    static QPointF modelPosition(double lon, double lat);
+
+signals:
+    void changed();
+
+protected:
+    void store(int index, const Point &point);
+    void storePosition(int index, double lon, double lat);
+    void markDirty(int index, int attributes);
+
+private:
+    QVector<float> m_positions;
+    QVector<uchar> m_colors;
+    QVector<uchar> m_sizes;
+    QVector<uchar> m_dirty;
+    double m_referenceDistance;
+};
+
+#endif // POINTLAYER_H
@@ -0,0 +1,298 @@
+#include <QColor>
+#include <QFile>
+#include <QMutexLocker>
+#include <QtConcurrent>
+#include <QtEndian>
+#include "pointloader.h"
+
+// for CSV files without colour and size columns
+static const QRgb DefaultColor = qRgb(255, 64, 0);
+static const int DefaultSize = 6;
+
+PointLoader::PointLoader(PointLayer *layer, QObject *parent)
+    : QObject(parent)
+    , m_layer(layer)
+    , m_cancelled(0)
+    , m_total(-1)
+    , m_base(0)
+    , m_loaded(0)
+{
+    connect(&m_watcher, &QFutureWatcher<bool>::finished, this, &PointLoader::done);
+}
+
+PointLoader::~PointLoader()
+{
+    cancel();
+}
+
+void PointLoader::load(const QString &fileName)
+{
+    cancel();
+    m_cancelled.store(0);
+    m_total = -1;
+    m_base = m_layer->count();
+    m_loaded = 0;
+    m_future = QtConcurrent::run([this, fileName]() {
+        int total = -1;
+        return read(fileName, [this, &total](const QVector<PointLayer::Point> &batch) {
+            return push(batch, total);
+        }, &total);
+    });
+    m_watcher.setFuture(m_future);
+}
+
+void PointLoader::cancel()
+{
+    m_cancelled.store(1);
+    m_future.waitForFinished();
+    QMutexLocker locker(&m_mutex);
+    m_batches.clear();
+}
+
+/*!
+ * \brief PointLoader::push
+ * Worker side: queue a batch and wake deliver() unless it is already due.
+ */
+bool PointLoader::push(const QVector<PointLayer::Point> &batch, int total)
+{
+    if (m_cancelled.load()) {
+        return false;
+    }
+    QMutexLocker locker(&m_mutex);
+    bool wake = m_batches.isEmpty();
+    m_batches << batch;
+    m_total = total;
+    if (wake) {
+        QMetaObject::invokeMethod(this, "deliver", Qt::QueuedConnection);
+    }
+    return true;
+}
+
+void PointLoader::deliver()
+{
+    QList<QVector<PointLayer::Point>> batches;
+    int total;
+    {
+        QMutexLocker locker(&m_mutex);
+        batches.swap(m_batches);
+        total = m_total;
+    }
+    if (batches.isEmpty()) {
+        return;
+    }
+    // one buffer of the final size, instead of growing it batch by batch
+    if (total > 0 && m_loaded == 0) {
+        m_layer->reserve(m_base + total);
+    }
+    for (const QVector<PointLayer::Point> &batch : batches) {
+        m_layer->append(batch);
+        m_loaded += batch.size();
+    }
+    emit progress(m_loaded);
+}
+
+void PointLoader::done()
+{
+    // whatever arrived after the last deliver() was queued
+    deliver();
+    if (!m_cancelled.load()) {
+        emit finished(m_future.result());
+    }
+}
+
+bool PointLoader::read(const QString &fileName, const Sink &sink, int *total)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("PointLoader: can not read %s", qPrintable(fileName));
+        return false;
+    }
+    bool ok = fileName.endsWith(QStringLiteral(".points"), Qt::CaseInsensitive)
+              ? readBinary(file, sink, total) : readCsv(file, sink);
+    if (!ok) {
+        qWarning("PointLoader: %s is damaged or was cancelled", qPrintable(fileName));
+    }
+    return ok;
+}
+
+/*!
+ * \brief PointLoader::readCsv
+ * Columns are found by a header line naming lon (or lng, longitude) and lat
+ * (or latitude), and optionally color and size. Without one they are lon,
+ * lat, color and size in this order. Colours are anything QColor parses.
+ * Quoted fields are not supported, lines that do not parse are skipped.
+ */
+bool PointLoader::readCsv(QIODevice &file, const Sink &sink)
+{
+    int lonColumn = 0;
+    int latColumn = 1;
+    int colorColumn = 2;
+    int sizeColumn = 3;
+    bool firstLine = true;
+
+    QVector<PointLayer::Point> batch;
+    batch.reserve(BatchSize);
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        QList<QByteArray> fields = line.split(',');
+        if (firstLine) {
+            firstLine = false;
+            bool numeric = false;
+            fields[0].toDouble(&numeric);
+            if (!numeric) {
+                lonColumn = latColumn = colorColumn = sizeColumn = -1;
+                for (int k = 0; k < fields.size(); k++) {
+                    QByteArray name = fields[k].trimmed().toLower();
+                    if (name == "lon" || name == "lng" || name == "longitude") {
+                        lonColumn = k;
+                    } else if (name == "lat" || name == "latitude") {
+                        latColumn = k;
+                    } else if (name == "color" || name == "colour") {
+                        colorColumn = k;
+                    } else if (name == "size") {
+                        sizeColumn = k;
+                    }
+                }
+                if (lonColumn < 0 || latColumn < 0) {
+                    return false;
+                }
+                continue;
+            }
+        }
+
+        PointLayer::Point p;
+        bool lonOk = false;
+        bool latOk = false;
+        p.lon = fields.value(lonColumn).trimmed().toDouble(&lonOk);
+        p.lat = fields.value(latColumn).trimmed().toDouble(&latOk);
+        if (!lonOk || !latOk) {
+            continue;
+        }
+        p.color = DefaultColor;
+        if (colorColumn >= 0 && colorColumn < fields.size()) {
+            QColor color(QString::fromLatin1(fields[colorColumn].trimmed()));
+            if (color.isValid()) {
+                p.color = color.rgba();
+            }
+        }
+        p.size = DefaultSize;
+        if (sizeColumn >= 0 && sizeColumn < fields.size()) {
+            bool sizeOk = false;
+            int size = fields[sizeColumn].trimmed().toInt(&sizeOk);
+            if (sizeOk) {
+                p.size = size;
+            }
+        }
+
+        batch << p;
+        if (batch.size() == BatchSize) {
+            if (!sink(batch)) {
+                return false;
+            }
+            batch.clear();
+        }
+    }
+    return batch.isEmpty() || sink(batch);
+}
+
+bool PointLoader::readBinary(QIODevice &file, const Sink &sink, int *total)
+{
+    uchar header[16];
+    if (file.read(reinterpret_cast<char *>(header), sizeof(header)) != sizeof(header)
+        || qFromLittleEndian<quint32>(header) != Magic
+        || qFromLittleEndian<quint32>(header + 4) != Version) {
+        return false;
+    }
+    quint32 remaining = qFromLittleEndian<quint32>(header + 8);
+    if (remaining > quint32(INT_MAX)) {
+        return false;
+    }
+    if (total) {
+        *total = int(remaining);
+    }
+
+    QVector<PointLayer::Point> batch;
+    while (remaining > 0) {
+        uchar count[4];
+        if (file.read(reinterpret_cast<char *>(count), sizeof(count)) != sizeof(count)) {
+            return false;
+        }
+        int n = int(qFromLittleEndian<quint32>(count));
+        if (n <= 0 || n > BatchSize || quint32(n) > remaining) {
+            return false;
+        }
+        QByteArray block = file.read(n * 13);
+        if (block.size() != n * 13) {
+            return false;
+        }
+
+        const uchar *lon = reinterpret_cast<const uchar *>(block.constData());
+        const uchar *lat = lon + n * 4;
+        const uchar *rgba = lat + n * 4;
+        const uchar *size = rgba + n * 4;
+        batch.resize(n);
+        for (int k = 0; k < n; k++) {
+            PointLayer::Point &p = batch[k];
+            p.lon = qFromLittleEndian<qint32>(lon + k * 4) * 1e-7;
+            p.lat = qFromLittleEndian<qint32>(lat + k * 4) * 1e-7;
+            const uchar *c = rgba + k * 4;
+            p.color = qRgba(c[0], c[1], c[2], c[3]);
+            p.size = size[k];
+        }
+        if (!sink(batch)) {
+            return false;
+        }
+        remaining -= n;
+    }
+    return true;
+}
+
+bool PointLoader::write(const QString &fileName, const QVector<PointLayer::Point> &points)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning("PointLoader: can not write %s", qPrintable(fileName));
+        return false;
+    }
+    uchar header[16];
+    qToLittleEndian<quint32>(Magic, header);
+    qToLittleEndian<quint32>(Version, header + 4);
+    qToLittleEndian<quint32>(points.size(), header + 8);
+    qToLittleEndian<quint32>(0, header + 12);
+    if (file.write(reinterpret_cast<const char *>(header), sizeof(header))
+        != sizeof(header)) {
+        return false;
+    }
+
+    QByteArray block;
+    for (int first = 0; first < points.size(); first += BatchSize) {
+        int n = qMin(BatchSize, points.size() - first);
+        block.resize(4 + n * 13);
+        uchar *data = reinterpret_cast<uchar *>(block.data());
+        qToLittleEndian<quint32>(n, data);
+        uchar *lon = data + 4;
+        uchar *lat = lon + n * 4;
+        uchar *rgba = lat + n * 4;
+        uchar *size = rgba + n * 4;
+        for (int k = 0; k < n; k++) {
+            const PointLayer::Point &p = points[first + k];
+            qint32 x = qRound(qBound(-180.0, p.lon, 180.0) * 1e7);
+            qint32 y = qRound(qBound(-90.0, p.lat, 90.0) * 1e7);
+            qToLittleEndian<qint32>(x, lon + k * 4);
+            qToLittleEndian<qint32>(y, lat + k * 4);
+            uchar *c = rgba + k * 4;
+            c[0] = qRed(p.color);
+            c[1] = qGreen(p.color);
+            c[2] = qBlue(p.color);
+            c[3] = qAlpha(p.color);
+            size[k] = uchar(qBound(1, p.size, 255));
+        }
+        if (file.write(block) != block.size()) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef POINTLOADER_H
+#define POINTLOADER_H
+
+#include <functional>
+#include <QAtomicInt>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include "pointlayer.h"
+
+class QIODevice;
+
+/*!
+ * \brief The PointLoader class
+ * Reads a point file on a worker thread and hands the points to a
+ * PointLayer in batches, so they show up while the rest is still parsed.
+ *
+ * Two formats: CSV with lon and lat columns, optionally colour and size,
+ * and .points files, blocks of points in the layout of PointLayer:
+ *
+ *     header  magic "EGPT", version, point count, reserved (quint32 each)
+ *     block   point count n (quint32), then n longitudes and n latitudes
+ *             (qint32, 1e-7 degrees), n RGBA colours, n sizes (uchar)
+ *
+ * all little endian.
+ */
+class PointLoader : public QObject
+{
+    Q_OBJECT
+public:
+    static const quint32 Magic = 0x54504745;
+    static const quint32 Version = 1;
+    // points per batch and per block of a .points file
+    static const int BatchSize = 65536;
+
+    // returns false to stop reading
+    typedef std::function<bool(const QVector<PointLayer::Point> &batch)> Sink;
+
+    explicit PointLoader(PointLayer *layer, QObject *parent = nullptr);
+    // stops reading and waits for the worker
+    ~PointLoader();
+
+    // appends to the layer, after any load still running is cancelled
+    void load(const QString &fileName);
+    void cancel();
+    bool isLoading() const { return m_future.isRunning(); }
+
+    // blocking, for tools; the total is reported before the first batch
+    // when the file knows it, see PointLayer::reserve
+    static bool read(const QString &fileName, const Sink &sink, int *total = nullptr);
+    static bool write(const QString &fileName, const QVector<PointLayer::Point> &points);
+
+signals:
+    void progress(int points);
+    void finished(bool ok);
+
+private slots:
+    void deliver();
+    void done();
+
+protected:
+    static bool readCsv(QIODevice &file, const Sink &sink);
+    static bool readBinary(QIODevice &file, const Sink &sink, int *total);
+    bool push(const QVector<PointLayer::Point> &batch, int total);
+
+private:
+    PointLayer *m_layer;
+    QFuture<bool> m_future;
+    QFutureWatcher<bool> m_watcher;
+    QAtomicInt m_cancelled;
+    // filled by the worker, drained by deliver() on the GUI thread
+    QMutex m_mutex;
+    QList<QVector<PointLayer::Point>> m_batches;
+    int m_total;
+    // layer count when the load started, and points appended since
+    int m_base;
+    int m_loaded;
+};
+
+#endif // POINTLOADER_H
@@ -0,0 +1,218 @@
+#include <cstddef>
+#include <QOpenGLContext>
+#include "polylinedrawer.h"
+
+#define TO_OFFSET(x) reinterpret_cast<const void*>(x)
+
+namespace {
+// along the segment from 0 to 1, across it from -1 to 1
+const GLfloat StripCorners[] = { 0, -1, 0, 1, 1, -1, 1, 1 };
+const GLfloat TriangleCorners[] = { 0, -1, 1, -1, 0, 1, 0, 1, 1, -1, 1, 1 };
+
+// one corner of the Triangles method
+struct Vertex {
+    GLfloat corner[2];
+    PolylineLayer::Segment segment;
+};
+}
+
+PolylineDrawer::PolylineDrawer()
+    : m_initialized(false), m_method(Triangles)
+    , m_drawArraysInstanced(nullptr), m_vertexAttribDivisor(nullptr)
+    , m_serial(-1), m_level(-1)
+{
+    m_locations.corner = m_locations.start = m_locations.end = -1;
+    m_locations.color = m_locations.width = -1;
+}
+
+void PolylineDrawer::resolveFunctions()
+{
+    if (m_initialized) {
+        return;
+    }
+    initializeOpenGLFunctions();
+    m_initialized = true;
+
+    auto ctx = QOpenGLContext::currentContext();
+    auto version = ctx->format().version();
+    bool isES = ctx->isOpenGLES();
+    QByteArray suffix;
+    if (isES && version < qMakePair(3, 0)) {
+        if (ctx->hasExtension(QByteArrayLiteral("GL_ANGLE_instanced_arrays"))) {
+            suffix = "ANGLE";
+        } else if (ctx->hasExtension(QByteArrayLiteral("GL_EXT_instanced_arrays"))) {
+            suffix = "EXT";
+        } else {
+            return;
+        }
+    } else if (!isES && version < qMakePair(3, 3)) {
+        if (!ctx->hasExtension(QByteArrayLiteral("GL_ARB_instanced_arrays"))) {
+            return;
+        }
+        suffix = "ARB";
+    }
+    m_drawArraysInstanced = reinterpret_cast<DrawArraysInstanced>(
+                                ctx->getProcAddress("glDrawArraysInstanced" + suffix));
+    m_vertexAttribDivisor = reinterpret_cast<VertexAttribDivisor>(
+                                ctx->getProcAddress("glVertexAttribDivisor" + suffix));
+    if (m_drawArraysInstanced && m_vertexAttribDivisor) {
+        m_method = Instanced;
+    }
+}
+
+PolylineDrawer::Method PolylineDrawer::method()
+{
+    resolveFunctions();
+    return m_method;
+}
+
+void PolylineDrawer::setLocations(const Locations &locations)
+{
+    m_locations = locations;
+}
+
+void PolylineDrawer::createBuffers()
+{
+    m_vao.create();
+    m_vao.bind();
+
+    if (m_method == Instanced && m_locations.corner >= 0) {
+        // one triangle strip quad, instanced for every segment
+        m_corners.create();
+        m_corners.bind();
+        m_corners.allocate(StripCorners, sizeof(StripCorners));
+        glVertexAttribPointer(m_locations.corner, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glEnableVertexAttribArray(m_locations.corner);
+    }
+
+    m_segments.create();
+    m_segments.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    m_vao.release();
+}
+
+/*!
+ * \brief PolylineDrawer::sync
+ * Lines are loaded once, so a change uploads all levels and nothing is
+ * patched in place.
+ */
+void PolylineDrawer::sync(PolylineLayer *layer)
+{
+    if (layer->serial() == m_serial) {
+        return;
+    }
+    resolveFunctions();
+    if (!m_vao.isCreated()) {
+        createBuffers();
+    }
+    m_serial = layer->serial();
+    m_level = -1;
+    m_offsets.clear();
+
+    QSharedPointer<const PolylineLayer::Levels> levels = layer->levels();
+    if (!levels) {
+        m_segments.bind();
+        m_segments.allocate(0);
+        return;
+    }
+    for (int offset : levels->offsets) {
+        m_offsets << offset;
+    }
+
+    const QVector<PolylineLayer::Segment> &segments = levels->segments;
+    m_segments.bind();
+    if (m_method == Instanced) {
+        m_segments.allocate(segments.constData(),
+                            segments.size() * sizeof(PolylineLayer::Segment));
+        return;
+    }
+    QVector<Vertex> vertices(segments.size() * 6);
+    for (int k = 0; k < vertices.size(); k++) {
+        vertices[k].corner[0] = TriangleCorners[(k % 6) * 2];
+        vertices[k].corner[1] = TriangleCorners[(k % 6) * 2 + 1];
+        vertices[k].segment = segments[k / 6];
+    }
+    m_segments.allocate(vertices.constData(), vertices.size() * sizeof(Vertex));
+}
+
+int PolylineDrawer::segmentCount(int level) const
+{
+    if (m_offsets.isEmpty()) {
+        return 0;
+    }
+    return m_offsets[level + 1] - m_offsets[level];
+}
+
+/*!
+ * \brief PolylineDrawer::pointAttributes
+ * Every level starts at its own offset into the buffer, the attributes are
+ * pointed there instead of using base instances, which ES lacks.
+ */
+void PolylineDrawer::pointAttributes(int level)
+{
+    typedef PolylineLayer::Segment Segment;
+    bool instanced = m_method == Instanced;
+    GLsizei stride = instanced ? sizeof(Segment) : sizeof(Vertex);
+    size_t base = instanced ? m_offsets[level] * sizeof(Segment)
+                  : m_offsets[level] * 6 * sizeof(Vertex) + offsetof(Vertex, segment);
+
+    struct {
+        int location;
+        int components;
+        GLenum type;
+        GLboolean normalized;
+        size_t offset;
+    } attributes[] = {
+        { m_locations.start, 2, GL_FLOAT, GL_FALSE, offsetof(Segment, start) },
+        { m_locations.end, 2, GL_FLOAT, GL_FALSE, offsetof(Segment, end) },
+        { m_locations.color, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Segment, color) },
+        { m_locations.width, 1, GL_UNSIGNED_BYTE, GL_FALSE, offsetof(Segment, width) },
+    };
+    m_segments.bind();
+    if (!instanced && m_locations.corner >= 0) {
+        glVertexAttribPointer(m_locations.corner, 2, GL_FLOAT, GL_FALSE, stride,
+                              TO_OFFSET(m_offsets[level] * 6 * sizeof(Vertex)
+                                        + offsetof(Vertex, corner)));
+        glEnableVertexAttribArray(m_locations.corner);
+    }
+    for (auto &a : attributes) {
+        if (a.location < 0) {
+            continue;
+        }
+        glVertexAttribPointer(a.location, a.components, a.type, a.normalized, stride,
+                              TO_OFFSET(base + a.offset));
+        glEnableVertexAttribArray(a.location);
+        if (instanced) {
+            m_vertexAttribDivisor(a.location, 1);
+        }
+    }
+    m_level = level;
+}
+
+void PolylineDrawer::draw(int level)
+{
+    int count = segmentCount(level);
+    if (count == 0) {
+        return;
+    }
+
+    m_vao.bind();
+    if (level != m_level) {
+        pointAttributes(level);
+    }
+    if (m_method == Instanced) {
+        m_drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, count * 6);
+    }
+    m_vao.release();
+}
+
+void PolylineDrawer::destroy()
+{
+    m_vao.destroy();
+    m_corners.destroy();
+    m_segments.destroy();
+    m_offsets.clear();
+    m_serial = -1;
+    m_level = -1;
+}
@@ -0,0 +1,74 @@
+#ifndef POLYLINEDRAWER_H
+#define POLYLINEDRAWER_H
+
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QOpenGLVertexArrayObject>
+#include "polylinelayer.h"
+
+/*!
+ * \brief The PolylineDrawer class
+ * GPU side of a PolylineLayer: the segments of all levels in one buffer,
+ * uploaded once per change of the lines, and one draw call per frame for
+ * the level in use.
+ */
+class PolylineDrawer : protected QOpenGLFunctions
+{
+public:
+    enum Method {
+        // a quad per segment, GL 3.3 / ES 3.0 or instanced_arrays
+        Instanced,
+        // the quads written out as two triangles each, six times the memory
+        Triangles,
+    };
+
+    struct Locations {
+        int corner;
+        int start;
+        int end;
+        int color;
+        int width;
+    };
+
+    PolylineDrawer();
+
+    Method method();
+    // attributes of the program that draws the lines, before the first sync()
+    void setLocations(const Locations &locations);
+
+    // upload the layer if its lines changed, in synchronize
+    void sync(PolylineLayer *layer);
+    void draw(int level);
+    void destroy();
+
+    bool isEmpty() const { return m_offsets.isEmpty(); }
+    int segmentCount(int level) const;
+
+protected:
+    void resolveFunctions();
+    void createBuffers();
+    void pointAttributes(int level);
+
+private:
+    typedef void (QOPENGLF_APIENTRYP DrawArraysInstanced)(GLenum mode, GLint first,
+                                                          GLsizei count,
+                                                          GLsizei instanceCount);
+    typedef void (QOPENGLF_APIENTRYP VertexAttribDivisor)(GLuint index, GLuint divisor);
+
+    bool m_initialized;
+    Method m_method;
+    DrawArraysInstanced m_drawArraysInstanced;
+    VertexAttribDivisor m_vertexAttribDivisor;
+
+    Locations m_locations;
+    QOpenGLVertexArrayObject m_vao;
+    QOpenGLBuffer m_corners;
+    QOpenGLBuffer m_segments;
+    // of PolylineLayer::Levels, empty when there is nothing to draw
+    QVector<int> m_offsets;
+    int m_serial;
+    // level the attributes point at
+    int m_level;
+};
+
+#endif // POLYLINEDRAWER_H
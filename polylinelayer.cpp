@@ -0,0 +1,351 @@
+#include <cmath>
+#include <limits>
+#include <QColor>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtConcurrent>
+#include <QtMath>
+#include "polylinelayer.h"
+
+// level 0 keeps vertices off by 0.02 radians, about 130 km, or more
+static const double CoarsestTolerance = 0.02;
+// longer edges are split along the great circle first, so no chord dips
+// further below the globe than the lift of the lines makes up for
+static const double MaxEdgeAngle = qDegreesToRadians(1.0);
+// for lines from GeoJSON without stroke properties
+static const QRgb DefaultColor = qRgb(255, 220, 80);
+static const int DefaultWidth = 2;
+
+PolylineLayer::PolylineLayer(QObject *parent)
+    : QObject(parent)
+    , m_serial(0)
+    , m_pixelError(1.0)
+{
+    connect(&m_watcher, &QFutureWatcher<QSharedPointer<const Levels>>::finished,
+            this, &PolylineLayer::loaded);
+}
+
+PolylineLayer::~PolylineLayer()
+{
+    m_watcher.waitForFinished();
+}
+
+void PolylineLayer::setLines(const QVector<Line> &lines)
+{
+    setLevels(build(lines));
+}
+
+void PolylineLayer::load(const QString &fileName)
+{
+    bool wasLoading = isLoading();
+    m_watcher.setFuture(QtConcurrent::run([fileName]() {
+        QVector<Line> lines;
+        if (!readGeoJson(fileName, &lines)) {
+            return QSharedPointer<const Levels>();
+        }
+        return build(lines);
+    }));
+    if (!wasLoading) {
+        emit loadingChanged();
+    }
+}
+
+void PolylineLayer::loaded()
+{
+    setLevels(m_watcher.result());
+    emit loadingChanged();
+}
+
+void PolylineLayer::clear()
+{
+    setLevels(QSharedPointer<const Levels>());
+}
+
+void PolylineLayer::setLevels(const QSharedPointer<const Levels> &levels)
+{
+    if (!m_levels && !levels) {
+        return;
+    }
+    m_levels = levels;
+    m_serial++;
+    emit changed();
+}
+
+void PolylineLayer::setPixelError(double pixels)
+{
+    if (m_pixelError == pixels) {
+        return;
+    }
+    m_pixelError = pixels;
+    emit changed();
+}
+
+double PolylineLayer::tolerance(int level)
+{
+    if (level >= LevelCount - 1) {
+        return 0;
+    }
+    return CoarsestTolerance / (1 << level);
+}
+
+int PolylineLayer::level(double tolerance)
+{
+    if (tolerance >= CoarsestTolerance) {
+        return 0;
+    }
+    if (tolerance <= 0) {
+        return LevelCount - 1;
+    }
+    int level = qCeil(std::log2(CoarsestTolerance / tolerance));
+    return qBound(0, level, LevelCount - 1);
+}
+
+static QVector3D toSphere(const QPointF &lonLat)
+{
+    // model space, see PointLayer::modelPosition
+    double lon = M_PI - qDegreesToRadians(lonLat.x());
+    double lat = qDegreesToRadians(qBound(-90.0, lonLat.y(), 90.0));
+    return QVector3D(qCos(lat) * qCos(lon), qSin(lat), qCos(lat) * qSin(lon));
+}
+
+static double distanceToChord(const QVector3D &p, const QVector3D &a, const QVector3D &b)
+{
+    QVector3D ab = b - a;
+    double length = ab.lengthSquared();
+    double t = length > 0 ? QVector3D::dotProduct(p - a, ab) / length : 0;
+    return (p - (a + float(qBound(0.0, t, 1.0)) * ab)).length();
+}
+
+/*!
+ * \brief significance
+ * Runs Douglas-Peucker once to the end and records for every vertex the
+ * error it was split at, capped by that of the split before it. A level
+ * of any tolerance keeps the vertices at or above it, the same ones a run
+ * with that tolerance would keep.
+ */
+static QVector<double> significance(const QVector<QVector3D> &p)
+{
+    const int n = p.size();
+    QVector<double> result(n, 0);
+    result[0] = result[n - 1] = std::numeric_limits<double>::infinity();
+
+    struct Range {
+        int first;
+        int last;
+        double error;
+    };
+    QVector<Range> stack;
+    stack << Range{ 0, n - 1, std::numeric_limits<double>::infinity() };
+    while (!stack.isEmpty()) {
+        Range r = stack.takeLast();
+        if (r.last - r.first < 2) {
+            continue;
+        }
+        int worst = -1;
+        double error = -1;
+        for (int k = r.first + 1; k < r.last; k++) {
+            double d = distanceToChord(p[k], p[r.first], p[r.last]);
+            if (d > error) {
+                error = d;
+                worst = k;
+            }
+        }
+        result[worst] = qMin(error, r.error);
+        stack << Range{ r.first, worst, result[worst] };
+        stack << Range{ worst, r.last, result[worst] };
+    }
+    return result;
+}
+
+/*!
+ * \brief appendArc
+ * Continue the line to b along the great circle, in steps of no more than
+ * MaxEdgeAngle. Edges between nearly opposite points have no well defined
+ * great circle, and slerp would divide by almost zero; they go through a
+ * midpoint first.
+ */
+static void appendArc(QVector<QVector3D> &p, const QVector3D &b)
+{
+    QVector3D a = p.last();
+    double angle = 2 * qAsin(qMin(1.0, double((b - a).length()) / 2));
+    double sinAngle = qSin(angle);
+    if (angle > M_PI / 2 && sinAngle < 1e-3) {
+        QVector3D mid = a + b;
+        if (mid.length() < 1e-3) {
+            // any great circle will do, this one passes closest to the poles
+            mid = QVector3D::crossProduct(a, QVector3D(0, 1, 0));
+            if (mid.length() < 1e-3) {
+                mid = QVector3D::crossProduct(a, QVector3D(1, 0, 0));
+            }
+            mid = QVector3D::crossProduct(mid, a);
+        }
+        appendArc(p, mid.normalized());
+        appendArc(p, b);
+        return;
+    }
+    int steps = qCeil(angle / MaxEdgeAngle);
+    for (int s = 1; s < steps; s++) {
+        // slerp
+        double t = double(s) / steps;
+        p << (float(qSin((1 - t) * angle) / sinAngle) * a
+              + float(qSin(t * angle) / sinAngle) * b);
+    }
+    p << b;
+}
+
+static void appendSegment(QVector<PolylineLayer::Segment> &out, const QVector3D &a,
+                          const QVector3D &b, QRgb color, int width)
+{
+    if (a == b) {
+        return;
+    }
+    PolylineLayer::Segment s;
+    s.start[0] = float(qAtan2(a.z(), a.x()));
+    s.start[1] = float(qAsin(qBound(-1.0f, a.y(), 1.0f)));
+    s.end[0] = float(qAtan2(b.z(), b.x()));
+    s.end[1] = float(qAsin(qBound(-1.0f, b.y(), 1.0f)));
+    s.color[0] = qRed(color);
+    s.color[1] = qGreen(color);
+    s.color[2] = qBlue(color);
+    s.color[3] = qAlpha(color);
+    s.width = uchar(qBound(1, width, 255));
+    s.reserved[0] = s.reserved[1] = s.reserved[2] = 0;
+    out << s;
+}
+
+QSharedPointer<const PolylineLayer::Levels> PolylineLayer::build(
+    const QVector<Line> &lines)
+{
+    QVector<Segment> levels[LevelCount];
+    for (const Line &line : lines) {
+        if (line.lonLat.size() < 2) {
+            continue;
+        }
+        QVector<QVector3D> p;
+        p.reserve(line.lonLat.size());
+        p << toSphere(line.lonLat[0]);
+        for (int k = 1; k < line.lonLat.size(); k++) {
+            appendArc(p, toSphere(line.lonLat[k]));
+        }
+
+        QVector<double> sig = significance(p);
+        for (int level = 0; level < LevelCount; level++) {
+            double tol = tolerance(level);
+            int previous = 0;
+            for (int k = 1; k < p.size(); k++) {
+                if (sig[k] >= tol) {
+                    appendSegment(levels[level], p[previous], p[k], line.color,
+                                  line.width);
+                    previous = k;
+                }
+            }
+        }
+    }
+
+    QSharedPointer<Levels> result(new Levels);
+    int total = 0;
+    for (int level = 0; level < LevelCount; level++) {
+        result->offsets[level] = total;
+        total += levels[level].size();
+    }
+    result->offsets[LevelCount] = total;
+    if (total == 0) {
+        return QSharedPointer<const Levels>();
+    }
+    result->segments.reserve(total);
+    for (int level = 0; level < LevelCount; level++) {
+        result->segments += levels[level];
+        levels[level] = QVector<Segment>();
+    }
+    return result;
+}
+
+static void readCoordinates(const QJsonArray &coordinates, QVector<QPointF> *lonLat)
+{
+    lonLat->reserve(coordinates.size());
+    for (const QJsonValue &c : coordinates) {
+        QJsonArray xy = c.toArray();
+        if (xy.size() >= 2) {
+            *lonLat << QPointF(xy[0].toDouble(), xy[1].toDouble());
+        }
+    }
+}
+
+static void readGeometry(const QJsonObject &geometry, const PolylineLayer::Line &style,
+                         QVector<PolylineLayer::Line> *lines)
+{
+    QString type = geometry.value(QStringLiteral("type")).toString();
+    QJsonArray coordinates = geometry.value(QStringLiteral("coordinates")).toArray();
+    // every ring of a polygon is a closed line
+    QJsonArray parts;
+    if (type == QLatin1String("LineString")) {
+        parts << coordinates;
+    } else if (type == QLatin1String("MultiLineString")
+               || type == QLatin1String("Polygon")) {
+        parts = coordinates;
+    } else if (type == QLatin1String("MultiPolygon")) {
+        for (const QJsonValue &polygon : coordinates) {
+            for (const QJsonValue &ring : polygon.toArray()) {
+                parts << ring;
+            }
+        }
+    } else if (type == QLatin1String("GeometryCollection")) {
+        QJsonArray geometries = geometry.value(QStringLiteral("geometries")).toArray();
+        for (const QJsonValue &g : geometries) {
+            readGeometry(g.toObject(), style, lines);
+        }
+    }
+    for (const QJsonValue &part : parts) {
+        PolylineLayer::Line line = style;
+        readCoordinates(part.toArray(), &line.lonLat);
+        *lines << line;
+    }
+}
+
+bool PolylineLayer::readGeoJson(const QString &fileName, QVector<Line> *lines)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("PolylineLayer: can not read %s", qPrintable(fileName));
+        return false;
+    }
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!document.isObject()) {
+        qWarning("PolylineLayer: %s is no GeoJSON, %s", qPrintable(fileName),
+                 qPrintable(error.errorString()));
+        return false;
+    }
+
+    QJsonObject root = document.object();
+    QString type = root.value(QStringLiteral("type")).toString();
+    QJsonArray features;
+    if (type == QLatin1String("FeatureCollection")) {
+        features = root.value(QStringLiteral("features")).toArray();
+    } else if (type == QLatin1String("Feature")) {
+        features << root;
+    } else {
+        // a bare geometry
+        QJsonObject feature;
+        feature.insert(QStringLiteral("geometry"), root);
+        features << feature;
+    }
+
+    for (const QJsonValue &f : features) {
+        QJsonObject feature = f.toObject();
+        QJsonObject properties = feature.value(QStringLiteral("properties")).toObject();
+        Line style;
+        style.color = DefaultColor;
+        style.width = DefaultWidth;
+        QColor color(properties.value(QStringLiteral("stroke")).toString());
+        if (color.isValid()) {
+            style.color = color.rgba();
+        }
+        style.width = qRound(properties.value(QStringLiteral("stroke-width"))
+                             .toDouble(style.width));
+        readGeometry(feature.value(QStringLiteral("geometry")).toObject(), style, lines);
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef POLYLINELAYER_H
+#define POLYLINELAYER_H
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QPointF>
+#include <QRgb>
+#include <QSharedPointer>
+#include <QVector>
+
+/*!
+ * \brief The PolylineLayer class
+ * Coastlines, borders and routes drawn over the globe. Lines are loaded
+ * once and simplified with Douglas-Peucker into LevelCount levels, each
+ * allowing half the error of the one before; the renderer draws the
+ * coarsest level that is off by less than pixelError pixels.
+ *
+ * Lives on the GUI thread, renderers read it during synchronize.
+ */
+class PolylineLayer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Line {
+        // degrees, east and north
+        QVector<QPointF> lonLat;
+        QRgb color;
+        // pixels, up to 255
+        int width;
+    };
+
+    // one instance of the line quad, in the layout PolylineDrawer uploads
+    struct Segment {
+        // model space longitude and latitude in radians, see PointLayer
+        float start[2];
+        float end[2];
+        uchar color[4];
+        uchar width;
+        uchar reserved[3];
+    };
+
+    // the last level keeps every vertex
+    static const int LevelCount = 12;
+
+    // the segments of all levels, level k from offsets[k] to offsets[k + 1]
+    struct Levels {
+        QVector<Segment> segments;
+        int offsets[LevelCount + 1];
+    };
+
+    explicit PolylineLayer(QObject *parent = nullptr);
+    ~PolylineLayer();
+
+    // blocking, fine for a few thousand vertices
+    void setLines(const QVector<Line> &lines);
+    // reads GeoJSON and builds the levels on a worker thread
+    void load(const QString &fileName);
+    bool isLoading() const { return m_watcher.isRunning(); }
+    void clear();
+
+    // null when there are no lines
+    QSharedPointer<const Levels> levels() const { return m_levels; }
+    // changes whenever the lines do, for the renderer to upload them once
+    int serial() const { return m_serial; }
+
+    // screen space error the level is picked for
+    double pixelError() const { return m_pixelError; }
+    void setPixelError(double pixels);
+
+    // angle in radians a vertex may be off by in a level, 0 for the last
+    static double tolerance(int level);
+    // coarsest level within an angle
+    static int level(double tolerance);
+
+    static QSharedPointer<const Levels> build(const QVector<Line> &lines);
+    // LineString, MultiLineString, Polygon and MultiPolygon geometries,
+    // coloured by the stroke and stroke-width properties if they have them
+    static bool readGeoJson(const QString &fileName, QVector<Line> *lines);
+
+signals:
+    void changed();
+    void loadingChanged();
+
+private slots:
+    void loaded();
+
+private:
+    void setLevels(const QSharedPointer<const Levels> &levels);
+
+    QSharedPointer<const Levels> m_levels;
+    QFutureWatcher<QSharedPointer<const Levels>> m_watcher;
+    int m_serial;
+    double m_pixelError;
+};
+
+#endif // POLYLINELAYER_H
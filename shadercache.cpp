@@ -0,0 +1,337 @@
+#include <cstring>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QStandardPaths>
+#include "shadercache.h"
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// "EGSB", then the binary format and the binary itself
+static const quint32 BinaryMagic = 0x42534745;
+
+namespace {
+
+/*
+ * glGetProgramBinary and friends: core in GL 4.1 and ES 3.0, extensions
+ * before that. None of them are in QOpenGLFunctions.
+ */
+struct BinaryFunctions
+{
+    typedef void (QOPENGLF_APIENTRYP GetProgramBinary)(GLuint program, GLsizei bufSize,
+                                                       GLsizei *length,
+                                                       GLenum *binaryFormat,
+                                                       void *binary);
+    typedef void (QOPENGLF_APIENTRYP ProgramBinary)(GLuint program, GLenum binaryFormat,
+                                                    const void *binary, GLsizei length);
+    typedef void (QOPENGLF_APIENTRYP ProgramParameteri)(GLuint program, GLenum pname,
+                                                        GLint value);
+
+    GetProgramBinary getProgramBinary;
+    ProgramBinary programBinary;
+    ProgramParameteri programParameteri;
+
+    BinaryFunctions()
+        : getProgramBinary(nullptr), programBinary(nullptr), programParameteri(nullptr)
+    {
+        auto ctx = QOpenGLContext::currentContext();
+        auto version = ctx->format().version();
+        QByteArray suffix;
+        if (ctx->isOpenGLES()) {
+            if (version < qMakePair(3, 0)) {
+                if (!ctx->hasExtension(QByteArrayLiteral("GL_OES_get_program_binary"))) {
+                    return;
+                }
+                suffix = "OES";
+            }
+        } else if (version < qMakePair(4, 1)) {
+            if (!ctx->hasExtension(QByteArrayLiteral("GL_ARB_get_program_binary"))) {
+                return;
+            }
+        }
+        GLint formats = 0;
+        ctx->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats == 0) {
+            return;
+        }
+        getProgramBinary = reinterpret_cast<GetProgramBinary>(
+                               ctx->getProcAddress("glGetProgramBinary" + suffix));
+        programBinary = reinterpret_cast<ProgramBinary>(
+                            ctx->getProcAddress("glProgramBinary" + suffix));
+        // only a hint, ES 2.0 has none
+        if (suffix.isEmpty()) {
+            programParameteri = reinterpret_cast<ProgramParameteri>(
+                                    ctx->getProcAddress("glProgramParameteri"));
+        }
+    }
+
+    bool isValid() const { return getProgramBinary && programBinary; }
+};
+
+} // namespace
+
+ShaderCache::ShaderCache()
+{
+    QString cache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cache.isEmpty()) {
+        m_binaryDir = QDir(cache).filePath(QStringLiteral("shaders"));
+    }
+    m_stats.compiled = m_stats.loaded = 0;
+    m_stats.compileMs = m_stats.loadMs = 0;
+}
+
+ShaderCache *ShaderCache::instance()
+{
+    static ShaderCache cache;
+    return &cache;
+}
+
+/*!
+ * \brief ShaderCache::hasModernGlsl
+ * \return whether the current context takes GLSL 1.40 or GLSL ES 3.00,
+ * which the gl_VertexID based shaders need
+ */
+bool ShaderCache::hasModernGlsl()
+{
+    auto ctx = QOpenGLContext::currentContext();
+    auto version = ctx->format().version();
+    if (ctx->isOpenGLES()) {
+        return version >= qMakePair(3, 0);
+    }
+    return version >= qMakePair(3, 1);
+}
+
+QString ShaderCache::binaryDir() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_binaryDir;
+}
+
+void ShaderCache::setBinaryDir(const QString &dir)
+{
+    QMutexLocker locker(&m_mutex);
+    m_binaryDir = dir;
+}
+
+ShaderCache::Stats ShaderCache::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+/*!
+ * \brief ShaderCache::preferredDialect
+ * \return Modern where the context takes it, which brings uniform blocks
+ * along, see UniformBlock
+ */
+ShaderCache::Dialect ShaderCache::preferredDialect()
+{
+    return hasModernGlsl() ? Modern : Legacy;
+}
+
+/*!
+ * \brief ShaderCache::source
+ * The sources are in the GLSL ES 1.00 dialect of this project, Modern ones
+ * get a version and keyword mapping prepended. All of them start with the
+ * shared uniforms of shaders/uniforms.glsl.
+ */
+QByteArray ShaderCache::source(const QString &fileName, QOpenGLShader::ShaderType type,
+                               Dialect dialect)
+{
+    QFile file(fileName);
+    QFile uniforms(QStringLiteral(":/shaders/uniforms.glsl"));
+    if (!file.open(QIODevice::ReadOnly) || !uniforms.open(QIODevice::ReadOnly)) {
+        qWarning("ShaderCache: can not read %s", qPrintable(fileName));
+        return QByteArray();
+    }
+
+    QByteArray source;
+    if (dialect == Modern) {
+        source += QOpenGLContext::currentContext()->isOpenGLES()
+                  ? "#version 300 es\n" : "#version 140\n";
+        source += "#define UNIFORM_BLOCKS\n";
+        if (type == QOpenGLShader::Vertex) {
+            source += "#define attribute in\n"
+                      "#define varying out\n";
+        } else {
+            // precision and the fragColor output are declared in
+            // shaders/uniforms.glsl, where the precision is guarded for ES
+            source += "#define varying in\n"
+                      "#define texture2D texture\n"
+                      "#define gl_FragColor fragColor\n";
+        }
+    }
+    if (type == QOpenGLShader::Vertex) {
+        source += "#define VERTEX_SHADER\n";
+    }
+    source += uniforms.readAll();
+    source += file.readAll();
+    return source;
+}
+
+QSharedPointer<QOpenGLShaderProgram> ShaderCache::program(const QString &vertexFile,
+                                                          const QString &fragmentFile,
+                                                          Dialect dialect)
+{
+    QString name = QStringLiteral("%1 + %2").arg(QFileInfo(vertexFile).fileName(),
+                                                 QFileInfo(fragmentFile).fileName());
+    GroupKey key(QOpenGLContextGroup::currentContextGroup(),
+                 QStringLiteral("%1|%2|%3").arg(vertexFile, fragmentFile).arg(dialect));
+
+    // held while building, so concurrent renderers do not compile twice
+    QMutexLocker locker(&m_mutex);
+    auto cached = m_programs.value(key).toStrongRef();
+    if (cached) {
+        return cached;
+    }
+    QByteArray vertexSource = source(vertexFile, QOpenGLShader::Vertex, dialect);
+    QByteArray fragmentSource = source(fragmentFile, QOpenGLShader::Fragment, dialect);
+
+    // the driver strings, since binaries are only good for the driver that
+    // made them
+    auto gl = QOpenGLContext::currentContext()->functions();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (GLenum string : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+        auto value = reinterpret_cast<const char *>(gl->glGetString(string));
+        hash.addData(value ? value : "");
+        hash.addData("\n", 1);
+    }
+    hash.addData(vertexSource);
+    hash.addData("\n", 1);
+    hash.addData(fragmentSource);
+    QString binaryFile;
+    if (!m_binaryDir.isEmpty()) {
+        binaryFile = QDir(m_binaryDir).filePath(QString::fromLatin1(hash.result().toHex())
+                                                + QStringLiteral(".bin"));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QOpenGLShaderProgram *prog = binaryFile.isEmpty() ? nullptr : loadBinary(binaryFile);
+    if (prog) {
+        double ms = timer.nsecsElapsed() / 1e6;
+        m_stats.loaded++;
+        m_stats.loadMs += ms;
+    } else {
+        prog = build(vertexSource, fragmentSource, name);
+        double ms = timer.nsecsElapsed() / 1e6;
+        m_stats.compiled++;
+        m_stats.compileMs += ms;
+        if (prog->isLinked() && !binaryFile.isEmpty()) {
+            saveBinary(prog, binaryFile);
+        }
+    }
+
+    QSharedPointer<QOpenGLShaderProgram> program(prog);
+    // drop entries whose last user is gone
+    for (auto it = m_programs.begin(); it != m_programs.end();) {
+        if (it.value().isNull()) {
+            it = m_programs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_programs.insert(key, program);
+    return program;
+}
+
+QOpenGLShaderProgram *ShaderCache::build(const QByteArray &vertexSource,
+                                         const QByteArray &fragmentSource,
+                                         const QString &name)
+{
+    auto prog = new QOpenGLShaderProgram;
+    prog->create();
+    BinaryFunctions binary;
+    if (binary.programParameteri) {
+        binary.programParameteri(prog->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                 GL_TRUE);
+    }
+    if (!prog->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource)
+        || !prog->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentSource)
+        || !prog->link()) {
+        qWarning("ShaderCache: %s does not link", qPrintable(name));
+    }
+    return prog;
+}
+
+/*!
+ * \brief ShaderCache::loadBinary
+ * \return nullptr when there is no binary or the driver turns it down,
+ * after an update for instance
+ */
+QOpenGLShaderProgram *ShaderCache::loadBinary(const QString &fileName)
+{
+    QFile file(fileName);
+    BinaryFunctions binary;
+    if (!binary.isValid() || !file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    QByteArray data = file.readAll();
+    quint32 header[2];
+    if (data.size() <= int(sizeof(header))) {
+        return nullptr;
+    }
+    memcpy(header, data.constData(), sizeof(header));
+    if (header[0] != BinaryMagic) {
+        return nullptr;
+    }
+
+    auto prog = new QOpenGLShaderProgram;
+    prog->create();
+    binary.programBinary(prog->programId(), header[1], data.constData() + sizeof(header),
+                         data.size() - sizeof(header));
+    GLint linked = 0;
+    auto gl = QOpenGLContext::currentContext()->functions();
+    gl->glGetProgramiv(prog->programId(), GL_LINK_STATUS, &linked);
+    // link() without shaders only picks up the status of the binary
+    if (!linked || !prog->link()) {
+        delete prog;
+        return nullptr;
+    }
+    return prog;
+}
+
+void ShaderCache::saveBinary(QOpenGLShaderProgram *prog, const QString &fileName)
+{
+    BinaryFunctions binary;
+    if (!binary.isValid()) {
+        return;
+    }
+    GLint length = 0;
+    auto gl = QOpenGLContext::currentContext()->functions();
+    gl->glGetProgramiv(prog->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    QByteArray data(sizeof(quint32) * 2 + length, 0);
+    GLenum format = 0;
+    binary.getProgramBinary(prog->programId(), length, nullptr, &format,
+                            data.data() + sizeof(quint32) * 2);
+    const quint32 header[2] = { BinaryMagic, format };
+    memcpy(data.data(), header, sizeof(header));
+
+    // written aside and renamed, so another process never reads half a file
+    QDir().mkpath(QFileInfo(fileName).path());
+    QString partial = fileName + QStringLiteral(".part");
+    QFile file(partial);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        qWarning("ShaderCache: can not write %s", qPrintable(partial));
+        return;
+    }
+    file.close();
+    QFile::remove(fileName);
+    QFile::rename(partial, fileName);
+}
@@ -0,0 +1,77 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLShaderProgram>
+#include <QPair>
+#include <QSharedPointer>
+#include <QString>
+#include <QWeakPointer>
+
+class QOpenGLContextGroup;
+
+/*!
+ * \brief The ShaderCache class
+ * Process wide, reference counted cache of linked shader programs, one per
+ * pair of shader files and context share group. Where the driver can hand
+ * out program binaries they are also kept on disk, keyed by a hash of the
+ * driver strings and the sources, so later launches skip compiling.
+ */
+class ShaderCache
+{
+public:
+    // how the GLSL ES 1.00 sources of this project are compiled
+    enum Dialect {
+        // as they are
+        Legacy,
+        // as GLSL 1.40 / GLSL ES 3.00, for the gl_VertexID based shaders and
+        // uniform blocks
+        Modern,
+    };
+
+    // programs built from source and from binaries, and the time spent on
+    // each, since the process started
+    struct Stats {
+        int compiled;
+        int loaded;
+        double compileMs;
+        double loadMs;
+    };
+
+    static ShaderCache *instance();
+    // needs a current context
+    static bool hasModernGlsl();
+    static Dialect preferredDialect();
+
+    // needs a current context; check isLinked() on the result
+    QSharedPointer<QOpenGLShaderProgram> program(const QString &vertexFile,
+                                                 const QString &fragmentFile,
+                                                 Dialect dialect = Legacy);
+
+    // the application cache location by default, empty to keep no binaries
+    QString binaryDir() const;
+    void setBinaryDir(const QString &dir);
+
+    Stats stats() const;
+
+protected:
+    ShaderCache();
+
+    static QByteArray source(const QString &fileName, QOpenGLShader::ShaderType type,
+                             Dialect dialect);
+    QOpenGLShaderProgram *build(const QByteArray &vertexSource,
+                                const QByteArray &fragmentSource, const QString &name);
+    QOpenGLShaderProgram *loadBinary(const QString &fileName);
+    void saveBinary(QOpenGLShaderProgram *prog, const QString &fileName);
+
+private:
+    typedef QPair<QOpenGLContextGroup *, QString> GroupKey;
+
+    mutable QMutex m_mutex;
+    QString m_binaryDir;
+    QHash<GroupKey, QWeakPointer<QOpenGLShaderProgram>> m_programs;
+    Stats m_stats;
+};
+
+#endif // SHADERCACHE_H
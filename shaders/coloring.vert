@@ -1,5 +1,5 @@
-uniform mat4 vProjection;
-uniform mat4 vModelView;
+// vProjection and vView come from uniforms.glsl
+uniform mat4 vModel;
 
 attribute vec4 vPosition;
 attribute vec4 vColor;
@@ -9,6 +9,6 @@ varying vec4 varyingColor;
 void main(void)
 {
     varyingColor = vColor;
-    gl_Position = vProjection * vModelView * vPosition;
+    gl_Position = vProjection * vView * vModel * vPosition;
 }
 
@@ -0,0 +1,51 @@
+// One segment of a PolylineLayer: a quad of vWidth pixels across between
+// its end points, instanced per segment or written out as two triangles.
+// vProjection and vView come from uniforms.glsl
+uniform mat4 vModel;
+uniform vec2 vViewport;
+// radius the lines are drawn at, above the coarser sphere meshes and the
+// chords of the simplified lines
+uniform float vLift;
+
+// x from the start (0) to the end (1) of the segment, y across it in [-1, 1]
+attribute vec2 vCorner;
+// per segment: model space longitude and latitude of both ends, colour,
+// width in pixels
+attribute vec2 vStart;
+attribute vec2 vEnd;
+attribute vec4 vColor;
+attribute float vWidth;
+
+varying vec4 color;
+
+vec3 onSphere(vec2 lonLat)
+{
+    return vec3(cos(lonLat.y) * cos(lonLat.x), sin(lonLat.y),
+                cos(lonLat.y) * sin(lonLat.x));
+}
+
+void main(void)
+{
+    mat4 modelView = vView * vModel;
+    vec3 a = onSphere(vStart);
+    vec3 b = onSphere(vEnd);
+    vec4 eyeA = modelView * vec4(a * vLift, 1.0);
+    vec4 eyeB = modelView * vec4(b * vLift, 1.0);
+
+    color = vColor;
+    // both ends behind the horizon: outside the clip volume
+    if (dot((modelView * vec4(a, 0.0)).xyz, eyeA.xyz) > 0.0
+            && dot((modelView * vec4(b, 0.0)).xyz, eyeB.xyz) > 0.0) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    vec4 clipA = vProjection * eyeA;
+    vec4 clipB = vProjection * eyeB;
+    // across the segment in pixels, the same at both ends so quads line up
+    vec2 along = (clipB.xy / clipB.w - clipA.xy / clipA.w) * vViewport;
+    vec2 across = length(along) > 0.0 ? normalize(vec2(-along.y, along.x))
+                                      : vec2(0.0, 1.0);
+    gl_Position = mix(clipA, clipB, vCorner.x);
+    gl_Position.xy += across * vCorner.y * vWidth / vViewport * gl_Position.w;
+}
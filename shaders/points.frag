@@ -0,0 +1,11 @@
+varying vec4 color;
+varying vec2 corner;
+
+void main(void)
+{
+    // round markers
+    if (dot(corner, corner) > 1.0) {
+        discard;
+    }
+    gl_FragColor = color;
+}
@@ -0,0 +1,40 @@
+// One marker of a PointLayer: a screen aligned quad per instance, or a
+// point sprite when vCorner stays at (0, 0).
+// vProjection and vView come from uniforms.glsl
+uniform mat4 vModel;
+uniform vec2 vViewport;
+// eye distance up to which markers have their full size
+uniform float vReferenceDistance;
+
+// corner of the quad in [-1, 1]
+attribute vec2 vCorner;
+// per point: model space longitude and latitude, colour, size in pixels
+attribute vec2 vLonLat;
+attribute vec4 vColor;
+attribute float vSize;
+
+varying vec4 color;
+varying vec2 corner;
+
+void main(void)
+{
+    vec3 n = vec3(cos(vLonLat.y) * cos(vLonLat.x), sin(vLonLat.y),
+                  cos(vLonLat.y) * sin(vLonLat.x));
+    mat4 modelView = vView * vModel;
+    // lifted a little, so the sphere does not cut through the markers
+    vec4 eyeVertex = modelView * vec4(n * 1.001, 1.0);
+
+    color = vColor;
+    corner = vCorner;
+    // behind the horizon: outside the clip volume, before any rasterizing
+    if (dot((modelView * vec4(n, 0.0)).xyz, eyeVertex.xyz) > 0.0) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        gl_PointSize = 1.0;
+        return;
+    }
+
+    float size = max(vSize * min(1.0, vReferenceDistance / length(eyeVertex.xyz)), 1.0);
+    gl_Position = vProjection * eyeVertex;
+    gl_Position.xy += vCorner * size / vViewport * gl_Position.w;
+    gl_PointSize = size;
+}
@@ -0,0 +1,12 @@
+// points.frag for GL_POINTS, where the corner comes from gl_PointCoord
+varying vec4 color;
+varying vec2 corner;
+
+void main(void)
+{
+    vec2 c = gl_PointCoord * 2.0 - 1.0;
+    if (dot(c, c) > 1.0) {
+        discard;
+    }
+    gl_FragColor = color;
+}
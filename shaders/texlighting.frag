@@ -1,28 +1,78 @@
-uniform vec4 fAmbientColor;
-uniform vec4 fDiffuseColor;
-uniform vec4 fSpecularColor;
-uniform float fAmbientReflection;
-uniform float fDiffuseReflection;
-uniform float fSpecularReflection;
-uniform float fShininess;
+// the material comes from uniforms.glsl
 uniform sampler2D tex;
 
+// virtual texturing, see VirtualTexture; addressing texels of a gigapixel
+// image needs more than mediump
+#if defined(GL_ES) && !defined(GL_FRAGMENT_PRECISION_HIGH)
+#define vtp mediump
+#else
+#define vtp highp
+#endif
+uniform bool fVirtualTexture;
+uniform bool fFeedback;
+uniform sampler2D vtIndirection;
+uniform sampler2D vtPhysical;
+uniform vtp vec2 vtVirtualSize;
+uniform vtp vec2 vtTileCount;
+uniform vtp vec2 vtPhysicalSize;
+uniform vtp float vtTileSize;
+uniform vtp float vtSlotSize;
+uniform float vtMaxLevel;
+uniform vtp float vtTexelScale;
+
 varying vec3 normal;
 varying vec3 lightDir;
 varying vec3 viewerDir;
-varying vec2 texCoord;
+varying vtp vec2 texCoord;
+
+// uv in tiles of the finest level, kept off the far edges
+vtp vec2 virtualCoord(vtp vec2 uv)
+{
+    return clamp(uv * vtVirtualSize, vec2(0.0), vtVirtualSize - 0.5) / vtTileSize;
+}
+
+// texel from the finest resident tile
+vec4 virtualTexel(vtp vec2 tc)
+{
+    vec4 entry = floor(texture2D(vtIndirection, (floor(tc) + 0.5) / vtTileCount) * 255.0
+                       + 0.5);
+    vtp vec2 inTile = fract(tc * exp2(entry.b - vtMaxLevel)) * vtTileSize;
+    vtp vec2 border = vec2(0.5 * (vtSlotSize - vtTileSize));
+    return texture2D(vtPhysical, (entry.rg * vtSlotSize + border + inTile) / vtPhysicalSize);
+}
+
+// the tile this fragment wants, see VirtualTexture::endFeedback
+vec4 virtualFeedback(vtp vec2 tc, float v)
+{
+    // texels per pixel grow with distance and with the slant of the surface,
+    // and along the parallels towards the poles
+    float cosView = max(dot(normalize(normal), normalize(viewerDir)), 0.0);
+    float cosLat = cos((v - 0.5) * 3.14159265);
+    vtp float texels = length(viewerDir) * vtTexelScale / max(cosView * cosLat, 0.0625);
+    float level = clamp(vtMaxLevel - floor(max(log2(texels), 0.0)), 0.0, vtMaxLevel);
+    vtp vec2 tile = floor(tc * exp2(level - vtMaxLevel));
+    vtp vec2 high = floor(tile / 256.0);
+    return vec4(tile - high * 256.0, high.x * 16.0 + high.y, level + 1.0) / 255.0;
+}
 
 void main(void)
 {
+    // textures are stored top row first
+    vtp vec2 uv = vec2(texCoord.s, 1.0 - texCoord.t);
+    if (fFeedback) {
+        gl_FragColor = virtualFeedback(virtualCoord(uv), uv.t);
+        return;
+    }
+
     vec3 nNormal = normalize(normal);
     vec3 nLightDir = normalize(lightDir);
     vec3 nViewerDir = normalize(viewerDir);
-    vec4 ambientIllumination = fAmbientReflection * fAmbientColor;
-    vec4 diffuseIllumination = fDiffuseReflection * max(0.0, dot(nLightDir, nNormal)) * fDiffuseColor;
-    vec4 specularIllumination = fSpecularReflection * pow(max(0.0,
+    vec4 ambientIllumination = fReflection.x * fAmbientColor;
+    vec4 diffuseIllumination = fReflection.y * max(0.0, dot(nLightDir, nNormal)) * fDiffuseColor;
+    vec4 specularIllumination = fReflection.z * pow(max(0.0,
                                                               dot(-reflect(nLightDir, nNormal), nViewerDir)
-                                                              ), fShininess) * fSpecularColor;
+                                                              ), fReflection.w) * fSpecularColor;
 
-    gl_FragColor = texture2D(tex, texCoord) * (ambientIllumination + diffuseIllumination) + specularIllumination;
+    vec4 color = fVirtualTexture ? virtualTexel(virtualCoord(uv)) : texture2D(tex, uv);
+    gl_FragColor = color * (ambientIllumination + diffuseIllumination) + specularIllumination;
 }
-
@@ -1,8 +1,8 @@
-uniform mat4 vProjection;
-uniform mat4 vModelView;
-uniform mat3 vNormalMatrix;
-uniform vec3 vLightPosition;
+// vProjection, vView and vLightPosition come from uniforms.glsl
+uniform mat4 vModel;
 
+// with the packed sphere layout vNormal is fed from the same normalized
+// shorts as vPosition, which is a unit vector on the sphere
 attribute vec4 vPosition;
 attribute vec3 vNormal;
 attribute vec2 vTexCoord;
@@ -14,15 +14,18 @@ varying vec2 texCoord;
 
 void main(void)
 {
-    vec4 eyeVertex = vModelView * vPosition;
+    mat4 modelView = vView * vModel;
+    vec4 eyeVertex = modelView * vPosition;
     eyeVertex /= eyeVertex.w;
 
-    normal = vNormalMatrix * vNormal;
-    lightDir = vLightPosition - eyeVertex.xyz;
+    // models are rotated and uniformly scaled at most, so normals go through
+    // the model view matrix itself; the fragment shader normalizes them
+    normal = (modelView * vec4(vNormal, 0.0)).xyz;
+    lightDir = vLightPosition.xyz - eyeVertex.xyz;
     viewerDir = - eyeVertex.xyz;
 
     texCoord = vTexCoord;
 
-    gl_Position = vProjection * vModelView * vPosition;
+    gl_Position = vProjection * eyeVertex;
 }
 
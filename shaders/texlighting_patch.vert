@@ -0,0 +1,49 @@
+// One GlobeLod patch, drawn from a shared grid of (s, t, skirt) vertices.
+// vProjection, vView and vLightPosition come from uniforms.glsl
+uniform mat4 vModel;
+// south west corner, radians per cell and skirt depth
+uniform vec4 vPatch;
+// eye distances where morphing into the parent grid starts and ends
+uniform vec2 vMorph;
+// eye position in model space
+uniform vec3 vEye;
+
+attribute vec3 vGrid;
+
+varying vec3 normal;
+varying vec3 lightDir;
+varying vec3 viewerDir;
+varying vec2 texCoord;
+
+const float PI = 3.14159265358979;
+
+vec3 fromLonLat(vec2 g)
+{
+    vec2 lonLat = vPatch.xy + g * vPatch.z;
+    return vec3(cos(lonLat.y) * cos(lonLat.x), sin(lonLat.y),
+                cos(lonLat.y) * sin(lonLat.x));
+}
+
+void main(void)
+{
+    // slide odd vertices onto their even neighbours, which gives the parent
+    // grid at k = 1
+    vec2 g = vGrid.xy;
+    float k = clamp((distance(fromLonLat(g), vEye) - vMorph.x) / (vMorph.y - vMorph.x),
+                    0.0, 1.0);
+    g -= fract(g * 0.5) * 2.0 * k;
+
+    vec3 n = fromLonLat(g);
+    vec4 vPosition = vec4(n * (1.0 - vGrid.z * vPatch.w), 1.0);
+    mat4 modelView = vView * vModel;
+    vec4 eyeVertex = modelView * vPosition;
+
+    normal = (modelView * vec4(n, 0.0)).xyz;
+    lightDir = vLightPosition.xyz - eyeVertex.xyz;
+    viewerDir = - eyeVertex.xyz;
+
+    vec2 lonLat = vPatch.xy + g * vPatch.z;
+    texCoord = vec2(1.0 - lonLat.x / (2.0 * PI), lonLat.y / PI + 0.5);
+
+    gl_Position = vProjection * eyeVertex;
+}
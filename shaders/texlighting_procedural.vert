@@ -0,0 +1,40 @@
+// Rebuilds the sphere of SphereGenerator from gl_VertexID alone,
+// drawn as GL_TRIANGLES with 6 vertices per grid quad.
+// vProjection, vView and vLightPosition come from uniforms.glsl
+uniform mat4 vModel;
+uniform int vResolution;
+
+varying vec3 normal;
+varying vec3 lightDir;
+varying vec3 viewerDir;
+varying vec2 texCoord;
+
+const float PI = 3.14159265358979;
+
+void main(void)
+{
+    int quad = gl_VertexID / 6;
+    int corner = gl_VertexID - quad * 6;
+    // same winding as the strips: (0,0) (0,1) (1,0), then (1,0) (0,1) (1,1)
+    int di = (corner == 2 || corner == 3 || corner == 5) ? 1 : 0;
+    int dj = (corner == 1 || corner == 4 || corner == 5) ? 1 : 0;
+    int columns = 2 * vResolution;
+    int i = quad - (quad / columns) * columns + di;
+    int j = quad / columns + dj;
+
+    float res = float(vResolution);
+    float alpha = float(i) / res * PI;
+    float beta = float(j) / res * PI - 0.5 * PI;
+    vec4 vPosition = vec4(cos(beta) * cos(alpha), sin(beta), cos(beta) * sin(alpha), 1.0);
+
+    mat4 modelView = vView * vModel;
+    vec4 eyeVertex = modelView * vPosition;
+
+    normal = (modelView * vec4(vPosition.xyz, 0.0)).xyz;
+    lightDir = vLightPosition.xyz - eyeVertex.xyz;
+    viewerDir = - eyeVertex.xyz;
+
+    texCoord = vec2(1.0 - float(i) / (2.0 * res), float(j) / res);
+
+    gl_Position = vProjection * eyeVertex;
+}
@@ -4,6 +4,7 @@ varying vec2 texCoord;
 
 void main(void)
 {
-    gl_FragColor = texture2D(tex, texCoord);
+    // textures are stored top row first
+    gl_FragColor = texture2D(tex, vec2(texCoord.s, 1.0 - texCoord.t));
 }
 
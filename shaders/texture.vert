@@ -1,5 +1,5 @@
-uniform mat4 vProjection;
-uniform mat4 vModelView;
+// vProjection and vView come from uniforms.glsl
+uniform mat4 vModel;
 
 attribute vec4 vPosition;
 attribute vec2 vTexCoord;
@@ -9,6 +9,6 @@ varying vec2 texCoord;
 void main(void)
 {
     texCoord = vTexCoord;
-    gl_Position = vProjection * vModelView * vPosition;
+    gl_Position = vProjection * vView * vModel * vPosition;
 }
 
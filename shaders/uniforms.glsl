@@ -0,0 +1,48 @@
+// Prepended to every shader by ShaderCache, filled by UniformBlock.
+// With UNIFORM_BLOCKS these are std140 blocks backed by buffers that all
+// programs share, otherwise vec4 arrays set on each program.
+#ifdef VERTEX_SHADER
+
+// the camera, and the light in eye space
+#ifdef UNIFORM_BLOCKS
+layout(std140) uniform Frame {
+    mat4 vProjection;
+    mat4 vView;
+    vec4 vLightPosition;
+};
+#else
+uniform vec4 frame[9];
+#define vProjection mat4(frame[0], frame[1], frame[2], frame[3])
+#define vView mat4(frame[4], frame[5], frame[6], frame[7])
+#define vLightPosition frame[8]
+#endif
+
+#else
+
+#ifdef GL_ES
+precision mediump float;
+#endif
+
+// GLSL 1.40 and ES 3.00 have no gl_FragColor, ShaderCache maps it here
+#ifdef UNIFORM_BLOCKS
+out vec4 fragColor;
+#endif
+
+// Phong reflection, fReflection holds the ambient, diffuse and specular
+// factors and the shininess
+#ifdef UNIFORM_BLOCKS
+layout(std140) uniform Material {
+    vec4 fAmbientColor;
+    vec4 fDiffuseColor;
+    vec4 fSpecularColor;
+    vec4 fReflection;
+};
+#else
+uniform vec4 material[4];
+#define fAmbientColor material[0]
+#define fDiffuseColor material[1]
+#define fSpecularColor material[2]
+#define fReflection material[3]
+#endif
+
+#endif
@@ -1,3 +1,5 @@
+#include <cstddef>
+#include <cstring>
 #include <QOpenGLFramebufferObjectFormat>
 #include <QSGSimpleTextureNode>
 #include "showtexturemapping.h"
@@ -8,9 +10,22 @@ ShowTextureMapping::ShowTextureMapping()
     : m_showMappedVertices(false)
     , m_contentScale(1)
     , m_sphereResolution(360)
+    , m_sphereShape(Earth3D::UvSphere)
     , m_cameraPosition(0, 0, 25)
+    , m_samples(4)
+    , m_spherePending(false)
+    , m_texturePending(true)
+    , m_framesRendered(0)
+    , m_picker(GlobePicker::Map)
 {
-
+    connect(&m_sphereWatcher, &QFutureWatcher<void>::finished,
+            this, &ShowTextureMapping::updateSpherePending);
+    // let the renderer pick up the finished sphere
+    connect(&m_sphereWatcher, &QFutureWatcher<void>::finished,
+            this, &ShowTextureMapping::update);
+    // and the decoded texture
+    connect(&m_textureWatcher, &QFutureWatcher<void>::finished,
+            this, &ShowTextureMapping::update);
 }
 
 ShowTextureMapping::~ShowTextureMapping()
@@ -69,6 +84,20 @@ void ShowTextureMapping::setSphereResolution(int newResolution)
     update();
 }
 
+void ShowTextureMapping::setSphereShape(Earth3D::SphereShape shape)
+{
+    if (shape < Earth3D::UvSphere || shape > Earth3D::CubeSphere) {
+        qWarning("ShowTextureMapping: no sphere shape %d", int(shape));
+        return;
+    }
+    if (m_sphereShape == shape) {
+        return;
+    }
+    m_sphereShape = shape;
+    emit sphereShapeChanged();
+    update();
+}
+
 void ShowTextureMapping::setCameraPosition(const QVector3D &pos)
 {
     if (m_cameraPosition == pos) {
@@ -79,20 +108,117 @@ void ShowTextureMapping::setCameraPosition(const QVector3D &pos)
     update();
 }
 
+void ShowTextureMapping::setSamples(int samples)
+{
+    if (m_samples == samples) {
+        return;
+    }
+    m_samples = samples;
+    emit samplesChanged();
+    update();
+}
+
+void ShowTextureMapping::watchSphere(const QFuture<void> &future)
+{
+    m_sphereWatcher.setFuture(future);
+    // we are on the render thread here, notify from the gui thread
+    QMetaObject::invokeMethod(this, "updateSpherePending", Qt::QueuedConnection);
+}
+
+void ShowTextureMapping::watchTexture(const QFuture<void> &future)
+{
+    m_textureWatcher.setFuture(future);
+}
+
+void ShowTextureMapping::setFramesRendered(int frames)
+{
+    if (m_framesRendered == frames) {
+        return;
+    }
+    m_framesRendered = frames;
+    emit framesRenderedChanged();
+}
+
+void ShowTextureMapping::setTexturePending(bool pending)
+{
+    if (m_texturePending == pending) {
+        return;
+    }
+    m_texturePending = pending;
+    emit texturePendingChanged();
+}
+
+void ShowTextureMapping::setPassTimings(const QVariantMap &timings)
+{
+    if (m_passTimings == timings) {
+        return;
+    }
+    m_passTimings = timings;
+    emit passTimingsChanged();
+}
+
+void ShowTextureMapping::setPickCamera(const QMatrix4x4 &projection,
+                                       const QMatrix4x4 &modelView, const QSize &viewport)
+{
+    m_picker.setCamera(projection, modelView, viewport);
+}
+
+QVariant ShowTextureMapping::screenToLonLat(double x, double y) const
+{
+    QPointF lonLat;
+    if (!m_picker.pick(QPointF(x, y), &lonLat)) {
+        return QVariant();
+    }
+    return lonLat;
+}
+
+QVariantList ShowTextureMapping::screenToLonLatList(const QVariantList &positions) const
+{
+    QVector<QPointF> pos(positions.size());
+    for (int k = 0; k < positions.size(); k++) {
+        pos[k] = positions[k].toPointF();
+    }
+    QVector<QPointF> lonLat(pos.size());
+    QVector<bool> hit(pos.size());
+    m_picker.pick(pos.constData(), pos.size(), lonLat.data(), hit.data());
+
+    QVariantList out;
+    out.reserve(pos.size());
+    for (int k = 0; k < pos.size(); k++) {
+        out << (hit[k] ? QVariant(lonLat[k]) : QVariant());
+    }
+    return out;
+}
+
+void ShowTextureMapping::updateSpherePending()
+{
+    bool pending = !m_sphereWatcher.isFinished();
+    if (m_spherePending == pending) {
+        return;
+    }
+    m_spherePending = pending;
+    emit spherePendingChanged();
+}
+
 ShowTextureMappingRenderer::ShowTextureMappingRenderer()
-    : vbo_rect(), pTex_rect(nullptr)
-    , vbo_mv(), ebo_mv(QOpenGLBuffer::IndexBuffer)
+    : vbo_rect(), m_spherePending(false)
+    , m_frameBlock("Frame", "frame", UniformBlock::FrameBinding)
 {
     showMappedVertices = false;
     scale = 1;
     resolution = 360;
+    shape = SphereGenerator::UvSphere;
+    m_sphereDirty = true;
+    m_samples = 4;
+    m_frames = 0;
+    m_textureWatched = false;
+    m_texturePending = true;
     cameraPosition = QVector3D(0, 0, 25);
     initialize();
 }
 
 ShowTextureMappingRenderer::~ShowTextureMappingRenderer()
 {
-    if (pTex_rect) { delete pTex_rect; }
 }
 
 void ShowTextureMappingRenderer::initialize()
@@ -102,29 +228,24 @@ void ShowTextureMappingRenderer::initialize()
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
 
-    // Simple program use solid color
-    m_colorProg.addShaderFromSourceFile(QOpenGLShader::Vertex,
-                                        QStringLiteral(":/shaders/coloring.vert"));
-    m_colorProg.addShaderFromSourceFile(QOpenGLShader::Fragment,
-                                        QStringLiteral(":/shaders/coloring.frag"));
-    m_colorProg.link();
+    // Simple program use solid color, programs are shared between renderers
+    // and take the camera from m_frameBlock
+    auto shaders = ShaderCache::instance();
+    auto dialect = ShaderCache::preferredDialect();
+    m_colorProg = shaders->program(QStringLiteral(":/shaders/coloring.vert"),
+                                   QStringLiteral(":/shaders/coloring.frag"), dialect);
 
-    vertex_loc_0 = m_colorProg.attributeLocation("vPosition");
-    color_loc_0 = m_colorProg.attributeLocation("vColor");
-    mv_matrix_loc_0 = m_colorProg.uniformLocation("vModelView");
-    proj_matrix_loc_0 = m_colorProg.uniformLocation("vProjection");
+    vertex_loc_0 = m_colorProg->attributeLocation("vPosition");
+    color_loc_0 = m_colorProg->attributeLocation("vColor");
+    model_matrix_loc_0 = m_colorProg->uniformLocation("vModel");
 
     // Program with texture
-    m_texProg.addShaderFromSourceFile(QOpenGLShader::Vertex,
-                                      QStringLiteral(":/shaders/texture.vert"));
-    m_texProg.addShaderFromSourceFile(QOpenGLShader::Fragment,
-                                      QStringLiteral(":/shaders/texture.frag"));
-    m_texProg.link();
+    m_texProg = shaders->program(QStringLiteral(":/shaders/texture.vert"),
+                                 QStringLiteral(":/shaders/texture.frag"), dialect);
 
-    vertex_loc_1 = m_texProg.attributeLocation("vPosition");
-    texcoord_loc_1 = m_texProg.attributeLocation("vTexCoord");
-    mv_matrix_loc_1 = m_texProg.uniformLocation("vModelView");
-    proj_matrix_loc_1 = m_texProg.uniformLocation("vProjection");
+    vertex_loc_1 = m_texProg->attributeLocation("vPosition");
+    texcoord_loc_1 = m_texProg->attributeLocation("vTexCoord");
+    model_matrix_loc_1 = m_texProg->uniformLocation("vModel");
 
     createGeometry();
 }
@@ -149,9 +270,36 @@ void ShowTextureMappingRenderer::synchronize(QQuickFramebufferObject *item)
     cameraPosition = stm->cameraPosition();
     showMappedVertices = stm->showMappedVertices();
     scale = stm->contentScale();
+    m_samples = stm->samples();
     if (resolution != stm->sphereResolution()) {
         resolution = stm->sphereResolution();
-        createMappedVertices();
+        m_sphereDirty = true;
+    }
+    if (shape != SphereGenerator::Shape(stm->sphereShape())) {
+        shape = SphereGenerator::Shape(stm->sphereShape());
+        m_sphereDirty = true;
+    }
+    if (m_sphereDirty) {
+        requestMappedVertices();
+        stm->watchSphere(m_pendingSphere);
+        m_sphereDirty = false;
+    }
+    if (!m_textureWatched) {
+        stm->watchTexture(pTex_rect->decoded());
+        m_textureWatched = true;
+    }
+    m_item = stm;
+
+    updateViewMatrix();
+    // the camera just synchronized, for picking on the gui thread
+    QMatrix4x4 modelView = m_viewMatrix * mapMatrix();
+    GlobePicker picker(GlobePicker::Map);
+    picker.setCamera(m_projMatrix, modelView, m_viewportSize);
+    if (picker != stm->picker()) {
+        QMetaObject::invokeMethod(stm, "setPickCamera", Qt::QueuedConnection,
+                                  Q_ARG(QMatrix4x4, m_projMatrix),
+                                  Q_ARG(QMatrix4x4, modelView),
+                                  Q_ARG(QSize, m_viewportSize));
     }
 }
 
@@ -170,70 +318,150 @@ void ShowTextureMappingRenderer::updateProjection(int width, int height)
     }
 }
 
+void ShowTextureMappingRenderer::updateViewMatrix()
+{
+    // View transform: camera position
+    m_viewMatrix.setToIdentity();
+    m_viewMatrix.lookAt(cameraPosition, QVector3D(cameraPosition.toVector2D(), 0),
+                        QVector3D(0, 1, 0));
+}
+
+/*!
+ * \brief ShowTextureMappingRenderer::mapMatrix
+ * Places the unit square of GlobePicker::Map on the drawn rectangle.
+ */
+QMatrix4x4 ShowTextureMappingRenderer::mapMatrix() const
+{
+    QMatrix4x4 m;
+    m.scale(scale, scale, 1);
+    m.translate(-world.width() / 2, -world.height() / 2, -2);
+    m.scale(world.width(), world.height(), 1);
+    return m;
+}
+
 void ShowTextureMappingRenderer::render()
 {
+    m_passTimer.beginFrame();
+    // swap in the new vertices once their generation is done
+    if (m_spherePending && m_pendingSphere.isFinished()) {
+        createMappedVertices();
+    }
+    bool streaming = pTex_rect->advance();
+
+    m_msaa.bind(framebufferObject(), m_samples);
     glDepthMask(true);
     glClearColor(0.5f, 0.5f, 0.7f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // actual paint here
-    // View transform: camera position
-    m_viewMatrix.setToIdentity();
-    m_viewMatrix.lookAt(cameraPosition, QVector3D(cameraPosition.toVector2D(), 0),
-                        QVector3D(0, 1, 0));
-
-    paintRect();
+    // uploaded only when the camera moved, nothing here is lit
+    FrameUniforms frame;
+    memcpy(frame.projection, m_projMatrix.constData(), sizeof(frame.projection));
+    memcpy(frame.view, m_viewMatrix.constData(), sizeof(frame.view));
+    memset(frame.lightPosition, 0, sizeof(frame.lightPosition));
+    m_frameBlock.setData(frame);
+
+    {
+        PassTimer::Scope pass(m_passTimer, "texture");
+        paintRect();
+    }
     if (showMappedVertices) {
+        PassTimer::Scope pass(m_passTimer, "vertices");
         paintMappedVertices();
     }
+    if (m_msaa.isActive()) {
+        PassTimer::Scope pass(m_passTimer, "resolve");
+        m_msaa.resolve(framebufferObject());
+    }
+    m_passTimer.endFrame();
+
+    // no update() here: the item asks for frames when its state changes,
+    // only a texture still streaming in keeps the frames coming, and one
+    // more frame for timings still on the GPU
+    m_texturePending = streaming || !pTex_rect->decoded().isFinished();
+    if (streaming || m_passTimer.needsFrame()) {
+        update();
+    }
+    m_frames++;
+    publish();
+}
 
-    update();
+/*!
+ * \brief ShowTextureMappingRenderer::publish
+ * Hand the counters of the frame just drawn to the item, see
+ * Earth3DRenderer::publish.
+ */
+void ShowTextureMappingRenderer::publish()
+{
+    if (!m_item) {
+        return;
+    }
+    QMetaObject::invokeMethod(m_item, "setFramesRendered", Qt::QueuedConnection,
+                              Q_ARG(int, m_frames));
+    QMetaObject::invokeMethod(m_item, "setTexturePending", Qt::QueuedConnection,
+                              Q_ARG(bool, m_texturePending));
+    QMetaObject::invokeMethod(m_item, "setPassTimings", Qt::QueuedConnection,
+                              Q_ARG(QVariantMap, m_passTimer.timings()));
 }
 
 QOpenGLFramebufferObject *ShowTextureMappingRenderer::createFramebufferObject(
     const QSize &size)
 {
+    // single sampled, m_msaa resolves into it
     QOpenGLFramebufferObjectFormat format;
     format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
-    format.setSamples(4);
     return new QOpenGLFramebufferObject(size, format);
 }
 
+void ShowTextureMappingRenderer::requestMappedVertices()
+{
+    // same key as Earth3DRenderer, so the mesh is shared with the globe views
+    SphereKey key = { 1.0, resolution,
+                      SphereGenerator::SharedGrid, SphereGenerator::PackedInterleaved, shape
+                    };
+    m_pendingKey = key;
+    m_pendingSphere = SphereCache::instance()->requestGeometry(key);
+    m_spherePending = true;
+}
+
 void ShowTextureMappingRenderer::createMappedVertices()
 {
-    sphere.generate(1.0, resolution);
+    // the finished future keeps the geometry alive, so this only uploads
+    m_sphereMesh = SphereCache::instance()->mesh(m_pendingKey);
+    m_pendingSphere = QFuture<SphereCache::Geometry>();
+    m_spherePending = false;
 
     if (!vao_mv.isCreated()) { vao_mv.create(); }
     vao_mv.bind();
 
-    if (!ebo_mv.isCreated()) { ebo_mv.create();}
-    ebo_mv.bind();
-    ebo_mv.setUsagePattern(QOpenGLBuffer::StaticDraw);
-    ebo_mv.allocate(sphere.indices().constData(), sphere.indexDataLength());
-
-    if (vbo_mv.isCreated()) { vbo_mv.destroy(); }
-    vbo_mv.create();
-    vbo_mv.bind();
-    vbo_mv.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    m_sphereMesh->vertexBuffer().bind();
     // use texcoords here, and draw it with scale
-    vbo_mv.allocate(sphere.texcoords().constData(), sphere.texcoordDataLength());
-    glVertexAttribPointer(vertex_loc_0,
-                          2, GL_FLOAT, // tupleSize, type
-                          GL_FALSE, 0, // normalize, stride
-                          TO_OFFSET(0) // offset
-                         );
-    m_colorProg.enableAttributeArray(vertex_loc_0);
+    if (m_sphereMesh->vertexLayout() == SphereGenerator::PackedInterleaved) {
+        glVertexAttribPointer(vertex_loc_0,
+                              2, GL_UNSIGNED_SHORT, // tupleSize, type
+                              GL_TRUE, sizeof(SphereGenerator::PackedVertex), // normalize, stride
+                              TO_OFFSET(offsetof(SphereGenerator::PackedVertex, texcoord)) // offset
+                             );
+    } else {
+        glVertexAttribPointer(vertex_loc_0,
+                              2, GL_FLOAT, // tupleSize, type
+                              GL_FALSE, 0, // normalize, stride
+                              TO_OFFSET(m_sphereMesh->texcoordOffset()) // offset
+                             );
+    }
+    m_colorProg->enableAttributeArray(vertex_loc_0);
 
     vao_mv.release();
 }
 
 void ShowTextureMappingRenderer::createRect()
 {
-    auto img = QImage(":/assets/land_shallow_topo_2048.png").mirrored();
-    pTex_rect = new QOpenGLTexture(img);
+    pTex_rect = TextureCache::instance()->texture(
+                    QStringLiteral(":/assets/land_shallow_topo_2048.png"));
 
-    GLfloat w_2 = img.width() / (GLfloat) 2;
-    GLfloat h_2 = img.height() / (GLfloat) 2;
+    // known from the image header, before it is decoded
+    GLfloat w_2 = pTex_rect->size().width() / (GLfloat) 2;
+    GLfloat h_2 = pTex_rect->size().height() / (GLfloat) 2;
     world.setRect(-w_2, h_2, 2 * w_2, 2 * h_2);
 
     GLfloat vertices[] = {
@@ -267,14 +495,18 @@ void ShowTextureMappingRenderer::createRect()
                           GL_FALSE, 0, // normalize, stride
                           reinterpret_cast<const void *>(sizeof(vertices)) // offset
                          );
-    m_texProg.enableAttributeArray(vertex_loc_1);
-    m_texProg.enableAttributeArray(texcoord_loc_1);
+    m_texProg->enableAttributeArray(vertex_loc_1);
+    m_texProg->enableAttributeArray(texcoord_loc_1);
 
     vao_rect.release();
 }
 
 void ShowTextureMappingRenderer::paintMappedVertices()
 {
+    if (!m_sphereMesh) {
+        return;
+    }
+
     QMatrix4x4 m;
     // Model transform
     m.scale(scale, scale, 0.99);
@@ -282,35 +514,23 @@ void ShowTextureMappingRenderer::paintMappedVertices()
     m.scale(world.width(), world.height(), 1);
     m.translate(0, 0, -2);
 
-    m_colorProg.bind();
-    m_colorProg.setUniformValue(mv_matrix_loc_0, m_viewMatrix * m);
-    m_colorProg.setUniformValue(proj_matrix_loc_0, m_projMatrix);
-    m_colorProg.setAttributeValue(color_loc_0, QColor(255, 128, 0));
+    m_colorProg->bind();
+    m_frameBlock.bind(m_colorProg.data());
+    m_colorProg->setUniformValue(model_matrix_loc_0, m);
+    m_colorProg->setAttributeValue(color_loc_0, QColor(255, 128, 0));
 
     vao_mv.bind();
     // draw
 #if defined(Q_OS_ANDROID) || defined(TEST_ANDROID_LOCAL)
-    int lastIdx = 0;
-    for (auto idx : sphere.restartPoints(true)) {
-        int count = idx - lastIdx;
-        glDrawElements(GL_LINE_STRIP, count, GL_UNSIGNED_INT,
-                       TO_OFFSET(lastIdx * sizeof(GLuint)));
-        lastIdx = idx + 1;
-    }
+    m_sphereMesh->wireStrips().draw();
 #else
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    int lastIdx = 0;
-    for (auto idx : sphere.restartPoints(true)) {
-        int count = idx - lastIdx;
-        glDrawElements(GL_TRIANGLE_STRIP, count, GL_UNSIGNED_INT,
-                       TO_OFFSET(lastIdx * sizeof(GLuint)));
-        lastIdx = idx + 1;
-    }
+    m_sphereMesh->strips().draw();
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 #endif
 
     vao_mv.release();
-    m_colorProg.release();
+    m_colorProg->release();
 }
 
 void ShowTextureMappingRenderer::paintRect()
@@ -319,9 +539,9 @@ void ShowTextureMappingRenderer::paintRect()
     // Model transform
     m.scale(scale, scale, 1);
 
-    m_texProg.bind();
-    m_colorProg.setUniformValue(mv_matrix_loc_1, m_viewMatrix * m);
-    m_texProg.setUniformValue(proj_matrix_loc_1, m_projMatrix);
+    m_texProg->bind();
+    m_frameBlock.bind(m_texProg.data());
+    m_texProg->setUniformValue(model_matrix_loc_1, m);
 
     vao_rect.bind();
     pTex_rect->bind();
@@ -330,5 +550,5 @@ void ShowTextureMappingRenderer::paintRect()
 
     pTex_rect->release();
     vao_rect.release();
-    m_texProg.release();
+    m_texProg->release();
 }
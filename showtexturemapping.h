@@ -1,13 +1,23 @@
 #ifndef SHOWTEXTUREMAPPING_H
 #define SHOWTEXTUREMAPPING_H
 
+#include <QFutureWatcher>
 #include <QOpenGLBuffer>
 #include <QOpenGLFunctions>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLTexture>
 #include <QOpenGLVertexArrayObject>
+#include <QPointer>
 #include <QQuickFramebufferObject>
-#include "spheregenerator.h"
+#include <QVariantMap>
+#include "earth3d.h"
+#include "globepicker.h"
+#include "msaatarget.h"
+#include "passtimer.h"
+#include "shadercache.h"
+#include "spherecache.h"
+#include "texturecache.h"
+#include "uniformblock.h"
 
 using FBO = QQuickFramebufferObject;
 
@@ -23,9 +33,27 @@ class ShowTextureMapping : public QQuickFramebufferObject
     Q_PROPERTY(int sphereResolution
                READ sphereResolution WRITE setSphereResolution
                NOTIFY sphereResolutionChanged)
+    Q_PROPERTY(Earth3D::SphereShape sphereShape
+               READ sphereShape WRITE setSphereShape
+               NOTIFY sphereShapeChanged)
     Q_PROPERTY(QVector3D cameraPosition
                READ cameraPosition WRITE setCameraPosition
                NOTIFY cameraPositionChanged)
+    Q_PROPERTY(int samples
+               READ samples WRITE setSamples
+               NOTIFY samplesChanged)
+    Q_PROPERTY(bool spherePending
+               READ spherePending
+               NOTIFY spherePendingChanged)
+    Q_PROPERTY(bool texturePending
+               READ texturePending
+               NOTIFY texturePendingChanged)
+    Q_PROPERTY(int framesRendered
+               READ framesRendered
+               NOTIFY framesRenderedChanged)
+    Q_PROPERTY(QVariantMap passTimings
+               READ passTimings
+               NOTIFY passTimingsChanged)
 public:
     ShowTextureMapping();
     ~ShowTextureMapping();
@@ -42,23 +70,72 @@ public:
     int sphereResolution() const { return m_sphereResolution; }
     void setSphereResolution(int newResolution);
 
+    // the same setting as on Earth3D, so both views can share it
+    Earth3D::SphereShape sphereShape() const { return m_sphereShape; }
+    void setSphereShape(Earth3D::SphereShape shape);
+
     QVector3D cameraPosition() const { return m_cameraPosition; }
     void setCameraPosition(const QVector3D &pos);
 
-//    Q_INVOKABLE
-//    QVector2D screenToWorld(const QVector2D &xy);
+    // MSAA samples the renderer draws with before resolving
+    int samples() const { return m_samples; }
+    void setSamples(int samples);
+
+    bool spherePending() const { return m_spherePending; }
+    // until the texture is decoded and fully uploaded, as of the last frame
+    bool texturePending() const { return m_texturePending; }
+    // frames the renderer has drawn, stays put while nothing changes
+    int framesRendered() const { return m_framesRendered; }
+    // GPU milliseconds per render pass of a recent frame, see PassTimer
+    QVariantMap passTimings() const { return m_passTimings; }
+    // longitude and latitude in degrees of the map at an item position,
+    // as a point, undefined off the map; see GlobePicker
+    Q_INVOKABLE QVariant screenToLonLat(double x, double y) const;
+    // the same for a list of points
+    Q_INVOKABLE QVariantList screenToLonLatList(const QVariantList &positions) const;
+    // camera of the last synchronized frame, for picking from C++
+    const GlobePicker &picker() const { return m_picker; }
+
+    // called by the renderer during synchronize
+    void watchSphere(const QFuture<void> &future);
+    void watchTexture(const QFuture<void> &future);
 
 signals:
     void showMappedVerticesChanged();
     void contentScaleChanged();
     void sphereResolutionChanged();
+    void sphereShapeChanged();
     void cameraPositionChanged();
+    void samplesChanged();
+    void spherePendingChanged();
+    void texturePendingChanged();
+    void framesRenderedChanged();
+    void passTimingsChanged();
+
+private slots:
+    void updateSpherePending();
+    // queued from the renderer
+    void setFramesRendered(int frames);
+    void setTexturePending(bool pending);
+    void setPassTimings(const QVariantMap &timings);
+    void setPickCamera(const QMatrix4x4 &projection, const QMatrix4x4 &modelView,
+                       const QSize &viewport);
 
 private:
     bool m_showMappedVertices;
     double m_contentScale;
     int m_sphereResolution;
+    Earth3D::SphereShape m_sphereShape;
     QVector3D m_cameraPosition;
+    int m_samples;
+
+    QFutureWatcher<void> m_sphereWatcher;
+    QFutureWatcher<void> m_textureWatcher;
+    bool m_spherePending;
+    bool m_texturePending;
+    int m_framesRendered;
+    QVariantMap m_passTimings;
+    GlobePicker m_picker;
 };
 
 class ShowTextureMappingRenderer : public FBO::Renderer, protected QOpenGLFunctions
@@ -74,11 +151,14 @@ public:
 protected:
     void initialize();
     void createGeometry();
+    void publish();
 
     void updateProjection(int width, int height);
-    QVector2D scrCoordToModel(const QVector2D &xy);
+    void updateViewMatrix();
+    QMatrix4x4 mapMatrix() const;
 
     void createRect();
+    void requestMappedVertices();
     void createMappedVertices();
 
     void paintRect();
@@ -88,6 +168,14 @@ private:
     // outside state
     bool showMappedVertices;
     int resolution;
+    SphereGenerator::Shape shape;
+    bool m_sphereDirty;
+    int m_samples;
+    int m_frames;
+    // set during synchronize, render() publishes its counters to it
+    QPointer<ShowTextureMapping> m_item;
+    MsaaTarget m_msaa;
+    PassTimer m_passTimer;
     double scale;
     QVector3D cameraPosition;
     QSize m_viewportSize;
@@ -101,25 +189,30 @@ private:
     // rectangle
     QOpenGLVertexArrayObject vao_rect;
     QOpenGLBuffer vbo_rect;
-    QOpenGLTexture *pTex_rect;
+    QSharedPointer<StreamedTexture> pTex_rect;
+    bool m_textureWatched;
+    // the texture was still coming in the last frame
+    bool m_texturePending;
     // mapped vertices
     QOpenGLVertexArrayObject vao_mv;
-    QOpenGLBuffer vbo_mv;
-    QOpenGLBuffer ebo_mv;
-    SphereGenerator sphere;
+    QSharedPointer<SphereMesh> m_sphereMesh;
+    QFuture<SphereCache::Geometry> m_pendingSphere;
+    SphereKey m_pendingKey;
+    bool m_spherePending;
+
+    // camera, for both programs
+    UniformBlock m_frameBlock;
 
-    // shaders and attributes locations
-    QOpenGLShaderProgram m_colorProg;
-    QOpenGLShaderProgram m_texProg;
+    // shaders, from ShaderCache, and attributes locations
+    QSharedPointer<QOpenGLShaderProgram> m_colorProg;
+    QSharedPointer<QOpenGLShaderProgram> m_texProg;
     int vertex_loc_0;
     int color_loc_0;
-    int mv_matrix_loc_0;
-    int proj_matrix_loc_0;
+    int model_matrix_loc_0;
 
     int vertex_loc_1;
     int texcoord_loc_1;
-    int mv_matrix_loc_1;
-    int proj_matrix_loc_1;
+    int model_matrix_loc_1;
 };
 
 
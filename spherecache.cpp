@@ -0,0 +1,146 @@
+#include <QFutureInterface>
+#include <QMutexLocker>
+#include <QOpenGLContext>
+#include <QtConcurrent>
+#include "spherecache.h"
+
+bool operator==(const SphereKey &a, const SphereKey &b)
+{
+    return a.radius == b.radius && a.resolution == b.resolution
+           && a.topology == b.topology && a.layout == b.layout && a.shape == b.shape;
+}
+
+uint qHash(const SphereKey &key, uint seed)
+{
+    return qHash(key.radius, seed) ^ qHash(key.resolution, seed)
+           ^ qHash((int(key.shape) << 8) | (int(key.topology) << 4) | int(key.layout), seed);
+}
+
+SphereMesh::SphereMesh(const SphereGenerator &sphere)
+    : m_layout(sphere.vertexLayout())
+    , m_vertexCount(sphere.vertexCount())
+    , m_texcoordOffset(0), m_normalOffset(0)
+    , m_vbo()
+{
+    m_vbo.create();
+    m_vbo.bind();
+    m_vbo.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    if (m_layout == SphereGenerator::PackedInterleaved) {
+        m_vbo.allocate(sphere.packedVertices().constData(), sphere.packedDataLength());
+    } else {
+        m_texcoordOffset = sphere.vertexDataLength();
+        m_normalOffset = m_texcoordOffset + sphere.texcoordDataLength();
+        m_vbo.allocate(m_normalOffset + sphere.normalDataLength());
+        m_vbo.write(0, sphere.vertices().constData(), sphere.vertexDataLength());
+        m_vbo.write(m_texcoordOffset, sphere.texcoords().constData(),
+                    sphere.texcoordDataLength());
+        m_vbo.write(m_normalOffset, sphere.normals().constData(), sphere.normalDataLength());
+    }
+    m_vbo.release();
+
+    // fill strips in patch order, so culled patches can be skipped
+    m_patches = sphere.patches();
+    QVector<int> groups;
+    groups.reserve(m_patches.size());
+    for (const SphereGenerator::Patch &patch : m_patches) {
+        groups << patch.firstIndex;
+    }
+    GLenum fillMode = sphere.fillPrimitive() == SphereGenerator::Triangles
+                      ? GL_TRIANGLES : GL_TRIANGLE_STRIP;
+    m_strips.setStrips(fillMode, sphere.patchIndices().constData(),
+                       sphere.patchIndices().size(), sphere.restartIndex(), groups);
+#if defined(Q_OS_ANDROID) || defined(TEST_ANDROID_LOCAL)
+    if (sphere.wirePrimitive() == SphereGenerator::Lines) {
+        // triangle meshes list their edges after the filled part
+        auto fillRestarts = sphere.restartPoints();
+        int fillCount = fillRestarts.isEmpty() ? 0 : fillRestarts.last() + 1;
+        m_wireStrips.setStrips(GL_LINES, sphere.indices().constData() + fillCount,
+                               sphere.indices().size() - fillCount, sphere.restartIndex());
+    } else {
+        m_wireStrips.setStrips(GL_LINE_STRIP, sphere.indices().constData(),
+                               sphere.indices().size(), sphere.restartIndex());
+    }
+#endif
+}
+
+SphereCache *SphereCache::instance()
+{
+    static SphereCache cache;
+    return &cache;
+}
+
+static QFuture<SphereCache::Geometry> readyFuture(const SphereCache::Geometry &sphere)
+{
+    QFutureInterface<SphereCache::Geometry> fi;
+    fi.reportStarted();
+    fi.reportResult(sphere);
+    fi.reportFinished();
+    return fi.future();
+}
+
+QFuture<SphereCache::Geometry> SphereCache::requestGeometry(const SphereKey &key)
+{
+    QMutexLocker locker(&m_mutex);
+    auto cached = m_geometries.value(key).toStrongRef();
+    if (cached) {
+        return readyFuture(cached);
+    }
+    if (m_pending.contains(key)) {
+        return m_pending.value(key);
+    }
+    auto future = QtConcurrent::run(this, &SphereCache::generate, key);
+    m_pending.insert(key, future);
+    return future;
+}
+
+SphereCache::Geometry SphereCache::geometry(const SphereKey &key)
+{
+    return requestGeometry(key).result();
+}
+
+SphereCache::Geometry SphereCache::generate(const SphereKey &key)
+{
+    QSharedPointer<SphereGenerator> sphere(SphereGenerator::create(key.shape));
+    sphere->setTopology(key.topology);
+    sphere->setVertexLayout(key.layout);
+    sphere->generate(key.radius, key.resolution);
+
+    QMutexLocker locker(&m_mutex);
+    m_geometries.insert(key, sphere);
+    m_pending.remove(key);
+    return sphere;
+}
+
+QSharedPointer<SphereMesh> SphereCache::mesh(const SphereKey &key)
+{
+    MeshKey meshKey(QOpenGLContextGroup::currentContextGroup(), key);
+    {
+        QMutexLocker locker(&m_mutex);
+        auto cached = m_meshes.value(meshKey).toStrongRef();
+        if (cached) {
+            return cached;
+        }
+    }
+
+    auto sphere = geometry(key);
+    QSharedPointer<SphereMesh> mesh(new SphereMesh(*sphere));
+
+    QMutexLocker locker(&m_mutex);
+    // drop entries whose last user is gone
+    for (auto it = m_meshes.begin(); it != m_meshes.end();) {
+        if (it.value().isNull()) {
+            it = m_meshes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = m_geometries.begin(); it != m_geometries.end();) {
+        if (it.value().isNull()) {
+            it = m_geometries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_meshes.insert(meshKey, mesh);
+    return mesh;
+}
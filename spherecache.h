@@ -0,0 +1,95 @@
+#ifndef SPHERECACHE_H
+#define SPHERECACHE_H
+
+#include <QFuture>
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLBuffer>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include "spheregenerator.h"
+#include "stripdrawer.h"
+
+class QOpenGLContextGroup;
+
+struct SphereKey
+{
+    double radius;
+    int resolution;
+    SphereGenerator::Topology topology;
+    SphereGenerator::VertexLayout layout;
+    SphereGenerator::Shape shape;
+};
+
+bool operator==(const SphereKey &a, const SphereKey &b);
+uint qHash(const SphereKey &key, uint seed = 0);
+
+/*!
+ * \brief The SphereMesh class
+ * GPU side of a cached sphere: the vertex buffer and the strip index
+ * buffers, shared by every renderer in the same context share group.
+ * Vertex array objects can not be shared and stay with the renderers.
+ */
+class SphereMesh
+{
+public:
+    explicit SphereMesh(const SphereGenerator &sphere);
+
+    SphereGenerator::VertexLayout vertexLayout() const { return m_layout; }
+    int vertexCount() const { return m_vertexCount; }
+
+    QOpenGLBuffer &vertexBuffer() { return m_vbo; }
+    // offsets of the float streams in vertexBuffer(), FloatStreams layout only
+    int vertexOffset() const { return 0; }
+    int texcoordOffset() const { return m_texcoordOffset; }
+    int normalOffset() const { return m_normalOffset; }
+
+    // the filled triangle strips, one group per patch
+    StripDrawer &strips() { return m_strips; }
+    const QVector<SphereGenerator::Patch> &patches() const { return m_patches; }
+    // every strip, drawn as lines; only built where there is no polygon mode
+    StripDrawer &wireStrips() { return m_wireStrips; }
+
+private:
+    SphereGenerator::VertexLayout m_layout;
+    int m_vertexCount;
+    int m_texcoordOffset;
+    int m_normalOffset;
+    QOpenGLBuffer m_vbo;
+    StripDrawer m_strips;
+    StripDrawer m_wireStrips;
+    QVector<SphereGenerator::Patch> m_patches;
+};
+
+/*!
+ * \brief The SphereCache class
+ * Process wide, reference counted cache of sphere geometry. Each key is
+ * generated once on the CPU and uploaded once per context share group,
+ * however many views ask for it. Entries go away with their last user.
+ */
+class SphereCache
+{
+public:
+    typedef QSharedPointer<const SphereGenerator> Geometry;
+
+    static SphereCache *instance();
+
+    // generated on the global thread pool; concurrent requests share one job
+    QFuture<Geometry> requestGeometry(const SphereKey &key);
+    Geometry geometry(const SphereKey &key);
+    // needs a current context
+    QSharedPointer<SphereMesh> mesh(const SphereKey &key);
+
+protected:
+    Geometry generate(const SphereKey &key);
+
+private:
+    typedef QPair<QOpenGLContextGroup *, SphereKey> MeshKey;
+
+    QMutex m_mutex;
+    QHash<SphereKey, QWeakPointer<const SphereGenerator>> m_geometries;
+    QHash<SphereKey, QFuture<Geometry>> m_pending;
+    QHash<MeshKey, QWeakPointer<SphereMesh>> m_meshes;
+};
+
+#endif // SPHERECACHE_H
@@ -1,6 +1,161 @@
 #include <QtMath>
 #include <QDebug>
+#include <QHash>
+#include <QSet>
+#include <QThread>
+#include <QVarLengthArray>
+#include <QtConcurrent>
 #include "spheregenerator.h"
+#include "cubespheregenerator.h"
+#include "icospheregenerator.h"
+
+// below this many vertices the thread pool costs more than it saves
+static const int ParallelVertexThreshold = 1 << 16;
+
+static inline qint16 packSnorm16(float x)
+{
+    return qRound(qBound(-1.0f, x, 1.0f) * 32767);
+}
+
+static inline quint16 packUnorm16(float x)
+{
+    return qRound(qBound(0.0f, x, 1.0f) * 65535);
+}
+
+static inline SphereGenerator::PackedVertex packVertex(const QVector3D &p,
+                                                       const QVector2D &uv, float radius)
+{
+    QVector3D n = p / radius;
+    SphereGenerator::PackedVertex v;
+    v.position[0] = packSnorm16(n.x());
+    v.position[1] = packSnorm16(n.y());
+    v.position[2] = packSnorm16(n.z());
+    v.position[3] = 32767;
+    v.texcoord[0] = packUnorm16(uv.x());
+    v.texcoord[1] = packUnorm16(uv.y());
+    return v;
+}
+
+namespace {
+
+/*
+ * Everything generate() needs per vertex, computed once per column and row.
+ * The values are the very same doubles fromPoleCoord() and uvCoordNew()
+ * produce, so the output matches generateReference() bit for bit.
+ */
+struct GridTables
+{
+    QVector<double> cosAlpha;
+    QVector<double> sinAlpha;
+    QVector<double> ringRadius;
+    QVector<double> ringHeight;
+    QVector<float> u;
+    QVector<float> v;
+    float radius;
+
+    // output, sized by the caller
+    QVector3D *vertices;
+    QVector3D *normals;
+    QVector2D *texcoords;
+    SphereGenerator::PackedVertex *packed;
+};
+
+/*
+ * Write grid row j to dst, dst + step, ... for every column.
+ */
+void fillRow(const GridTables &t, int j, int dst, int step)
+{
+    const int columns = t.cosAlpha.size();
+    const double ringR = t.ringRadius[j];
+    const float y = t.ringHeight[j];
+    const float v = t.v[j];
+    const double *cosAlpha = t.cosAlpha.constData();
+    const double *sinAlpha = t.sinAlpha.constData();
+
+    // plain loops over arrays without dependencies, so they get vectorized
+    QVarLengthArray<float, 1024> xs(columns);
+    QVarLengthArray<float, 1024> zs(columns);
+    for (int i = 0; i < columns; i++) {
+        xs[i] = ringR * cosAlpha[i];
+    }
+    for (int i = 0; i < columns; i++) {
+        zs[i] = ringR * sinAlpha[i];
+    }
+
+    if (t.packed) {
+        for (int i = 0; i < columns; i++) {
+            t.packed[dst + i * step] = packVertex(QVector3D(xs[i], y, zs[i]),
+                                                  QVector2D(t.u[i], v), t.radius);
+        }
+        return;
+    }
+    for (int i = 0; i < columns; i++) {
+        QVector3D p(xs[i], y, zs[i]);
+        t.vertices[dst + i * step] = p;
+        t.normals[dst + i * step] = p;
+        t.texcoords[dst + i * step] = QVector2D(t.u[i], v);
+    }
+}
+
+/*
+ * Run fn(begin, end) over [0, count) split in chunks across the global
+ * thread pool, or inline when there is too little work.
+ */
+template <typename Fn>
+void forEachChunk(int count, int work, Fn fn)
+{
+    int chunks = work < ParallelVertexThreshold
+                 ? 1 : qMin(count, 4 * QThread::idealThreadCount());
+    if (chunks <= 1) {
+        fn(0, count);
+        return;
+    }
+    QVector<int> starts;
+    starts.reserve(chunks);
+    for (int c = 0; c < chunks; c++) {
+        starts << c * count / chunks;
+    }
+    QtConcurrent::blockingMap(starts, [&](const int &begin) {
+        int c = &begin - starts.constData();
+        int end = c + 1 < chunks ? starts.at(c + 1) : count;
+        fn(begin, end);
+    });
+}
+
+} // namespace
+
+SphereGenerator::SphereGenerator()
+    : m_topology(SharedGrid)
+    , m_layout(FloatStreams)
+    , m_radius(1.0)
+    , m_fillPrimitive(TriangleStrips)
+    , m_wirePrimitive(LineStrips)
+#if defined(Q_OS_ANDROID) || defined(TEST_ANDROID_LOCAL)
+    , m_maxRestartPointsForNonWireframe(0)
+#endif
+{
+}
+
+SphereGenerator::~SphereGenerator()
+{
+}
+
+/*!
+ * \brief SphereGenerator::create
+ * \return a new generator of the given shape, owned by the caller
+ */
+SphereGenerator *SphereGenerator::create(Shape shape)
+{
+    switch (shape) {
+    case Icosphere:
+        return new IcosphereGenerator;
+    case CubeSphere:
+        return new CubeSphereGenerator;
+    case UvSphere:
+        break;
+    }
+    return new SphereGenerator;
+}
 
 /*!
  * \brief SphereGenerator::fromPoleCoord
@@ -29,6 +184,23 @@ QVector2D SphereGenerator::uvCoordNew(int i, int j, int resolution)
     return QVector2D(u, v);
 }
 
+int SphereGenerator::vertexCount() const
+{
+    return m_layout == PackedInterleaved ? m_packed.size() : m_vertices.size();
+}
+
+void SphereGenerator::addVertex(const QVector3D &p, const QVector2D &uv)
+{
+    if (m_layout == FloatStreams) {
+        m_vertices << p;
+        m_normals << p;
+        m_texcoords << uv;
+        return;
+    }
+
+    m_packed << packVertex(p, uv, m_radius);
+}
+
 QVector<int> SphereGenerator::restartPoints(bool drawWireframe) const
 {
 #if defined(Q_OS_ANDROID) || defined(TEST_ANDROID_LOCAL)
@@ -43,13 +215,233 @@ QVector<int> SphereGenerator::restartPoints(bool drawWireframe) const
 #endif
 }
 
-void SphereGenerator::generate(double radius, int resolution)
+void SphereGenerator::clear()
 {
     m_vertices.clear();
     m_normals.clear();
     m_indices.clear();
     m_texcoords.clear();
+    m_packed.clear();
     m_restartPoints.clear();
+    m_patches.clear();
+    m_patchIndices.clear();
+    m_fillPrimitive = TriangleStrips;
+    m_wirePrimitive = LineStrips;
+}
+
+/*!
+ * \brief SphereGenerator::generate
+ * Table driven and multi-threaded version of generateReference(),
+ * with all outputs sized up front. Produces identical data.
+ */
+void SphereGenerator::generate(double radius, int resolution)
+{
+    clear();
+    m_radius = radius;
+
+    const bool shared = m_topology == SharedGrid;
+    const int columns = 2 * resolution + 1;
+    // separate strips also emit the band past the last row
+    const int bands = shared ? resolution : resolution + 1;
+    const int rows = resolution + (shared ? 1 : 2);
+    const int vertexCount = shared ? columns * rows : 2 * columns * bands;
+
+    /*
+     * 0 <= alpha <= 2*pi
+     * -pi/2 <= beta <= pi/2
+     */
+    GridTables t;
+    t.cosAlpha.resize(columns);
+    t.sinAlpha.resize(columns);
+    t.u.resize(columns);
+    for (int i = 0; i < columns; i++) {
+        double alpha = i / (double) resolution * M_PI;
+        t.cosAlpha[i] = qCos(alpha);
+        t.sinAlpha[i] = qSin(alpha);
+        t.u[i] = uvCoordNew(i, 0, resolution).x();
+    }
+    t.ringRadius.resize(rows);
+    t.ringHeight.resize(rows);
+    t.v.resize(rows);
+    for (int j = 0; j < rows; j++) {
+        double beta = j / (double) resolution * M_PI - M_PI_2;
+        t.ringRadius[j] = radius * qCos(beta);
+        t.ringHeight[j] = radius * qSin(beta);
+        t.v[j] = uvCoordNew(0, j, resolution).y();
+    }
+    t.radius = radius;
+    t.vertices = nullptr;
+    t.normals = nullptr;
+    t.texcoords = nullptr;
+    t.packed = nullptr;
+    if (m_layout == FloatStreams) {
+        m_vertices.resize(vertexCount);
+        m_normals.resize(vertexCount);
+        m_texcoords.resize(vertexCount);
+        t.vertices = m_vertices.data();
+        t.normals = m_normals.data();
+        t.texcoords = m_texcoords.data();
+    } else {
+        m_packed.resize(vertexCount);
+        t.packed = m_packed.data();
+    }
+
+    // one triangle strip and a restart index per band
+    const int stripLength = 2 * columns + 1;
+    int indexCount = bands * stripLength;
+    int restartCount = bands;
+#if defined(Q_OS_ANDROID) || defined(TEST_ANDROID_LOCAL)
+    // then the wireframe: one line per row, or two per band
+    const int lineLength = columns + 1;
+    const int lines = shared ? rows : 2 * bands;
+    indexCount += lines * lineLength;
+    restartCount += lines;
+#endif
+    m_indices.resize(indexCount);
+    m_restartPoints.resize(restartCount);
+    unsigned int *indices = m_indices.data();
+    int *restarts = m_restartPoints.data();
+    const unsigned int restart = restartIndex();
+
+    forEachChunk(bands, vertexCount, [&](int begin, int end) {
+        for (int j = begin; j < end; j++) {
+            unsigned int *strip = indices + j * stripLength;
+            if (shared) {
+                fillRow(t, j, j * columns, 1);
+                if (j + 1 == bands) {
+                    fillRow(t, j + 1, (j + 1) * columns, 1);
+                }
+                unsigned int row = j * columns;
+                for (int i = 0; i < columns; i++) {
+                    strip[2 * i] = row + i;
+                    strip[2 * i + 1] = row + columns + i;
+                }
+            } else {
+                unsigned int first = 2 * j * columns;
+                fillRow(t, j, first, 2);
+                fillRow(t, j + 1, first + 1, 2);
+                for (int i = 0; i < 2 * columns; i++) {
+                    strip[i] = first + i;
+                }
+            }
+            strip[2 * columns] = restart;
+            restarts[j] = j * stripLength + 2 * columns;
+        }
+    });
+
+#if defined(Q_OS_ANDROID) || defined(TEST_ANDROID_LOCAL)
+    m_maxRestartPointsForNonWireframe = bands;
+    const int lineBase = bands * stripLength;
+    for (int l = 0; l < lines; l++) {
+        unsigned int *line = indices + lineBase + l * lineLength;
+        // shared: row l; separate: even rows of band l / 2, then odd ones
+        unsigned int first = shared ? l * columns : 2 * (l / 2) * columns + l % 2;
+        unsigned int step = shared ? 1 : 2;
+        for (int i = 0; i < columns; i++) {
+            line[i] = first + i * step;
+        }
+        line[columns] = restart;
+        restarts[bands + l] = lineBase + l * lineLength + columns;
+    }
+#endif
+
+    buildPatches(radius, resolution);
+}
+
+/*!
+ * \brief SphereGenerator::generateReference
+ * The straightforward scalar generator, kept to validate generate().
+ */
+void SphereGenerator::generateReference(double radius, int resolution)
+{
+    clear();
+    m_radius = radius;
+
+    if (m_topology == SharedGrid) {
+        generateSharedGrid(radius, resolution);
+    } else {
+        generateSeparateStrips(radius, resolution);
+    }
+    buildPatches(radius, resolution);
+}
+
+/*!
+ * \brief SphereGenerator::buildPatches
+ * Cut the bands into blocks of about 22.5 by 22.5 degrees, each with its own
+ * restart separated strips in patchIndices() and bounds for culling.
+ */
+void SphereGenerator::buildPatches(double radius, int resolution)
+{
+    const bool shared = m_topology == SharedGrid;
+    const int columns = 2 * resolution + 1;
+    const int bands = shared ? resolution : resolution + 1;
+    const int rows = bands + 1;
+    const int span = qMax(1, resolution / 8);
+    const float scale = m_layout == PackedInterleaved ? 1.0f : radius;
+    const double step = M_PI / resolution;
+
+    QVector<double> cosAlpha(columns), sinAlpha(columns);
+    for (int i = 0; i < columns; i++) {
+        cosAlpha[i] = qCos(i * step);
+        sinAlpha[i] = qSin(i * step);
+    }
+    QVector<double> cosBeta(rows), sinBeta(rows);
+    for (int j = 0; j < rows; j++) {
+        cosBeta[j] = qCos(j * step - M_PI_2);
+        sinBeta[j] = qSin(j * step - M_PI_2);
+    }
+
+    const int bandPatches = (bands + span - 1) / span;
+    const int columnPatches = (columns - 1 + span - 1) / span;
+    m_patches.reserve(bandPatches * columnPatches);
+    m_patchIndices.reserve(bands * (2 * (columns + columnPatches) + columnPatches));
+    for (int b0 = 0; b0 < bands; b0 += span) {
+        int b1 = qMin(b0 + span, bands);
+        for (int c0 = 0; c0 + 1 < columns; c0 += span) {
+            int c1 = qMin(c0 + span, columns - 1);
+
+            Patch patch;
+            patch.firstIndex = m_patchIndices.size();
+            for (int j = b0; j < b1; j++) {
+                for (int i = c0; i <= c1; i++) {
+                    unsigned int lower = shared ? j * columns + i : 2 * (j * columns + i);
+                    unsigned int upper = shared ? lower + columns : lower + 1;
+                    m_patchIndices << lower << upper;
+                }
+                m_patchIndices << restartIndex();
+            }
+            patch.indexCount = m_patchIndices.size() - patch.firstIndex;
+
+            patch.axis = fromPoleCoord((c0 + c1) / 2.0 * step,
+                                       (b0 + b1) / 2.0 * step - M_PI_2, 1.0);
+            patch.boxMin = QVector3D(1, 1, 1);
+            patch.boxMax = QVector3D(-1, -1, -1);
+            float minCos = 1;
+            for (int j = b0; j <= b1; j++) {
+                for (int i = c0; i <= c1; i++) {
+                    QVector3D q(cosBeta[j] * cosAlpha[i], sinBeta[j], cosBeta[j] * sinAlpha[i]);
+                    patch.boxMin = QVector3D(qMin(patch.boxMin.x(), q.x()),
+                                             qMin(patch.boxMin.y(), q.y()),
+                                             qMin(patch.boxMin.z(), q.z()));
+                    patch.boxMax = QVector3D(qMax(patch.boxMax.x(), q.x()),
+                                             qMax(patch.boxMax.y(), q.y()),
+                                             qMax(patch.boxMax.z(), q.z()));
+                    minCos = qMin(minCos, QVector3D::dotProduct(q, patch.axis));
+                }
+            }
+            // leave room for rounding and packing, triangles lie inside the box
+            const QVector3D pad(1e-4f, 1e-4f, 1e-4f);
+            patch.boxMin = (patch.boxMin - pad) * scale;
+            patch.boxMax = (patch.boxMax + pad) * scale;
+            // a face normal may lean one more cell away than its corners
+            patch.coneAngle = qAcos(qBound(-1.0f, minCos, 1.0f)) + step;
+            m_patches << patch;
+        }
+    }
+}
+
+void SphereGenerator::generateSeparateStrips(double radius, int resolution)
+{
     int count = 0;
     /*
      * 0 <= alpha <= 2*pi
@@ -66,12 +458,10 @@ void SphereGenerator::generate(double radius, int resolution)
 
             m_indices.append(count++);
             m_indices.append(count++);
-            m_vertices << p0 << p1;
-            m_normals << p0 << p1;
-            //            m_texcoords << uvCoord(p0, radius)
-            //                        << uvCoord(p1, radius);
-            m_texcoords << uvCoordNew(i, j, resolution)
-                        << uvCoordNew(i, j + 1, resolution);
+            //            addVertex(p0, uvCoord(p0, radius));
+            //            addVertex(p1, uvCoord(p1, radius));
+            addVertex(p0, uvCoordNew(i, j, resolution));
+            addVertex(p1, uvCoordNew(i, j + 1, resolution));
         }
         m_restartPoints << m_indices.size();
         m_indices << restartIndex();
@@ -99,3 +489,263 @@ void SphereGenerator::generate(double radius, int resolution)
     }
 #endif
 }
+
+/*!
+ * \brief SphereGenerator::generateSharedGrid
+ * Emits the (2 * resolution + 1) x (resolution + 1) grid once, band j strips
+ * then index rows j and j + 1, so neighbouring bands share a vertex row.
+ */
+void SphereGenerator::generateSharedGrid(double radius, int resolution)
+{
+    const int columns = 2 * resolution + 1;
+    const int rows = resolution + 1;
+    if (m_layout == FloatStreams) {
+        m_vertices.reserve(columns * rows);
+        m_normals.reserve(columns * rows);
+        m_texcoords.reserve(columns * rows);
+    } else {
+        m_packed.reserve(columns * rows);
+    }
+
+    for (int j = 0; j < rows; j++) {
+        double beta = j / (double) resolution * M_PI - M_PI_2;
+        for (int i = 0; i < columns; i++) {
+            double alpha = i / (double) resolution * M_PI;
+            addVertex(fromPoleCoord(alpha, beta, radius), uvCoordNew(i, j, resolution));
+        }
+    }
+
+    for (int j = 0; j < resolution; j++) {
+        unsigned int row = j * columns;
+        unsigned int rowN = row + columns;
+        for (int i = 0; i < columns; i++) {
+            m_indices << row + i << rowN + i;
+        }
+        m_restartPoints << m_indices.size();
+        m_indices << restartIndex();
+    }
+#if defined(Q_OS_ANDROID) || defined(TEST_ANDROID_LOCAL)
+    // wireframe: one line strip per latitude row
+    m_maxRestartPointsForNonWireframe = m_restartPoints.size();
+    for (int j = 0; j < rows; j++) {
+        unsigned int row = j * columns;
+        for (int i = 0; i < columns; i++) {
+            m_indices << row + i;
+        }
+        m_restartPoints << m_indices.size();
+        m_indices << restartIndex();
+    }
+#endif
+}
+
+/*!
+ * \brief SphereGenerator::equirectangular
+ * Texture coordinates of a unit direction, matching uvCoordNew().
+ * The seam meridian, alpha = 0, gives u = 1, or u = 0 if seamAtEnd is set.
+ */
+QVector2D SphereGenerator::equirectangular(const QVector3D &dir, bool seamAtEnd)
+{
+    double alpha = qAtan2(dir.z(), dir.x());
+    if (alpha < 0 || (alpha == 0 && seamAtEnd)) {
+        alpha += 2 * M_PI;
+    }
+    double beta = qAsin(qBound(-1.0f, dir.y(), 1.0f));
+    return QVector2D(1 - alpha / (2 * M_PI), 0.5 + beta / M_PI);
+}
+
+/*!
+ * \brief SphereGenerator::buildTriangleMesh
+ * Replace all outputs with a triangle list over unit directions.
+ * Triangles are grouped in patches starting at patchStarts, in units of
+ * triangle indices. Triangles crossing the texture seam are cut along it,
+ * seam vertices get one copy per side and pole vertices one per triangle,
+ * so texture coordinates never wrap and stay within [0, 1].
+ */
+void SphereGenerator::buildTriangleMesh(double radius, const QVector<QVector3D> &directions,
+                                        const QVector<unsigned int> &triangles,
+                                        const QVector<int> &patchStarts)
+{
+    clear();
+    m_radius = radius;
+    m_fillPrimitive = Triangles;
+    m_wirePrimitive = Lines;
+
+    const float eps = 1e-6f;
+    const float scale = m_layout == PackedInterleaved ? 1.0f : radius;
+
+    // snap what is on the seam meridian exactly onto it
+    QVector<QVector3D> dirs = directions;
+    for (QVector3D &d : dirs) {
+        if (qAbs(d.z()) < eps && d.x() > 0) {
+            d.setZ(0);
+        }
+    }
+    auto sideOf = [&dirs](unsigned int d) {
+        return dirs[d].z() > 0 ? 1 : (dirs[d].z() < 0 ? -1 : 0);
+    };
+    auto isPole = [&dirs, eps](unsigned int d) {
+        return qAbs(dirs[d].x()) < eps && qAbs(dirs[d].z()) < eps;
+    };
+
+    // where an edge crosses the seam, shared by both triangles of the edge
+    QHash<quint64, unsigned int> splits;
+    auto splitEdge = [&](unsigned int a, unsigned int b) -> unsigned int {
+        if (a > b) {
+            qSwap(a, b);
+        }
+        quint64 key = (quint64(a) << 32) | b;
+        auto it = splits.constFind(key);
+        if (it != splits.constEnd()) {
+            return it.value();
+        }
+        QVector3D pa = dirs[a];
+        QVector3D pb = dirs[b];
+        QVector3D p = pa + (pb - pa) * (pa.z() / (pa.z() - pb.z()));
+        p.setZ(0);
+        dirs << p.normalized();
+        splits.insert(key, dirs.size() - 1);
+        return dirs.size() - 1;
+    };
+
+    // output vertex of a direction, one per seam side
+    QHash<quint64, unsigned int> outputs;
+    auto vertexFor = [&](unsigned int d, bool seamAtEnd) -> unsigned int {
+        bool onSeam = dirs[d].z() == 0 && dirs[d].x() > 0;
+        quint64 key = (quint64(d) << 1) | (onSeam && seamAtEnd ? 1 : 0);
+        auto it = outputs.constFind(key);
+        if (it != outputs.constEnd()) {
+            return it.value();
+        }
+        addVertex(dirs[d] * radius, equirectangular(dirs[d], seamAtEnd));
+        outputs.insert(key, vertexCount() - 1);
+        return vertexCount() - 1;
+    };
+
+    // bounds of the current patch
+    QVector3D boxMin, boxMax, axisSum;
+    QVector<unsigned int> patchDirs;
+    float minEdgeCos = 1;
+
+    auto addTriangle = [&](unsigned int a, unsigned int b, unsigned int c, bool seamAtEnd) {
+        const unsigned int corners[3] = { a, b, c };
+        unsigned int out[3];
+        for (int k = 0; k < 3; k++) {
+            if (!isPole(corners[k])) {
+                out[k] = vertexFor(corners[k], seamAtEnd);
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            if (isPole(corners[k])) {
+                // u is undefined at a pole, take the middle of the opposite edge
+                QVector2D uv = equirectangular(dirs[corners[k]], seamAtEnd);
+                float u = 0;
+                int others = 0;
+                for (int o = 0; o < 3; o++) {
+                    if (o != k && !isPole(corners[o])) {
+                        u += equirectangular(dirs[corners[o]], seamAtEnd).x();
+                        others++;
+                    }
+                }
+                uv.setX(others ? u / others : uv.x());
+                addVertex(dirs[corners[k]] * radius, uv);
+                out[k] = vertexCount() - 1;
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            const QVector3D &d = dirs[corners[k]];
+            boxMin = QVector3D(qMin(boxMin.x(), d.x()), qMin(boxMin.y(), d.y()),
+                               qMin(boxMin.z(), d.z()));
+            boxMax = QVector3D(qMax(boxMax.x(), d.x()), qMax(boxMax.y(), d.y()),
+                               qMax(boxMax.z(), d.z()));
+            axisSum += d;
+            patchDirs << corners[k];
+            minEdgeCos = qMin(minEdgeCos,
+                              QVector3D::dotProduct(d, dirs[corners[(k + 1) % 3]]));
+            m_indices << out[k];
+        }
+    };
+
+    for (int p = 0; p < patchStarts.size(); p++) {
+        int end = p + 1 < patchStarts.size() ? patchStarts[p + 1] : triangles.size();
+        boxMin = QVector3D(1, 1, 1);
+        boxMax = QVector3D(-1, -1, -1);
+        axisSum = QVector3D();
+        patchDirs.clear();
+        minEdgeCos = 1;
+
+        Patch patch;
+        patch.firstIndex = m_indices.size();
+        for (int t = patchStarts[p]; t + 2 < end; t += 3) {
+            const unsigned int c[3] = { triangles[t], triangles[t + 1], triangles[t + 2] };
+            const int side[3] = { sideOf(c[0]), sideOf(c[1]), sideOf(c[2]) };
+            bool pos = side[0] > 0 || side[1] > 0 || side[2] > 0;
+            bool neg = side[0] < 0 || side[1] < 0 || side[2] < 0;
+            QVector3D centroid = dirs[c[0]] + dirs[c[1]] + dirs[c[2]];
+            if (!(pos && neg && centroid.x() > 0)) {
+                addTriangle(c[0], c[1], c[2], neg);
+                continue;
+            }
+            // cut along the seam, keeping the winding
+            for (int r = 0; r < 3; r++) {
+                unsigned int i = c[r], j = c[(r + 1) % 3], k = c[(r + 2) % 3];
+                int si = side[r], sj = side[(r + 1) % 3], sk = side[(r + 2) % 3];
+                if (si == 0 && sj == -sk) {
+                    unsigned int m = splitEdge(j, k);
+                    addTriangle(i, j, m, sj < 0);
+                    addTriangle(i, m, k, sk < 0);
+                    break;
+                }
+                if (si != 0 && sj == -si && sk == -si) {
+                    unsigned int mij = splitEdge(i, j);
+                    unsigned int mik = splitEdge(i, k);
+                    addTriangle(i, mij, mik, si < 0);
+                    addTriangle(mij, j, k, sj < 0);
+                    addTriangle(mij, k, mik, sj < 0);
+                    break;
+                }
+            }
+        }
+        if (m_indices.size() == patch.firstIndex) {
+            continue;
+        }
+        m_restartPoints << m_indices.size();
+        m_indices << restartIndex();
+        patch.indexCount = m_indices.size() - patch.firstIndex;
+
+        patch.axis = axisSum.normalized();
+        float minCos = 1;
+        for (unsigned int d : patchDirs) {
+            minCos = qMin(minCos, QVector3D::dotProduct(dirs[d], patch.axis));
+        }
+        const QVector3D pad(1e-4f, 1e-4f, 1e-4f);
+        patch.boxMin = (boxMin - pad) * scale;
+        patch.boxMax = (boxMax + pad) * scale;
+        // a face normal may lean one edge further than its corners
+        patch.coneAngle = qAcos(qBound(-1.0f, minCos, 1.0f))
+                          + qAcos(qBound(-1.0f, minEdgeCos, 1.0f));
+        m_patches << patch;
+    }
+    m_patchIndices = m_indices;
+
+#if defined(Q_OS_ANDROID) || defined(TEST_ANDROID_LOCAL)
+    // wireframe: every edge once, as lines
+    m_maxRestartPointsForNonWireframe = m_restartPoints.size();
+    QSet<quint64> edges;
+    for (const Patch &patch : m_patches) {
+        // each patch is whole triangles and one restart index
+        const unsigned int *tri = m_patchIndices.constData() + patch.firstIndex;
+        for (int t = 0; t + 2 < patch.indexCount; t += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = tri[t + k];
+                unsigned int b = tri[t + (k + 1) % 3];
+                quint64 key = (quint64(qMin(a, b)) << 32) | qMax(a, b);
+                if (!edges.contains(key)) {
+                    edges.insert(key);
+                    m_indices << a << b;
+                }
+            }
+        }
+    }
+#endif
+}
+
@@ -5,10 +5,95 @@
 #include <QVector2D>
 #include <QVector3D>
 
+/*!
+ * \brief The SphereGenerator class
+ * Builds the latitude/longitude sphere. Subclasses tessellate the sphere
+ * differently but fill the same outputs, see create().
+ */
 class SphereGenerator
 {
 public:
-    void generate(double radius, int resolution);
+    enum Shape {
+        // latitude/longitude grid, texture aligned
+        UvSphere,
+        // subdivided icosahedron
+        Icosphere,
+        // cube projected onto the sphere, with an equi-angular warp
+        CubeSphere,
+    };
+
+    // how indices() is to be drawn
+    enum Primitive {
+        TriangleStrips,
+        Triangles,
+        LineStrips,
+        Lines,
+    };
+
+    enum Topology {
+        // every latitude band owns its own pair of vertex rows
+        SeparateStrips,
+        // each grid vertex is emitted once and shared by adjacent bands
+        SharedGrid,
+    };
+
+    enum VertexLayout {
+        // separate float streams: vertices(), normals() and texcoords()
+        FloatStreams,
+        // interleaved PackedVertex records in packedVertices()
+        PackedInterleaved,
+    };
+
+    /*
+     * 12 bytes instead of the 32 of the float streams.
+     * position is the unit-sphere direction in normalized shorts with w = 1,
+     * so scale by radius() in the model transform. It doubles as the normal.
+     * texcoord is in normalized unsigned shorts.
+     */
+    struct PackedVertex
+    {
+        qint16 position[4];
+        quint16 texcoord[2];
+    };
+
+    /*
+     * A block of grid cells drawn together, so it can be culled as a whole.
+     * Bounds are in the units of the vertex data: unit sized when packed.
+     */
+    struct Patch
+    {
+        int firstIndex;
+        int indexCount;
+        QVector3D boxMin;
+        QVector3D boxMax;
+        // every normal in the patch is within coneAngle of axis
+        QVector3D axis;
+        float coneAngle;
+    };
+
+    SphereGenerator();
+    virtual ~SphereGenerator();
+
+    static SphereGenerator *create(Shape shape);
+    virtual Shape shape() const { return UvSphere; }
+    // the triangles of a UV sphere of that resolution, which other shapes aim at
+    static int triangleBudget(int resolution) { return 4 * resolution * resolution; }
+
+    // the filled part of indices(), up to the last of restartPoints(), and the rest
+    Primitive fillPrimitive() const { return m_fillPrimitive; }
+    Primitive wirePrimitive() const { return m_wirePrimitive; }
+
+    // topology only applies to the UV sphere
+    Topology topology() const { return m_topology; }
+    void setTopology(Topology topology) { m_topology = topology; }
+
+    VertexLayout vertexLayout() const { return m_layout; }
+    void setVertexLayout(VertexLayout layout) { m_layout = layout; }
+
+    double radius() const { return m_radius; }
+
+    virtual void generate(double radius, int resolution);
+    void generateReference(double radius, int resolution);
 
     const QVector<QVector3D> &vertices() const { return m_vertices; }
     int vertexDataLength() const { return m_vertices.size() * sizeof(QVector3D); }
@@ -19,11 +104,20 @@ public:
     const QVector<QVector2D> &texcoords() const { return m_texcoords; }
     int texcoordDataLength() const { return m_texcoords.size() * sizeof(QVector2D); }
 
+    const QVector<PackedVertex> &packedVertices() const { return m_packed; }
+    int packedDataLength() const { return m_packed.size() * sizeof(PackedVertex); }
+
+    int vertexCount() const;
+
     const QVector<unsigned int> &indices() const { return m_indices; }
     int indexDataLength() const { return m_indices.size() * sizeof(unsigned int); }
 
     QVector<int> restartPoints(bool drawWireframe = false) const;
 
+    // the filled strips again, ordered patch by patch
+    const QVector<Patch> &patches() const { return m_patches; }
+    const QVector<unsigned int> &patchIndices() const { return m_patchIndices; }
+
     unsigned int restartIndex() const { return 0xFFFFFFFF; }
 
 protected:
@@ -31,12 +125,31 @@ protected:
     QVector2D uvCoord(QVector3D xyz, double radius = 1.0);
     QVector2D uvCoordNew(int i, int j, int resolution);
 
+    void clear();
+    void addVertex(const QVector3D &p, const QVector2D &uv);
+    void generateSeparateStrips(double radius, int resolution);
+    void generateSharedGrid(double radius, int resolution);
+    void buildPatches(double radius, int resolution);
+
+    static QVector2D equirectangular(const QVector3D &dir, bool seamAtEnd);
+    void buildTriangleMesh(double radius, const QVector<QVector3D> &directions,
+                           const QVector<unsigned int> &triangles,
+                           const QVector<int> &patchStarts);
+
 private:
+    Topology m_topology;
+    VertexLayout m_layout;
+    double m_radius;
+    Primitive m_fillPrimitive;
+    Primitive m_wirePrimitive;
     QVector<QVector3D> m_vertices;
     QVector<QVector3D> m_normals;
     QVector<QVector2D> m_texcoords;
+    QVector<PackedVertex> m_packed;
     QVector<unsigned int> m_indices;
     QVector<int> m_restartPoints;
+    QVector<Patch> m_patches;
+    QVector<unsigned int> m_patchIndices;
 #if defined(Q_OS_ANDROID) || defined(TEST_ANDROID_LOCAL)
     int m_maxRestartPointsForNonWireframe;
 #endif
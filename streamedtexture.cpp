@@ -0,0 +1,153 @@
+#include <QOpenGLContext>
+#include "streamedtexture.h"
+
+// longest edge of the preview shown while the full image streams in
+static const int PreviewSize = 256;
+
+StreamedTexture::StreamedTexture(const QFuture<QImage> &image, const QSize &size,
+                                 QOpenGLTexture::TextureFormat format)
+    : m_image(image)
+    , m_size(size)
+    , m_format(format)
+    , m_pbo(QOpenGLBuffer::PixelUnpackBuffer)
+    , m_uploadedRows(0)
+{
+    initializeOpenGLFunctions();
+
+    auto ctx = QOpenGLContext::currentContext();
+    auto version = ctx->format().version();
+    if (ctx->isOpenGLES()) {
+        // ES 2 has neither sized internal formats nor pixel buffers
+        if (version < qMakePair(3, 0)) {
+            m_format = QOpenGLTexture::RGBAFormat;
+        } else {
+            m_pbo.create();
+        }
+    } else if (version >= qMakePair(2, 1)) {
+        m_pbo.create();
+    }
+    if (m_pbo.isCreated()) {
+        m_pbo.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    }
+
+    // deep ocean blue, the bulk of the globe
+    QImage placeholder(1, 1, QImage::Format_RGBA8888);
+    placeholder.fill(QColor(17, 40, 82));
+    m_placeholder.reset(new QOpenGLTexture(placeholder, QOpenGLTexture::DontGenerateMipMaps));
+}
+
+StreamedTexture::StreamedTexture(QOpenGLTexture *texture)
+    : m_size(texture->width(), texture->height())
+    , m_format(texture->format())
+    , m_full(texture)
+    , m_uploadedRows(-1)
+{
+    initializeOpenGLFunctions();
+}
+
+StreamedTexture::~StreamedTexture()
+{
+}
+
+QOpenGLTexture *StreamedTexture::current() const
+{
+    if (isComplete()) {
+        return m_full.data();
+    }
+    return m_preview ? m_preview.data() : m_placeholder.data();
+}
+
+void StreamedTexture::bind()
+{
+    current()->bind();
+}
+
+void StreamedTexture::release()
+{
+    current()->release();
+}
+
+bool StreamedTexture::advance()
+{
+    // complete, or the image could not be decoded
+    if (m_uploadedRows < 0) {
+        return false;
+    }
+    // nothing to do until the decode finishes, the caller watches for that
+    if (!m_image.isFinished()) {
+        return false;
+    }
+
+    QImage image = m_image.result();
+    if (image.isNull()) {
+        // keep the placeholder
+        m_uploadedRows = -1;
+        return false;
+    }
+    if (!m_preview) {
+        createPreview(image);
+        // show the preview for a frame before the first slice
+        return true;
+    }
+    uploadSlice(image);
+    return !isComplete();
+}
+
+void StreamedTexture::createPreview(const QImage &image)
+{
+    QImage preview = image.scaled(PreviewSize, PreviewSize, Qt::KeepAspectRatio,
+                                  Qt::FastTransformation);
+    m_preview.reset(new QOpenGLTexture(preview));
+    m_preview->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear, QOpenGLTexture::Linear);
+}
+
+/*!
+ * \brief StreamedTexture::uploadSlice
+ * Upload the next BytesPerFrame worth of whole rows. With a pixel buffer
+ * the copy out of the image is all that happens here and the driver moves
+ * the data when it suits it.
+ */
+void StreamedTexture::uploadSlice(const QImage &image)
+{
+    if (!m_full) {
+        m_full.reset(new QOpenGLTexture(QOpenGLTexture::Target2D));
+        m_full->setFormat(m_format);
+        m_full->setSize(image.width(), image.height());
+        m_full->setMipLevels(m_full->maximumMipLevels());
+        m_full->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+        m_full->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,
+                                 QOpenGLTexture::Linear);
+        m_size = image.size();
+    }
+
+    const int rowBytes = image.bytesPerLine();
+    const int rows = qMin(qMax(1, BytesPerFrame / rowBytes),
+                          image.height() - m_uploadedRows);
+    const uchar *data = image.constScanLine(m_uploadedRows);
+
+    m_full->bind();
+    if (m_pbo.isCreated()) {
+        m_pbo.bind();
+        // orphan the last slice, the driver may still be reading it
+        m_pbo.allocate(rows * rowBytes);
+        m_pbo.write(0, data, rows * rowBytes);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_uploadedRows, image.width(), rows,
+                        GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        m_pbo.release();
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_uploadedRows, image.width(), rows,
+                        GL_RGBA, GL_UNSIGNED_BYTE, data);
+    }
+    m_full->release();
+    m_uploadedRows += rows;
+
+    if (m_uploadedRows == image.height()) {
+        m_full->generateMipMaps();
+        // the decoded image and the preview are no longer needed
+        m_image = QFuture<QImage>();
+        m_preview.reset();
+        m_placeholder.reset();
+        m_pbo.destroy();
+        m_uploadedRows = -1;
+    }
+}
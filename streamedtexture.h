@@ -0,0 +1,62 @@
+#ifndef STREAMEDTEXTURE_H
+#define STREAMEDTEXTURE_H
+
+#include <QFuture>
+#include <QImage>
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QOpenGLTexture>
+#include <QScopedPointer>
+#include <QSize>
+
+/*!
+ * \brief The StreamedTexture class
+ * A texture whose image is decoded off the render thread and uploaded a
+ * few rows per frame, through a pixel unpack buffer where there is one.
+ * Until then it binds a one texel placeholder, and once decoded a small
+ * preview, so the first frames never wait for the image.
+ */
+class StreamedTexture : protected QOpenGLFunctions
+{
+public:
+    // upload budget per advance()
+    static const int BytesPerFrame = 2 << 20;
+
+    // needs a current context
+    StreamedTexture(const QFuture<QImage> &image, const QSize &size,
+                    QOpenGLTexture::TextureFormat format);
+    // takes over a texture that is already complete
+    explicit StreamedTexture(QOpenGLTexture *texture);
+    ~StreamedTexture();
+
+    // the decode job, watch it to know when advance() has work again
+    QFuture<QImage> decoded() const { return m_image; }
+    bool isComplete() const { return !m_full.isNull() && m_uploadedRows < 0; }
+    // size of the full image, known before it is decoded
+    QSize size() const { return m_size; }
+
+    // upload the next slice; returns true while more frames are needed
+    bool advance();
+
+    void bind();
+    void release();
+
+protected:
+    QOpenGLTexture *current() const;
+    void createPreview(const QImage &image);
+    void uploadSlice(const QImage &image);
+
+private:
+    QFuture<QImage> m_image;
+    QSize m_size;
+    QOpenGLTexture::TextureFormat m_format;
+
+    QScopedPointer<QOpenGLTexture> m_placeholder;
+    QScopedPointer<QOpenGLTexture> m_preview;
+    QScopedPointer<QOpenGLTexture> m_full;
+    QOpenGLBuffer m_pbo;
+    // rows of m_full filled so far, -1 once it is complete
+    int m_uploadedRows;
+};
+
+#endif // STREAMEDTEXTURE_H
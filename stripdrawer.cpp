@@ -0,0 +1,278 @@
+#include <QOpenGLContext>
+#include "stripdrawer.h"
+
+#ifndef GL_PRIMITIVE_RESTART
+#define GL_PRIMITIVE_RESTART 0x8F9D
+#endif
+#ifndef GL_PRIMITIVE_RESTART_FIXED_INDEX
+#define GL_PRIMITIVE_RESTART_FIXED_INDEX 0x8D69
+#endif
+
+StripDrawer::StripDrawer()
+    : m_initialized(false), m_isES(false)
+    , m_multiDrawElements(nullptr), m_primitiveRestartIndex(nullptr)
+    , m_ebo(QOpenGLBuffer::IndexBuffer)
+    , m_method(Stitched), m_mode(GL_TRIANGLE_STRIP), m_restartIndex(0xFFFFFFFF)
+    , m_count(0)
+{
+}
+
+/*!
+ * \brief StripDrawer::preferredMethod
+ * \return the best submission method for the current context
+ */
+StripDrawer::Method StripDrawer::preferredMethod()
+{
+    auto ctx = QOpenGLContext::currentContext();
+    auto version = ctx->format().version();
+    if (ctx->isOpenGLES()) {
+        if (version >= qMakePair(3, 0)) {
+            return PrimitiveRestart;
+        }
+        if (ctx->hasExtension(QByteArrayLiteral("GL_EXT_multi_draw_arrays"))) {
+            return MultiDraw;
+        }
+        return Stitched;
+    }
+    // glMultiDrawElements is core since 1.4
+    return version >= qMakePair(3, 1) ? PrimitiveRestart : MultiDraw;
+}
+
+void StripDrawer::resolveFunctions()
+{
+    if (m_initialized) {
+        return;
+    }
+    initializeOpenGLFunctions();
+
+    auto ctx = QOpenGLContext::currentContext();
+    m_isES = ctx->isOpenGLES();
+    if (m_isES) {
+        if (ctx->hasExtension(QByteArrayLiteral("GL_EXT_multi_draw_arrays"))) {
+            m_multiDrawElements = reinterpret_cast<MultiDrawElements>(
+                                      ctx->getProcAddress("glMultiDrawElementsEXT"));
+        }
+    } else {
+        m_multiDrawElements = reinterpret_cast<MultiDrawElements>(
+                                  ctx->getProcAddress("glMultiDrawElements"));
+        m_primitiveRestartIndex = reinterpret_cast<PrimitiveRestartIndex>(
+                                      ctx->getProcAddress("glPrimitiveRestartIndex"));
+    }
+    m_initialized = true;
+}
+
+void StripDrawer::setStrips(GLenum mode, const GLuint *indices, int count,
+                            GLuint restartIndex, const QVector<int> &groups)
+{
+    resolveFunctions();
+
+    m_mode = mode;
+    m_restartIndex = restartIndex;
+    m_counts.clear();
+    m_offsets.clear();
+    m_groupFirst.clear();
+    m_groupStrip.clear();
+
+    m_method = preferredMethod();
+    // ES 3.0 only knows the fixed restart index
+    if (m_method == PrimitiveRestart
+        && (m_isES ? restartIndex != 0xFFFFFFFF : !m_primitiveRestartIndex)) {
+        m_method = MultiDraw;
+    }
+    if (m_method == MultiDraw && !m_multiDrawElements) {
+        m_method = Stitched;
+    }
+
+    if (!m_ebo.isCreated()) { m_ebo.create(); }
+    m_ebo.bind();
+    m_ebo.setUsagePattern(QOpenGLBuffer::StaticDraw);
+
+    if (m_method == Stitched) {
+        QVector<GLuint> stitched;
+        buildStitched(indices, count, groups, stitched);
+        if (m_mode == GL_LINE_STRIP) {
+            m_mode = GL_LINES;
+        }
+        m_ebo.allocate(stitched.constData(), stitched.size() * sizeof(GLuint));
+        m_count = stitched.size();
+        if (!groups.isEmpty()) {
+            while (m_groupFirst.size() <= groups.size()) {
+                m_groupFirst << m_count;
+            }
+        }
+        return;
+    }
+
+    m_ebo.allocate(indices, count * sizeof(GLuint));
+    m_count = count;
+    if (!groups.isEmpty()) {
+        m_groupFirst = groups;
+        m_groupFirst << count;
+    }
+    if (m_method == MultiDraw) {
+        int begin = 0;
+        int g = 0;
+        for (int k = 0; k <= count; k++) {
+            if (k < count && indices[k] != restartIndex) {
+                continue;
+            }
+            if (k > begin) {
+                for (; g < groups.size() && groups[g] <= begin; g++) {
+                    m_groupStrip << m_counts.size();
+                }
+                m_counts << k - begin;
+                m_offsets << reinterpret_cast<const GLvoid *>(begin * sizeof(GLuint));
+            }
+            begin = k + 1;
+        }
+        if (!groups.isEmpty()) {
+            while (m_groupStrip.size() <= groups.size()) {
+                m_groupStrip << m_counts.size();
+            }
+        }
+    }
+}
+
+/*!
+ * \brief StripDrawer::buildStitched
+ * Join triangle strips with degenerate triangles, keeping the first vertex
+ * of every strip on an even position so the winding is preserved.
+ * Line strips can not be joined that way and become line pairs instead.
+ */
+void StripDrawer::buildStitched(const GLuint *indices, int count,
+                                const QVector<int> &groups, QVector<GLuint> &out)
+{
+    out.reserve(count * (m_mode == GL_LINE_STRIP ? 2 : 1) + 64);
+
+    int begin = 0;
+    int g = 0;
+    for (int k = 0; k <= count; k++) {
+        if (k < count && indices[k] != m_restartIndex) {
+            continue;
+        }
+        const GLuint *strip = indices + begin;
+        int first = begin;
+        int len = k - begin;
+        begin = k + 1;
+        if (len == 0) {
+            continue;
+        }
+
+        if (m_mode == GL_LINE_STRIP) {
+            for (; g < groups.size() && groups[g] <= first; g++) {
+                m_groupFirst << out.size();
+            }
+            for (int n = 0; n + 1 < len; n++) {
+                out << strip[n] << strip[n + 1];
+            }
+            continue;
+        }
+        if (m_mode == GL_TRIANGLE_STRIP && !out.isEmpty()) {
+            GLuint last = out.last();
+            out << last << strip[0];
+            if (out.size() % 2) {
+                out << strip[0];
+            }
+        }
+        // a group starts on its first real vertex, which is on an even position
+        for (; g < groups.size() && groups[g] <= first; g++) {
+            m_groupFirst << out.size();
+        }
+        for (int n = 0; n < len; n++) {
+            out << strip[n];
+        }
+    }
+}
+
+void StripDrawer::draw()
+{
+    if (m_count == 0) {
+        return;
+    }
+
+    beginDraw();
+    if (m_method == MultiDraw) {
+        m_multiDrawElements(m_mode, m_counts.constData(), GL_UNSIGNED_INT,
+                            m_offsets.constData(), m_counts.size());
+    } else {
+        glDrawElements(m_mode, m_count, GL_UNSIGNED_INT, nullptr);
+    }
+    endDraw();
+}
+
+void StripDrawer::drawGroups(const QVector<bool> &visible)
+{
+    if (m_count == 0 || m_groupFirst.isEmpty()) {
+        draw();
+        return;
+    }
+
+    const int groups = qMin(groupCount(), visible.size());
+    beginDraw();
+    if (m_method == MultiDraw) {
+        // every visible strip, still in one call
+        m_drawCounts.clear();
+        m_drawOffsets.clear();
+        for (int g = 0; g < groups; g++) {
+            if (!visible[g]) {
+                continue;
+            }
+            for (int s = m_groupStrip[g]; s < m_groupStrip[g + 1]; s++) {
+                m_drawCounts << m_counts[s];
+                m_drawOffsets << m_offsets[s];
+            }
+        }
+        if (!m_drawCounts.isEmpty()) {
+            m_multiDrawElements(m_mode, m_drawCounts.constData(), GL_UNSIGNED_INT,
+                                m_drawOffsets.constData(), m_drawCounts.size());
+        }
+    } else {
+        // stitched joins between groups are degenerate, so runs of groups
+        // can be drawn as one range
+        for (int g = 0; g < groups; g++) {
+            if (!visible[g]) {
+                continue;
+            }
+            int end = g;
+            while (end + 1 < groups && visible[end + 1]) {
+                end++;
+            }
+            int first = m_groupFirst[g];
+            glDrawElements(m_mode, m_groupFirst[end + 1] - first, GL_UNSIGNED_INT,
+                           reinterpret_cast<const GLvoid *>(first * sizeof(GLuint)));
+            g = end;
+        }
+    }
+    endDraw();
+}
+
+void StripDrawer::beginDraw()
+{
+    m_ebo.bind();
+    if (m_method != PrimitiveRestart) {
+        return;
+    }
+    if (m_isES) {
+        glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    } else {
+        glEnable(GL_PRIMITIVE_RESTART);
+        m_primitiveRestartIndex(m_restartIndex);
+    }
+}
+
+void StripDrawer::endDraw()
+{
+    if (m_method == PrimitiveRestart) {
+        glDisable(m_isES ? GL_PRIMITIVE_RESTART_FIXED_INDEX : GL_PRIMITIVE_RESTART);
+    }
+}
+
+void StripDrawer::destroy()
+{
+    m_ebo.destroy();
+    m_count = 0;
+    m_counts.clear();
+    m_offsets.clear();
+    m_groupFirst.clear();
+    m_groupStrip.clear();
+}
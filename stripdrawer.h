@@ -0,0 +1,77 @@
+#ifndef STRIPDRAWER_H
+#define STRIPDRAWER_H
+
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QVector>
+
+/*!
+ * \brief The StripDrawer class
+ * Owns the index buffer of a set of strips separated by a restart index
+ * and submits all of them with one call, using the best mechanism the
+ * current context offers.
+ */
+class StripDrawer : protected QOpenGLFunctions
+{
+public:
+    enum Method {
+        // GL 3.1+ / ES 3.0 primitive restart over the original indices
+        PrimitiveRestart,
+        // glMultiDrawElements with one range per strip
+        MultiDraw,
+        // strips joined with degenerate triangles, line strips turned into lines
+        Stitched,
+    };
+
+    StripDrawer();
+
+    static Method preferredMethod();
+    Method method() const { return m_method; }
+
+    // groups holds the first index of each group, which must start a strip
+    void setStrips(GLenum mode, const GLuint *indices, int count,
+                   GLuint restartIndex = 0xFFFFFFFF,
+                   const QVector<int> &groups = QVector<int>());
+    void draw();
+    // draw only the groups flagged in visible, adjacent ones in one range
+    void drawGroups(const QVector<bool> &visible);
+    void destroy();
+
+    int indexCount() const { return m_count; }
+    int groupCount() const { return qMax(0, m_groupFirst.size() - 1); }
+
+protected:
+    void resolveFunctions();
+    void buildStitched(const GLuint *indices, int count, const QVector<int> &groups,
+                       QVector<GLuint> &out);
+    void beginDraw();
+    void endDraw();
+
+private:
+    typedef void (QOPENGLF_APIENTRYP MultiDrawElements)(GLenum mode, const GLsizei *count,
+                                                        GLenum type,
+                                                        const GLvoid *const *indices,
+                                                        GLsizei drawcount);
+    typedef void (QOPENGLF_APIENTRYP PrimitiveRestartIndex)(GLuint index);
+
+    bool m_initialized;
+    bool m_isES;
+    MultiDrawElements m_multiDrawElements;
+    PrimitiveRestartIndex m_primitiveRestartIndex;
+
+    QOpenGLBuffer m_ebo;
+    Method m_method;
+    GLenum m_mode;
+    GLuint m_restartIndex;
+    GLsizei m_count;
+    QVector<GLsizei> m_counts;
+    QVector<const GLvoid *> m_offsets;
+    // per group: first uploaded index and, for MultiDraw, first strip;
+    // both end with a sentinel
+    QVector<int> m_groupFirst;
+    QVector<int> m_groupStrip;
+    QVector<GLsizei> m_drawCounts;
+    QVector<const GLvoid *> m_drawOffsets;
+};
+
+#endif // STRIPDRAWER_H
@@ -0,0 +1,213 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureInterface>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QtConcurrent>
+#include "ktxfile.h"
+#include "texturecache.h"
+
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+bool operator==(const TextureKey &a, const TextureKey &b)
+{
+    return a.path == b.path && a.format == b.format;
+}
+
+uint qHash(const TextureKey &key, uint seed)
+{
+    return qHash(key.path, seed) ^ qHash(int(key.format), seed);
+}
+
+TextureCache *TextureCache::instance()
+{
+    static TextureCache cache;
+    return &cache;
+}
+
+QSharedPointer<StreamedTexture> TextureCache::texture(const QString &path,
+                                                      QOpenGLTexture::TextureFormat format)
+{
+    TextureKey key = { path, format };
+    GroupKey groupKey(QOpenGLContextGroup::currentContextGroup(), key);
+    {
+        QMutexLocker locker(&m_mutex);
+        auto cached = m_textures.value(groupKey).toStrongRef();
+        if (cached) {
+            return cached;
+        }
+    }
+
+    // block compressed files need no decoding and are uploaded right away
+    QSharedPointer<StreamedTexture> texture;
+    QOpenGLTexture *compressed = uploadCompressed(path);
+    if (compressed) {
+        texture.reset(new StreamedTexture(compressed));
+    } else {
+        texture.reset(new StreamedTexture(requestImage(path), QImageReader(path).size(),
+                                          format));
+    }
+
+    QMutexLocker locker(&m_mutex);
+    // drop entries whose last user is gone, and images nothing refers to
+    for (auto it = m_textures.begin(); it != m_textures.end();) {
+        if (it.value().isNull()) {
+            it = m_textures.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_textures.insert(groupKey, texture);
+    for (auto it = m_images.begin(); it != m_images.end();) {
+        bool used = false;
+        for (auto t = m_textures.constBegin(); t != m_textures.constEnd() && !used; ++t) {
+            used = t.key().second.path == it.key();
+        }
+        if (used) {
+            ++it;
+        } else {
+            it = m_images.erase(it);
+        }
+    }
+    return texture;
+}
+
+static QFuture<QImage> readyFuture(const QImage &image)
+{
+    QFutureInterface<QImage> fi;
+    fi.reportStarted();
+    fi.reportResult(image);
+    fi.reportFinished();
+    return fi.future();
+}
+
+QFuture<QImage> TextureCache::requestImage(const QString &path)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_images.contains(path)) {
+        return readyFuture(m_images.value(path));
+    }
+    if (m_pending.contains(path)) {
+        return m_pending.value(path);
+    }
+    auto future = QtConcurrent::run(this, &TextureCache::decode, path);
+    m_pending.insert(path, future);
+    return future;
+}
+
+/*!
+ * \brief TextureCache::decode
+ * Runs on the thread pool. The result is already in the layout
+ * glTexImage2D wants and is kept for uploads to other share groups.
+ */
+QImage TextureCache::decode(const QString &path)
+{
+    QImage decoded = QImage(path).convertToFormat(QImage::Format_RGBA8888);
+    if (decoded.isNull()) {
+        qWarning("TextureCache: can not load %s", qPrintable(path));
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_images.insert(path, decoded);
+    m_pending.remove(path);
+    return decoded;
+}
+
+/*!
+ * \brief TextureCache::compressedFormat
+ * \return the format to upload blocks of fileFormat with in the current
+ * context, or 0 if it can not sample them
+ */
+quint32 TextureCache::compressedFormat(quint32 fileFormat)
+{
+    auto ctx = QOpenGLContext::currentContext();
+    auto version = ctx->format().version();
+    bool etc2 = ctx->isOpenGLES() ? version >= qMakePair(3, 0)
+                : version >= qMakePair(4, 3)
+                || ctx->hasExtension(QByteArrayLiteral("GL_ARB_ES3_compatibility"));
+    switch (fileFormat) {
+    case KtxFile::RGB_DXT1:
+        if (ctx->hasExtension(QByteArrayLiteral("GL_EXT_texture_compression_s3tc"))
+            || ctx->hasExtension(QByteArrayLiteral("GL_EXT_texture_compression_dxt1"))) {
+            return fileFormat;
+        }
+        return 0;
+    case KtxFile::ETC1_RGB8:
+        if (ctx->hasExtension(QByteArrayLiteral("GL_OES_compressed_ETC1_RGB8_texture"))) {
+            return fileFormat;
+        }
+        // every ETC1 block is a valid ETC2 block
+        return etc2 ? KtxFile::RGB8_ETC2 : 0;
+    case KtxFile::RGB8_ETC2:
+        return etc2 ? fileFormat : 0;
+    default:
+        return 0;
+    }
+}
+
+/*!
+ * \brief TextureCache::uploadCompressed
+ * Look for block compressed versions of the image made by tools/texconv,
+ * next to it and named like foo.bc1.ktx for foo.png, and upload the first
+ * one the context can sample.
+ * \return nullptr if there is none
+ */
+QOpenGLTexture *TextureCache::uploadCompressed(const QString &path)
+{
+    static const char *const suffixes[] = { "bc1", "etc2", "etc1" };
+
+    QFileInfo info(path);
+    QString base = info.path() + QLatin1Char('/') + info.completeBaseName();
+    KtxFile ktx;
+    quint32 format = 0;
+    for (const char *suffix : suffixes) {
+        QString fileName = base + QLatin1Char('.') + QLatin1String(suffix) + ".ktx";
+        if (!QFile::exists(fileName)) {
+            continue;
+        }
+        if (ktx.load(fileName) && ktx.isCompressed() && ktx.levelCount() > 0) {
+            format = compressedFormat(ktx.internalFormat());
+            if (format) {
+                break;
+            }
+        }
+    }
+    if (!format) {
+        return nullptr;
+    }
+
+    auto ctx = QOpenGLContext::currentContext();
+    auto f = ctx->functions();
+    auto texture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+    texture->setFormat(QOpenGLTexture::TextureFormat(format));
+    texture->setSize(ktx.width(), ktx.height());
+    texture->create();
+    texture->bind();
+    // the levels are stored as they are, no storage to allocate first
+    for (int i = 0; i < ktx.levelCount(); i++) {
+        const QByteArray &level = ktx.level(i);
+        f->glCompressedTexImage2D(GL_TEXTURE_2D, i, format,
+                                  qMax(1, ktx.width() >> i), qMax(1, ktx.height() >> i), 0,
+                                  level.size(), level.constData());
+    }
+    int fullChain = 1;
+    for (int size = qMax(ktx.width(), ktx.height()); size > 1; size >>= 1) {
+        fullChain++;
+    }
+    if (ktx.levelCount() >= fullChain) {
+        texture->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,
+                                  QOpenGLTexture::Linear);
+    } else if (ctx->isOpenGLES() && ctx->format().majorVersion() < 3) {
+        texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    } else {
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ktx.levelCount() - 1);
+        texture->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,
+                                  QOpenGLTexture::Linear);
+    }
+    texture->release();
+    return texture;
+}
@@ -0,0 +1,61 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <QFuture>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QOpenGLTexture>
+#include <QPair>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include "streamedtexture.h"
+
+class QOpenGLContextGroup;
+
+struct TextureKey
+{
+    QString path;
+    QOpenGLTexture::TextureFormat format;
+};
+
+bool operator==(const TextureKey &a, const TextureKey &b);
+uint qHash(const TextureKey &key, uint seed = 0);
+
+/*!
+ * \brief The TextureCache class
+ * Process wide, reference counted cache of image textures. Each asset is
+ * decoded once, on the global thread pool, and streamed to the GPU once per
+ * context share group and format.
+ * Images are uploaded as decoded, top row first, so shaders sample them
+ * with v flipped instead of keeping a mirrored copy around. Precompressed
+ * KTX versions of an image are used instead when the context supports them.
+ */
+class TextureCache
+{
+public:
+    static TextureCache *instance();
+
+    // needs a current context; returns at once, the texture fills in later
+    QSharedPointer<StreamedTexture> texture(const QString &path,
+                                            QOpenGLTexture::TextureFormat format
+                                            = QOpenGLTexture::RGBA8_UNorm);
+    // decoded as Format_RGBA8888; concurrent requests share one job
+    QFuture<QImage> requestImage(const QString &path);
+
+protected:
+    QImage decode(const QString &path);
+    QOpenGLTexture *uploadCompressed(const QString &path);
+    static quint32 compressedFormat(quint32 fileFormat);
+
+private:
+    typedef QPair<QOpenGLContextGroup *, TextureKey> GroupKey;
+
+    QMutex m_mutex;
+    // decoded images stay while a texture made from them is alive
+    QHash<QString, QImage> m_images;
+    QHash<QString, QFuture<QImage>> m_pending;
+    QHash<GroupKey, QWeakPointer<StreamedTexture>> m_textures;
+};
+
+#endif // TEXTURECACHE_H
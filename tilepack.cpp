@@ -0,0 +1,238 @@
+#include <QtEndian>
+#include "tilepack.h"
+#include "tilesource.h"
+
+// header fields, all quint32 but the index offset
+enum HeaderField {
+    MagicField, VersionField, WidthField, HeightField, TileSizeField, BorderField,
+    LevelsField, PixelFormatField, TileCountField, ReservedField, HeaderFieldCount
+};
+static const int HeaderSize = HeaderFieldCount * 4 + 8;
+// quint64 offset, quint32 size, quint32 reserved
+static const int IndexEntrySize = 16;
+
+static int bytesPerTexel(TilePack::PixelFormat format)
+{
+    return format == TilePack::R16 ? 2 : 4;
+}
+
+static QSize halved(const QSize &s)
+{
+    return QSize((s.width() + 1) / 2, (s.height() + 1) / 2);
+}
+
+TilePack::TilePack()
+    : m_data(nullptr), m_fileSize(0)
+    , m_tileSize(0), m_border(0), m_levels(0), m_pixelFormat(Rgba8)
+    , m_tileCount(0), m_indexOffset(0)
+{
+}
+
+bool TilePack::open(const QString &fileName)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    m_fileSize = m_file.size();
+    if (m_fileSize < HeaderSize) {
+        qWarning("TilePack: %s is too short", qPrintable(fileName));
+        close();
+        return false;
+    }
+    // the whole file, pages come in as tiles are touched
+    const uchar *p = m_file.map(0, m_fileSize);
+    if (!p) {
+        qWarning("TilePack: can not map %s", qPrintable(fileName));
+        close();
+        return false;
+    }
+
+    quint32 header[HeaderFieldCount];
+    for (int i = 0; i < HeaderFieldCount; i++) {
+        header[i] = qFromLittleEndian<quint32>(p + i * 4);
+    }
+    m_indexOffset = qFromLittleEndian<quint64>(p + HeaderFieldCount * 4);
+    if (header[MagicField] != Magic || header[VersionField] != Version) {
+        qWarning("TilePack: %s is not a version %u tile pack", qPrintable(fileName),
+                 Version);
+        close();
+        return false;
+    }
+    m_size = QSize(header[WidthField], header[HeightField]);
+    m_tileSize = header[TileSizeField];
+    m_border = header[BorderField];
+    m_levels = header[LevelsField];
+    m_pixelFormat = PixelFormat(header[PixelFormatField]);
+    m_tileCount = header[TileCountField];
+
+    bool valid = !m_size.isEmpty() && m_tileSize > 0 && m_border < m_tileSize
+                 && m_levels > 0 && m_levels < 32
+                 && (m_pixelFormat == Rgba8 || m_pixelFormat == R16);
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // 16 bit texels would need swapping, which a mapping can not do
+    valid = valid && m_pixelFormat != R16;
+#endif
+    if (valid) {
+        m_levelFirst.clear();
+        int first = 0;
+        for (int level = 0; level < m_levels; level++) {
+            m_levelFirst << first;
+            first += tilesX(level) * tilesY(level);
+        }
+        m_levelFirst << first;
+        valid = first == m_tileCount && m_indexOffset >= HeaderSize
+                && m_indexOffset + qint64(m_tileCount) * IndexEntrySize <= m_fileSize;
+    }
+    // every payload must lie inside the file, so tile() needs no checks
+    const int slot = m_tileSize + 2 * m_border;
+    const qint64 tileBytes = qint64(slot) * slot * bytesPerTexel(m_pixelFormat);
+    for (int i = 0; valid && i < m_tileCount; i++) {
+        const uchar *entry = p + m_indexOffset + i * IndexEntrySize;
+        quint64 offset = qFromLittleEndian<quint64>(entry);
+        quint32 size = qFromLittleEndian<quint32>(entry + 8);
+        valid = size == tileBytes && offset <= quint64(m_fileSize - size);
+    }
+    if (!valid) {
+        qWarning("TilePack: %s is damaged", qPrintable(fileName));
+        close();
+        return false;
+    }
+    m_data = p;
+    return true;
+}
+
+void TilePack::close()
+{
+    // unmapped along with the file
+    m_file.close();
+    m_data = nullptr;
+    m_fileSize = 0;
+    m_levelFirst.clear();
+}
+
+int TilePack::tilesX(int level) const
+{
+    QSize s = m_size;
+    for (int l = m_levels - 1; l > level; l--) {
+        s = halved(s);
+    }
+    return (s.width() + m_tileSize - 1) / m_tileSize;
+}
+
+int TilePack::tilesY(int level) const
+{
+    QSize s = m_size;
+    for (int l = m_levels - 1; l > level; l--) {
+        s = halved(s);
+    }
+    return (s.height() + m_tileSize - 1) / m_tileSize;
+}
+
+int TilePack::tileIndex(int level, int x, int y) const
+{
+    if (level < 0 || level >= m_levels || x < 0 || y < 0) {
+        return -1;
+    }
+    int columns = tilesX(level);
+    if (x >= columns || y >= tilesY(level)) {
+        return -1;
+    }
+    return m_levelFirst[level] + y * columns + x;
+}
+
+const uchar *TilePack::tile(int level, int x, int y, int *size) const
+{
+    int index = isOpen() ? tileIndex(level, x, y) : -1;
+    if (index < 0) {
+        return nullptr;
+    }
+    const uchar *entry = m_data + m_indexOffset + index * IndexEntrySize;
+    if (size) {
+        *size = qFromLittleEndian<quint32>(entry + 8);
+    }
+    return m_data + qFromLittleEndian<quint64>(entry);
+}
+
+/*!
+ * \brief TilePack::write
+ * Pack every tile of the source, level 0 first. Tiles are pulled one at a
+ * time, so only the source has to hold the image.
+ */
+bool TilePack::write(TileSource *source, const QString &fileName)
+{
+    PixelFormat format = Rgba8;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    if (source->format() == QImage::Format_Grayscale16) {
+        format = R16;
+    }
+#endif
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    if (format == R16) {
+        qWarning("TilePack: 16 bit packs are written on little endian machines only");
+        return false;
+    }
+#endif
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("TilePack: can not write %s", qPrintable(fileName));
+        return false;
+    }
+
+    const int levels = source->maxLevel() + 1;
+    int tileCount = 0;
+    for (int level = 0; level < levels; level++) {
+        tileCount += source->tilesX(level) * source->tilesY(level);
+    }
+    const int slot = source->tileSize() + 2 * TileSource::Border;
+    const int rowBytes = slot * bytesPerTexel(format);
+
+    QByteArray head(HeaderSize + tileCount * IndexEntrySize, 0);
+    uchar *p = reinterpret_cast<uchar *>(head.data());
+    const quint32 header[HeaderFieldCount] = {
+        Magic, Version, quint32(source->size().width()), quint32(source->size().height()),
+        quint32(source->tileSize()), quint32(TileSource::Border), quint32(levels),
+        quint32(format), quint32(tileCount), 0
+    };
+    for (int i = 0; i < HeaderFieldCount; i++) {
+        qToLittleEndian<quint32>(header[i], p + i * 4);
+    }
+    qToLittleEndian<quint64>(HeaderSize, p + HeaderFieldCount * 4);
+
+    // payloads go after the index, which is filled in as they are written
+    // and rewritten at the end
+    file.write(head);
+    qint64 offset = head.size();
+    const QByteArray padding(PayloadAlignment, 0);
+    int index = 0;
+    for (int level = 0; level < levels; level++) {
+        for (int y = 0; y < source->tilesY(level); y++) {
+            for (int x = 0; x < source->tilesX(level); x++) {
+                QImage image = source->tile(level, x, y);
+                if (image.width() != slot || image.height() != slot) {
+                    qWarning("TilePack: tile %d/%d/%d has the wrong size", level, y, x);
+                    return false;
+                }
+                qint64 aligned = (offset + PayloadAlignment - 1) / PayloadAlignment
+                                 * PayloadAlignment;
+                file.write(padding.constData(), aligned - offset);
+                for (int row = 0; row < slot; row++) {
+                    file.write(reinterpret_cast<const char *>(image.constScanLine(row)),
+                               rowBytes);
+                }
+                uchar *entry = p + HeaderSize + index * IndexEntrySize;
+                qToLittleEndian<quint64>(aligned, entry);
+                qToLittleEndian<quint32>(slot * rowBytes, entry + 8);
+                offset = aligned + slot * rowBytes;
+                index++;
+            }
+        }
+    }
+    if (file.error() != QFileDevice::NoError || !file.seek(0)
+        || file.write(head) != head.size()) {
+        qWarning("TilePack: can not write %s", qPrintable(fileName));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef TILEPACK_H
+#define TILEPACK_H
+
+#include <QFile>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+class TileSource;
+
+/*!
+ * \brief The TilePack class
+ * A whole tile pyramid in one file: a header, an index with the offset and
+ * size of every tile, and the tile payloads, each starting on a page
+ * boundary. The file is mapped rather than read, so a tile is a pointer
+ * into the mapping that can be handed to glTexSubImage2D as is.
+ *
+ * Tiles are stored level 0 first, rows top to bottom, as raw texels with
+ * their borders. All fields are little endian.
+ */
+class TilePack
+{
+public:
+    enum PixelFormat {
+        // imagery, 4 bytes per texel
+        Rgba8 = 1,
+        // elevation, 2 bytes per texel
+        R16 = 2,
+    };
+
+    static const quint32 Magic = 0x50544745; // "EGTP"
+    static const quint32 Version = 1;
+    static const int PayloadAlignment = 4096;
+
+    TilePack();
+
+    bool open(const QString &fileName);
+    bool isOpen() const { return m_data != nullptr; }
+    void close();
+
+    QSize size() const { return m_size; }
+    int tileSize() const { return m_tileSize; }
+    int border() const { return m_border; }
+    int levelCount() const { return m_levels; }
+    PixelFormat pixelFormat() const { return m_pixelFormat; }
+    int tilesX(int level) const;
+    int tilesY(int level) const;
+
+    // valid while the pack is open; nullptr for tiles out of range
+    const uchar *tile(int level, int x, int y, int *size = nullptr) const;
+
+    static bool write(TileSource *source, const QString &fileName);
+
+private:
+    int tileIndex(int level, int x, int y) const;
+
+    QFile m_file;
+    const uchar *m_data;
+    qint64 m_fileSize;
+    QSize m_size;
+    int m_tileSize;
+    int m_border;
+    int m_levels;
+    PixelFormat m_pixelFormat;
+    int m_tileCount;
+    qint64 m_indexOffset;
+    // index of the first tile of every level, plus a sentinel
+    QVector<int> m_levelFirst;
+};
+
+#endif // TILEPACK_H
@@ -0,0 +1,220 @@
+#include <cstring>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSettings>
+#include "tilesource.h"
+
+TileSource::~TileSource()
+{
+}
+
+/*!
+ * \brief TileSource::open
+ * \param path: a .tilepack file, a directory holding tiles.ini, or any
+ * image QImage reads
+ * \return nullptr if nothing usable is there
+ */
+TileSource *TileSource::open(const QString &path)
+{
+    if (path.endsWith(QLatin1String(".tilepack"))) {
+        auto source = new PackTileSource(path);
+        if (source->isValid()) {
+            return source;
+        }
+        delete source;
+        return nullptr;
+    }
+    if (QFileInfo(path).isDir()) {
+        auto source = new DirectoryTileSource(path);
+        if (source->isValid()) {
+            return source;
+        }
+        delete source;
+        return nullptr;
+    }
+    QImage image(path);
+    if (image.isNull()) {
+        return nullptr;
+    }
+    return new ImageTileSource(image);
+}
+
+int TileSource::maxLevel() const
+{
+    int level = 0;
+    QSize s = size();
+    while (s.width() > tileSize() || s.height() > tileSize()) {
+        s = QSize((s.width() + 1) / 2, (s.height() + 1) / 2);
+        level++;
+    }
+    return level;
+}
+
+QSize TileSource::levelSize(int level) const
+{
+    QSize s = size();
+    for (int l = maxLevel(); l > level; l--) {
+        s = QSize((s.width() + 1) / 2, (s.height() + 1) / 2);
+    }
+    return s;
+}
+
+int TileSource::tilesX(int level) const
+{
+    return (levelSize(level).width() + tileSize() - 1) / tileSize();
+}
+
+int TileSource::tilesY(int level) const
+{
+    return (levelSize(level).height() + tileSize() - 1) / tileSize();
+}
+
+ImageTileSource::ImageTileSource(const QImage &image, int tileSize)
+    : m_size(image.size())
+    , m_tileSize(tileSize)
+    , m_format(QImage::Format_RGBA8888)
+{
+    m_levels.resize(maxLevel() + 1);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    // elevation keeps its 16 bits
+    if (image.format() == QImage::Format_Grayscale16) {
+        m_format = image.format();
+    }
+#endif
+    m_levels[maxLevel()] = image.convertToFormat(m_format);
+}
+
+/*!
+ * \brief halve
+ * 2x2 box filter of a level into the next coarser one, whose size is
+ * rounded up; an odd last row or column is averaged with itself.
+ */
+template <typename T>
+static QImage halve(const QImage &src, int channels)
+{
+    const int w = (src.width() + 1) / 2;
+    const int h = (src.height() + 1) / 2;
+    QImage dst(w, h, src.format());
+    for (int y = 0; y < h; y++) {
+        const T *row0 = reinterpret_cast<const T *>(src.constScanLine(2 * y));
+        const T *row1 = reinterpret_cast<const T *>(
+                            src.constScanLine(qMin(2 * y + 1, src.height() - 1)));
+        T *out = reinterpret_cast<T *>(dst.scanLine(y));
+        for (int x = 0; x < w; x++) {
+            const int x0 = 2 * x * channels;
+            const int x1 = qMin(2 * x + 1, src.width() - 1) * channels;
+            for (int c = 0; c < channels; c++) {
+                out[x * channels + c] = T((row0[x0 + c] + row0[x1 + c]
+                                           + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+QImage ImageTileSource::level(int level)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_levels[level].isNull()) {
+        return m_levels[level];
+    }
+    locker.unlock();
+    QImage finer = this->level(level + 1);
+    QImage image = m_format == QImage::Format_RGBA8888
+                   ? halve<quint8>(finer, 4) : halve<quint16>(finer, 1);
+    locker.relock();
+    m_levels[level] = image;
+    return image;
+}
+
+QImage ImageTileSource::tile(int level, int x, int y)
+{
+    QImage image = this->level(level);
+    const int slot = m_tileSize + 2 * Border;
+    const int bytes = image.depth() / 8;
+    QImage tile(slot, slot, image.format());
+    // texels past the edges of the level repeat the last ones
+    for (int ty = 0; ty < slot; ty++) {
+        const int sy = qBound(0, y * m_tileSize - Border + ty, image.height() - 1);
+        const uchar *src = image.constScanLine(sy);
+        uchar *dst = tile.scanLine(ty);
+        for (int tx = 0; tx < slot; tx++) {
+            const int sx = qBound(0, x * m_tileSize - Border + tx, image.width() - 1);
+            memcpy(dst + tx * bytes, src + sx * bytes, bytes);
+        }
+    }
+    return tile;
+}
+
+DirectoryTileSource::DirectoryTileSource(const QString &dir)
+    : m_dir(dir)
+    , m_tileSize(0)
+{
+    QSettings settings(QDir(dir).filePath(QStringLiteral("tiles.ini")), QSettings::IniFormat);
+    m_size = QSize(settings.value(QStringLiteral("width")).toInt(),
+                   settings.value(QStringLiteral("height")).toInt());
+    m_tileSize = settings.value(QStringLiteral("tileSize"), 256).toInt();
+    m_suffix = settings.value(QStringLiteral("suffix"), QStringLiteral("png")).toString();
+}
+
+QImage DirectoryTileSource::tile(int level, int x, int y)
+{
+    QString path = QStringLiteral("%1/%2/%3/%4.%5").arg(m_dir).arg(level).arg(y).arg(x)
+                   .arg(m_suffix);
+    QImage image(path);
+    if (image.isNull()) {
+        qWarning("DirectoryTileSource: can not read %s", qPrintable(path));
+    }
+    return image.convertToFormat(QImage::Format_RGBA8888);
+}
+
+PackTileSource::PackTileSource(const QString &fileName)
+    : m_format(QImage::Format_RGBA8888)
+{
+    if (!m_pack.open(fileName)) {
+        return;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    if (m_pack.pixelFormat() == TilePack::R16) {
+        m_format = QImage::Format_Grayscale16;
+    }
+#endif
+    // tiles are cut with our border, and 16 bit ones need a Qt that has them
+    bool wide = m_pack.pixelFormat() == TilePack::R16;
+    if (m_pack.border() != Border || (wide && m_format == QImage::Format_RGBA8888)) {
+        qWarning("PackTileSource: %s does not fit this build", qPrintable(fileName));
+        m_pack.close();
+        return;
+    }
+    // VirtualTexture asks for the pyramid of size() and tileSize(), which
+    // must be the one in the pack
+    bool matches = m_pack.levelCount() == maxLevel() + 1;
+    for (int level = 0; matches && level < m_pack.levelCount(); level++) {
+        matches = m_pack.tilesX(level) == tilesX(level)
+                  && m_pack.tilesY(level) == tilesY(level);
+    }
+    if (!matches) {
+        qWarning("PackTileSource: levels of %s do not match its size",
+                 qPrintable(fileName));
+        m_pack.close();
+    }
+}
+
+QImage PackTileSource::tile(int level, int x, int y)
+{
+    int size = 0;
+    const uchar *data = m_pack.tile(level, x, y, &size);
+    const int slot = m_pack.tileSize() + 2 * Border;
+    const int bytes = m_format == QImage::Format_RGBA8888 ? 4 : 2;
+    if (!data || size < slot * slot * bytes) {
+        return QImage();
+    }
+    // fault the pages in here, on the loader thread, rather than in the upload
+    volatile uchar sink = 0;
+    for (int i = 0; i < size; i += TilePack::PayloadAlignment) {
+        sink += data[i];
+    }
+    Q_UNUSED(sink);
+    return QImage(data, slot, slot, size / slot, m_format);
+}
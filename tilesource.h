@@ -0,0 +1,115 @@
+#ifndef TILESOURCE_H
+#define TILESOURCE_H
+
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include "tilepack.h"
+
+/*!
+ * \brief The TileSource class
+ * A quadtree pyramid of square tiles over an equirectangular image. Level
+ * maxLevel() is the image itself, every level above halves it, and level 0
+ * fits in a single tile. tile() may be called from any thread.
+ */
+class TileSource
+{
+public:
+    // texels repeated from the neighbours around every tile, for filtering
+    static const int Border = 1;
+
+    virtual ~TileSource();
+
+    static TileSource *open(const QString &path);
+
+    // size of the finest level
+    virtual QSize size() const = 0;
+    // texels on a tile edge, without the border
+    virtual int tileSize() const = 0;
+    // Format_RGBA8888 for imagery, 16 bit grayscale for elevation
+    virtual QImage::Format format() const { return QImage::Format_RGBA8888; }
+    // (tileSize() + 2 * Border)^2 texels in format(), top row first
+    virtual QImage tile(int level, int x, int y) = 0;
+
+    int maxLevel() const;
+    QSize levelSize(int level) const;
+    int tilesX(int level) const;
+    int tilesY(int level) const;
+};
+
+/*!
+ * \brief The ImageTileSource class
+ * Cuts tiles out of an image held in memory, for images that fit there.
+ * Levels are box filtered from the one below on first use.
+ */
+class ImageTileSource : public TileSource
+{
+public:
+    explicit ImageTileSource(const QImage &image, int tileSize = 256);
+
+    QSize size() const override { return m_size; }
+    int tileSize() const override { return m_tileSize; }
+    QImage::Format format() const override { return m_format; }
+    QImage tile(int level, int x, int y) override;
+
+protected:
+    QImage level(int level);
+
+private:
+    QSize m_size;
+    int m_tileSize;
+    QImage::Format m_format;
+    QMutex m_mutex;
+    QVector<QImage> m_levels;
+};
+
+/*!
+ * \brief The DirectoryTileSource class
+ * Reads a pyramid stored as one image per tile, borders included:
+ * dir/tiles.ini gives width, height, tileSize and suffix, and tile (x, y)
+ * of a level is dir/level/y/x.suffix.
+ */
+class DirectoryTileSource : public TileSource
+{
+public:
+    explicit DirectoryTileSource(const QString &dir);
+
+    bool isValid() const { return !m_size.isEmpty() && m_tileSize > 0; }
+
+    QSize size() const override { return m_size; }
+    int tileSize() const override { return m_tileSize; }
+    QImage tile(int level, int x, int y) override;
+
+private:
+    QString m_dir;
+    QString m_suffix;
+    QSize m_size;
+    int m_tileSize;
+};
+
+/*!
+ * \brief The PackTileSource class
+ * Serves tiles straight out of a mapped TilePack. The images it returns
+ * share the mapping instead of copying it and stay valid as long as the
+ * source does.
+ */
+class PackTileSource : public TileSource
+{
+public:
+    explicit PackTileSource(const QString &fileName);
+
+    bool isValid() const { return m_pack.isOpen(); }
+
+    QSize size() const override { return m_pack.size(); }
+    int tileSize() const override { return m_pack.tileSize(); }
+    QImage::Format format() const override { return m_format; }
+    QImage tile(int level, int x, int y) override;
+
+private:
+    TilePack m_pack;
+    QImage::Format m_format;
+};
+
+#endif // TILESOURCE_H
@@ -0,0 +1,48 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+#include "pointloader.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("pointpack"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+                                         "Converts a CSV file of markers to the .points "
+                                         "format, which EarthGL reads without parsing text. "
+                                         "Put earth.points next to the executable to have "
+                                         "the globe load it."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("csv"),
+                                 QStringLiteral("Markers with lon and lat columns, "
+                                                "optionally color and size."));
+    parser.addPositionalArgument(QStringLiteral("points"),
+                                 QStringLiteral("Output .points."));
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 2) {
+        parser.showHelp(1);
+    }
+    QString input = parser.positionalArguments().at(0);
+    QString output = parser.positionalArguments().at(1);
+
+    QTextStream err(stderr);
+    QVector<PointLayer::Point> points;
+    auto append = [&points](const QVector<PointLayer::Point> &batch) {
+        points += batch;
+        return true;
+    };
+    bool ok = PointLoader::read(input, append);
+    if (!ok) {
+        err << "pointpack: can not read " << input << "\n";
+        return 1;
+    }
+    if (!PointLoader::write(output, points)) {
+        err << "pointpack: can not write " << output << "\n";
+        return 1;
+    }
+    err << output << ": " << points.size() << " points\n";
+    return 0;
+}
@@ -0,0 +1,16 @@
+TEMPLATE = app
+TARGET = pointpack
+
+QT += gui concurrent
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../pointlayer.cpp \
+    ../../pointloader.cpp
+
+HEADERS += \
+    ../../pointlayer.h \
+    ../../pointloader.h
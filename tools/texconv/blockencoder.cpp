@@ -0,0 +1,283 @@
+#include <climits>
+#include <QtGlobal>
+#include "blockencoder.h"
+
+static int squaredDistance(const int a[3], const quint8 b[3])
+{
+    int d = 0;
+    for (int c = 0; c < 3; c++) {
+        d += (a[c] - b[c]) * (a[c] - b[c]);
+    }
+    return d;
+}
+
+/*!
+ * \brief BlockEncoder::encode
+ * \return the blocks of image, left to right and top to bottom
+ */
+QByteArray BlockEncoder::encode(const QImage &image, Format format)
+{
+    QImage rgb = image.convertToFormat(QImage::Format_RGB888);
+    const int w = rgb.width();
+    const int h = rgb.height();
+    QByteArray out;
+    out.reserve(((w + 3) / 4) * ((h + 3) / 4) * 8);
+
+    quint8 block[16][3];
+    quint8 encoded[8];
+    for (int by = 0; by < h; by += 4) {
+        for (int bx = 0; bx < w; bx += 4) {
+            for (int y = 0; y < 4; y++) {
+                const uchar *line = rgb.constScanLine(qMin(by + y, h - 1));
+                for (int x = 0; x < 4; x++) {
+                    const uchar *pixel = line + 3 * qMin(bx + x, w - 1);
+                    for (int c = 0; c < 3; c++) {
+                        block[y * 4 + x][c] = pixel[c];
+                    }
+                }
+            }
+            if (format == BC1) {
+                encodeBC1(block, encoded);
+            } else {
+                encodeETC1(block, encoded);
+            }
+            out.append(reinterpret_cast<const char *>(encoded), 8);
+        }
+    }
+    return out;
+}
+
+static quint16 toRgb565(const int color[3])
+{
+    return quint16(((color[0] * 31 + 127) / 255) << 11
+                   | ((color[1] * 63 + 127) / 255) << 5
+                   | ((color[2] * 31 + 127) / 255));
+}
+
+static void fromRgb565(quint16 packed, int color[3])
+{
+    int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+/*!
+ * \brief BlockEncoder::encodeBC1
+ * Inset bounding box endpoints, with the box diagonal picked to follow the
+ * correlation of the channels, then the nearest of the four palette colors
+ * for every pixel.
+ */
+void BlockEncoder::encodeBC1(const quint8 block[16][3], quint8 out[8])
+{
+    int lo[3] = { 255, 255, 255 };
+    int hi[3] = { 0, 0, 0 };
+    int mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            lo[c] = qMin(lo[c], int(block[i][c]));
+            hi[c] = qMax(hi[c], int(block[i][c]));
+            mean[c] += block[i][c];
+        }
+    }
+    int major = 0;
+    for (int c = 0; c < 3; c++) {
+        mean[c] /= 16;
+        if (hi[c] - lo[c] > hi[major] - lo[major]) {
+            major = c;
+        }
+    }
+
+    int e0[3], e1[3];
+    for (int c = 0; c < 3; c++) {
+        int inset = (hi[c] - lo[c]) >> 4;
+        e0[c] = hi[c] - inset;
+        e1[c] = lo[c] + inset;
+        int covariance = 0;
+        for (int i = 0; i < 16; i++) {
+            covariance += (block[i][c] - mean[c]) * (block[i][major] - mean[major]);
+        }
+        if (covariance < 0) {
+            qSwap(e0[c], e1[c]);
+        }
+    }
+
+    quint16 c0 = toRgb565(e0);
+    quint16 c1 = toRgb565(e1);
+    if (c0 < c1) {
+        qSwap(c0, c1);
+    }
+    quint32 indices = 0;
+    if (c0 != c1) {
+        // four color mode needs c0 > c1
+        int palette[4][3];
+        fromRgb565(c0, palette[0]);
+        fromRgb565(c1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int bestError = squaredDistance(palette[0], block[i]);
+            for (int p = 1; p < 4; p++) {
+                int error = squaredDistance(palette[p], block[i]);
+                if (error < bestError) {
+                    best = p;
+                    bestError = error;
+                }
+            }
+            indices |= quint32(best) << (2 * i);
+        }
+    }
+
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    for (int k = 0; k < 4; k++) {
+        out[4 + k] = (indices >> (8 * k)) & 0xFF;
+    }
+}
+
+static const int Etc1Modifiers[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 },
+    { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+struct Etc1Subblock
+{
+    int table;
+    // 2 bit pixel index per block position, for positions in the subblock
+    int indices[16];
+    int error;
+};
+
+/*!
+ * \brief fitSubblock
+ * Best modifier table and per pixel modifiers for a base color.
+ */
+static Etc1Subblock fitSubblock(const quint8 block[16][3], const bool member[16],
+                                const int base[3])
+{
+    Etc1Subblock best;
+    best.error = INT_MAX;
+    for (int t = 0; t < 8; t++) {
+        const int modifiers[4] = {
+            Etc1Modifiers[t][0], Etc1Modifiers[t][1],
+            -Etc1Modifiers[t][0], -Etc1Modifiers[t][1]
+        };
+        Etc1Subblock fit;
+        fit.table = t;
+        fit.error = 0;
+        for (int i = 0; i < 16; i++) {
+            if (!member[i]) {
+                continue;
+            }
+            int bestIndex = 0;
+            int bestError = INT_MAX;
+            for (int m = 0; m < 4; m++) {
+                int color[3];
+                for (int c = 0; c < 3; c++) {
+                    color[c] = qBound(0, base[c] + modifiers[m], 255);
+                }
+                int error = squaredDistance(color, block[i]);
+                if (error < bestError) {
+                    bestIndex = m;
+                    bestError = error;
+                }
+            }
+            fit.indices[i] = bestIndex;
+            fit.error += bestError;
+        }
+        if (fit.error < best.error) {
+            best = fit;
+        }
+    }
+    return best;
+}
+
+/*!
+ * \brief BlockEncoder::encodeETC1
+ * Tries both subblock orientations, in differential mode where the two
+ * averages are close enough and in individual mode, and keeps the one with
+ * the smallest squared error.
+ */
+void BlockEncoder::encodeETC1(const quint8 block[16][3], quint8 out[8])
+{
+    int bestError = INT_MAX;
+    for (int flip = 0; flip < 2; flip++) {
+        // subblock 0 is the left half, or the top half when flipped
+        bool member[2][16];
+        int average[2][3] = {};
+        for (int i = 0; i < 16; i++) {
+            int x = i % 4, y = i / 4;
+            int sub = (flip ? y : x) >= 2;
+            member[sub][i] = true;
+            member[1 - sub][i] = false;
+            for (int c = 0; c < 3; c++) {
+                average[sub][c] += block[i][c];
+            }
+        }
+
+        for (int differential = 0; differential < 2; differential++) {
+            int quantized[2][3];
+            int base[2][3];
+            bool fits = true;
+            for (int s = 0; s < 2; s++) {
+                for (int c = 0; c < 3; c++) {
+                    int mean = average[s][c] / 8;
+                    if (differential) {
+                        int q = (mean * 31 + 127) / 255;
+                        quantized[s][c] = q;
+                        base[s][c] = (q << 3) | (q >> 2);
+                    } else {
+                        int q = (mean * 15 + 127) / 255;
+                        quantized[s][c] = q;
+                        base[s][c] = (q << 4) | q;
+                    }
+                }
+            }
+            if (differential) {
+                for (int c = 0; c < 3; c++) {
+                    int delta = quantized[1][c] - quantized[0][c];
+                    fits = fits && delta >= -4 && delta <= 3;
+                }
+            }
+            if (!fits) {
+                continue;
+            }
+
+            Etc1Subblock fit[2] = {
+                fitSubblock(block, member[0], base[0]),
+                fitSubblock(block, member[1], base[1]),
+            };
+            int error = fit[0].error + fit[1].error;
+            if (error >= bestError) {
+                continue;
+            }
+            bestError = error;
+
+            for (int c = 0; c < 3; c++) {
+                out[c] = differential
+                         ? (quantized[0][c] << 3) | ((quantized[1][c] - quantized[0][c]) & 7)
+                         : (quantized[0][c] << 4) | quantized[1][c];
+            }
+            out[3] = (fit[0].table << 5) | (fit[1].table << 2) | (differential << 1) | flip;
+            // pixels are numbered down the columns
+            quint16 msb = 0, lsb = 0;
+            for (int i = 0; i < 16; i++) {
+                int x = i % 4, y = i / 4;
+                int sub = member[0][i] ? 0 : 1;
+                int index = fit[sub].indices[i];
+                int bit = x * 4 + y;
+                msb |= ((index >> 1) & 1) << bit;
+                lsb |= (index & 1) << bit;
+            }
+            out[4] = msb >> 8;
+            out[5] = msb & 0xFF;
+            out[6] = lsb >> 8;
+            out[7] = lsb & 0xFF;
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef BLOCKENCODER_H
+#define BLOCKENCODER_H
+
+#include <QByteArray>
+#include <QImage>
+
+/*!
+ * \brief The BlockEncoder class
+ * Encoders for 4x4 block compressed RGB formats, both 8 bytes per block.
+ * Images whose size is not a multiple of 4 are padded by repeating the
+ * last row and column.
+ */
+class BlockEncoder
+{
+public:
+    enum Format {
+        // S3TC DXT1 without alpha
+        BC1,
+        // ETC1, which ETC2 RGB8 decoders read as well
+        ETC1,
+    };
+
+    static QByteArray encode(const QImage &image, Format format);
+
+    static void encodeBC1(const quint8 block[16][3], quint8 out[8]);
+    static void encodeETC1(const quint8 block[16][3], quint8 out[8]);
+};
+
+#endif // BLOCKENCODER_H
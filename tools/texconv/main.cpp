@@ -0,0 +1,91 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QImage>
+#include <QTextStream>
+#include "blockencoder.h"
+#include "ktxfile.h"
+
+#ifndef GL_RGB
+#define GL_RGB 0x1907
+#endif
+
+/*!
+ * \brief convert
+ * Write the image and its full mip chain, each level box filtered from the
+ * previous one, as a KTX file of the given block format.
+ */
+static bool convert(const QImage &image, BlockEncoder::Format format, quint32 glFormat,
+                    const QString &fileName)
+{
+    KtxFile ktx;
+    ktx.setFormat(glFormat, GL_RGB);
+    ktx.setSize(image.width(), image.height());
+
+    QImage level = image.convertToFormat(QImage::Format_RGB888);
+    forever {
+        ktx.addLevel(BlockEncoder::encode(level, format));
+        if (level.width() == 1 && level.height() == 1) {
+            break;
+        }
+        level = level.scaled(qMax(1, level.width() / 2), qMax(1, level.height() / 2),
+                             Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return ktx.save(fileName);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("texconv"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+                                         "Converts images to block compressed KTX files with mipmaps.\n"
+                                         "foo.png becomes foo.bc1.ktx and foo.etc1.ktx, which EarthGL "
+                                         "loads instead of foo.png when the GPU supports them."));
+    parser.addHelpOption();
+    QCommandLineOption formatOption(QStringList() << "f" << "format",
+                                    QStringLiteral("bc1, etc1 or all (default)."),
+                                    QStringLiteral("format"), QStringLiteral("all"));
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    QStringLiteral("Output directory, next to the input "
+                                                   "by default."),
+                                    QStringLiteral("dir"));
+    parser.addOption(formatOption);
+    parser.addOption(outputOption);
+    parser.addPositionalArgument(QStringLiteral("images"), QStringLiteral("Images to convert."),
+                                 QStringLiteral("images..."));
+    parser.process(app);
+
+    QString format = parser.value(formatOption);
+    bool bc1 = format == "bc1" || format == "all";
+    bool etc1 = format == "etc1" || format == "all";
+    if ((!bc1 && !etc1) || parser.positionalArguments().isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    QTextStream err(stderr);
+    int failed = 0;
+    for (const QString &input : parser.positionalArguments()) {
+        QImage image(input);
+        if (image.isNull()) {
+            err << "texconv: can not read " << input << "\n";
+            failed++;
+            continue;
+        }
+        QFileInfo info(input);
+        QString dir = parser.isSet(outputOption) ? parser.value(outputOption) : info.path();
+        QString base = dir + QLatin1Char('/') + info.completeBaseName();
+        if (bc1 && !convert(image, BlockEncoder::BC1, KtxFile::RGB_DXT1, base + ".bc1.ktx")) {
+            err << "texconv: can not write " << base << ".bc1.ktx\n";
+            failed++;
+        }
+        if (etc1 && !convert(image, BlockEncoder::ETC1, KtxFile::ETC1_RGB8,
+                             base + ".etc1.ktx")) {
+            err << "texconv: can not write " << base << ".etc1.ktx\n";
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
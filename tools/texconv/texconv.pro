@@ -0,0 +1,16 @@
+TEMPLATE = app
+TARGET = texconv
+
+QT += gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../ktxfile.cpp \
+    blockencoder.cpp
+
+HEADERS += \
+    ../../ktxfile.h \
+    blockencoder.h
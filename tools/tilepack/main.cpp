@@ -0,0 +1,67 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QImage>
+#include <QScopedPointer>
+#include <QTextStream>
+#include "tilepack.h"
+#include "tilesource.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("tilepack"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+                                         "Packs an equirectangular image into a tile pyramid "
+                                         "file, which EarthGL maps instead of decoding the "
+                                         "image. Put earth.tilepack next to the executable to "
+                                         "have the globe stream it."));
+    parser.addHelpOption();
+    QCommandLineOption tileSizeOption(QStringList() << "t" << "tile-size",
+                                      QStringLiteral("Texels on a tile edge, 256 by default."),
+                                      QStringLiteral("texels"), QStringLiteral("256"));
+    QCommandLineOption elevationOption(QStringList() << "e" << "elevation",
+                                       QStringLiteral("Keep 16 bit grayscale input as "
+                                                      "elevation instead of imagery."));
+    parser.addOption(tileSizeOption);
+    parser.addOption(elevationOption);
+    parser.addPositionalArgument(QStringLiteral("image"), QStringLiteral("Image to pack."));
+    parser.addPositionalArgument(QStringLiteral("pack"), QStringLiteral("Output .tilepack."));
+    parser.process(app);
+
+    bool ok = false;
+    int tileSize = parser.value(tileSizeOption).toInt(&ok);
+    if (!ok || tileSize < 16 || parser.positionalArguments().size() != 2) {
+        parser.showHelp(1);
+    }
+    QString input = parser.positionalArguments().at(0);
+    QString output = parser.positionalArguments().at(1);
+
+    QTextStream err(stderr);
+    QImage image(input);
+    if (image.isNull()) {
+        err << "tilepack: can not read " << input << "\n";
+        return 1;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    if (parser.isSet(elevationOption)) {
+        image = image.convertToFormat(QImage::Format_Grayscale16);
+    }
+#else
+    if (parser.isSet(elevationOption)) {
+        err << "tilepack: elevation needs Qt 5.13\n";
+        return 1;
+    }
+#endif
+
+    QScopedPointer<TileSource> source(new ImageTileSource(image, tileSize));
+    image = QImage();
+    if (!TilePack::write(source.data(), output)) {
+        err << "tilepack: can not write " << output << "\n";
+        return 1;
+    }
+    err << output << ": " << source->maxLevel() + 1 << " levels of "
+        << tileSize << " texel tiles\n";
+    return 0;
+}
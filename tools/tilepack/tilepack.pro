@@ -0,0 +1,16 @@
+TEMPLATE = app
+TARGET = tilepack
+
+QT += gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../tilepack.cpp \
+    ../../tilesource.cpp
+
+HEADERS += \
+    ../../tilepack.h \
+    ../../tilesource.h
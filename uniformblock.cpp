@@ -0,0 +1,122 @@
+#include <cstring>
+#include <QAtomicInt>
+#include <QOpenGLContext>
+#include "shadercache.h"
+#include "uniformblock.h"
+
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER 0x8A11
+#endif
+#ifndef GL_INVALID_INDEX
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+#endif
+
+static QAtomicInt nextSerial(0);
+
+UniformBlock::UniformBlock(const char *blockName, const char *arrayName,
+                           Binding binding)
+    : m_blockName(blockName), m_arrayName(arrayName), m_binding(binding)
+    , m_initialized(false), m_useBuffer(false)
+    , m_getUniformBlockIndex(nullptr), m_uniformBlockBinding(nullptr)
+    , m_bindBufferBase(nullptr)
+    , m_serial(0), m_buffer(0), m_bufferSize(0), m_dirty(false)
+{
+}
+
+UniformBlock::~UniformBlock()
+{
+    if (m_buffer) {
+        glDeleteBuffers(1, &m_buffer);
+    }
+}
+
+void UniformBlock::resolveFunctions()
+{
+    if (m_initialized) {
+        return;
+    }
+    initializeOpenGLFunctions();
+    m_initialized = true;
+
+    // the shaders only declare blocks in the Modern dialect
+    if (ShaderCache::preferredDialect() != ShaderCache::Modern) {
+        return;
+    }
+    auto ctx = QOpenGLContext::currentContext();
+    m_getUniformBlockIndex = reinterpret_cast<GetUniformBlockIndex>(
+                                 ctx->getProcAddress("glGetUniformBlockIndex"));
+    m_uniformBlockBinding = reinterpret_cast<UniformBlockBinding>(
+                                ctx->getProcAddress("glUniformBlockBinding"));
+    m_bindBufferBase = reinterpret_cast<BindBufferBase>(
+                           ctx->getProcAddress("glBindBufferBase"));
+    m_useBuffer = m_getUniformBlockIndex && m_uniformBlockBinding && m_bindBufferBase;
+}
+
+void UniformBlock::setData(const GLfloat *data, int vec4Count)
+{
+    int count = vec4Count * 4;
+    if (m_data.size() == count
+        && memcmp(m_data.constData(), data, count * sizeof(GLfloat)) == 0) {
+        return;
+    }
+    m_data.resize(count);
+    memcpy(m_data.data(), data, count * sizeof(GLfloat));
+    m_serial = nextSerial.fetchAndAddRelaxed(1) + 1;
+    m_dirty = true;
+}
+
+int UniformBlock::locate(QOpenGLShaderProgram *prog)
+{
+    int location = -1;
+    if (m_useBuffer) {
+        // binaries from ShaderCache come back with every block at binding 0
+        GLuint index = m_getUniformBlockIndex(prog->programId(), m_blockName.constData());
+        if (index != GL_INVALID_INDEX) {
+            m_uniformBlockBinding(prog->programId(), index, m_binding);
+            location = int(index);
+        }
+    } else {
+        location = prog->uniformLocation(m_arrayName.constData());
+    }
+    m_locations.insert(prog, location);
+    return location;
+}
+
+void UniformBlock::bind(QOpenGLShaderProgram *prog)
+{
+    resolveFunctions();
+    auto it = m_locations.constFind(prog);
+    int location = it != m_locations.constEnd() ? it.value() : locate(prog);
+    if (location < 0 || m_data.isEmpty()) {
+        return;
+    }
+
+    if (m_useBuffer) {
+        if (!m_buffer) {
+            glGenBuffers(1, &m_buffer);
+        }
+        if (m_dirty) {
+            int bytes = m_data.size() * sizeof(GLfloat);
+            glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+            if (bytes != m_bufferSize) {
+                glBufferData(GL_UNIFORM_BUFFER, bytes, m_data.constData(),
+                             GL_DYNAMIC_DRAW);
+                m_bufferSize = bytes;
+            } else {
+                glBufferSubData(GL_UNIFORM_BUFFER, 0, bytes, m_data.constData());
+            }
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            m_dirty = false;
+        }
+        // binding points belong to the context, which other renderers share
+        m_bindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_buffer);
+        return;
+    }
+
+    // the array belongs to the program, which other renderers share too, so
+    // the program keeps the serial of the values it holds
+    if (prog->property(m_arrayName.constData()).toInt() != m_serial) {
+        glUniform4fv(location, m_data.size() / 4, m_data.constData());
+        prog->setProperty(m_arrayName.constData(), m_serial);
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef UNIFORMBLOCK_H
+#define UNIFORMBLOCK_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QVector>
+
+// the blocks declared in shaders/uniforms.glsl, in std140 layout
+struct FrameUniforms {
+    GLfloat projection[16];
+    GLfloat view[16];
+    // eye space
+    GLfloat lightPosition[4];
+};
+
+struct MaterialUniforms {
+    GLfloat ambientColor[4];
+    GLfloat diffuseColor[4];
+    GLfloat specularColor[4];
+    // ambient, diffuse and specular reflection, then shininess
+    GLfloat reflection[4];
+};
+
+/*!
+ * \brief The UniformBlock class
+ * Values shared by many draws, declared once in shaders/uniforms.glsl. With
+ * the Modern dialect of ShaderCache they live in a uniform buffer at a fixed
+ * binding point, otherwise in a vec4 array set on each program. Either way
+ * nothing is uploaded unless the values changed.
+ */
+class UniformBlock : protected QOpenGLFunctions
+{
+public:
+    enum Binding {
+        FrameBinding = 0,
+        MaterialBinding = 1,
+    };
+
+    // blockName with uniform buffers, arrayName without
+    UniformBlock(const char *blockName, const char *arrayName, Binding binding);
+    // deletes the buffer, the context must be current
+    ~UniformBlock();
+
+    // only vec4 and mat4 members, so the std140 block is also a vec4 array
+    template <typename T>
+    void setData(const T &data)
+    {
+        Q_STATIC_ASSERT(sizeof(T) % (4 * sizeof(GLfloat)) == 0);
+        setData(reinterpret_cast<const GLfloat *>(&data),
+                int(sizeof(T) / (4 * sizeof(GLfloat))));
+    }
+    void setData(const GLfloat *data, int vec4Count);
+
+    // make the values visible to prog, which must be bound
+    void bind(QOpenGLShaderProgram *prog);
+
+protected:
+    void resolveFunctions();
+    int locate(QOpenGLShaderProgram *prog);
+
+private:
+    typedef GLuint (QOPENGLF_APIENTRYP GetUniformBlockIndex)(GLuint program,
+                                                             const GLchar *name);
+    typedef void (QOPENGLF_APIENTRYP UniformBlockBinding)(GLuint program, GLuint index,
+                                                          GLuint binding);
+    typedef void (QOPENGLF_APIENTRYP BindBufferBase)(GLenum target, GLuint index,
+                                                     GLuint buffer);
+
+    QByteArray m_blockName;
+    QByteArray m_arrayName;
+    GLuint m_binding;
+
+    bool m_initialized;
+    bool m_useBuffer;
+    GetUniformBlockIndex m_getUniformBlockIndex;
+    UniformBlockBinding m_uniformBlockBinding;
+    BindBufferBase m_bindBufferBase;
+
+    QVector<GLfloat> m_data;
+    // changes with every new value, unique across blocks
+    int m_serial;
+    GLuint m_buffer;
+    int m_bufferSize;
+    bool m_dirty;
+    // block index or array location per program, -1 if it has neither
+    QHash<QOpenGLShaderProgram *, int> m_locations;
+};
+
+#endif // UNIFORMBLOCK_H
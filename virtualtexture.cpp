@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <cstring>
+#include <QOpenGLContext>
+#include <QSet>
+#include <QtConcurrent>
+#include <QtMath>
+#include "virtualtexture.h"
+
+// tiles decoded at the same time, and uploaded per frame
+static const int MaxLoading = 8;
+static const int MaxUploads = 4;
+static const quint64 FreeSlot = ~quint64(0);
+
+static QImage loadTile(QSharedPointer<TileSource> source, int level, int x, int y)
+{
+    return source->tile(level, x, y);
+}
+
+VirtualTexture::VirtualTexture(TileSource *source, int slotsX, int slotsY)
+    : m_source(source)
+    , m_slotsX(slotsX), m_slotsY(slotsY)
+    , m_slotSize(source->tileSize() + 2 * TileSource::Border)
+    , m_frame(0)
+    , m_physical(QOpenGLTexture::Target2D)
+    , m_indirection(QOpenGLTexture::Target2D)
+    , m_indirectionDirty(true)
+    , m_blendEnabled(false)
+    , m_asyncReadback(false)
+    , m_readbackIndex(0)
+    , m_settled(false)
+{
+    initializeOpenGLFunctions();
+
+    auto ctx = QOpenGLContext::currentContext();
+    // ES 2 has no sized internal formats
+    auto format = ctx->isOpenGLES() && ctx->format().majorVersion() < 3
+                  ? QOpenGLTexture::RGBAFormat : QOpenGLTexture::RGBA8_UNorm;
+    const int finest = m_source->maxLevel();
+
+    m_physical.setFormat(format);
+    m_physical.setSize(m_slotsX * m_slotSize, m_slotsY * m_slotSize);
+    m_physical.allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+    m_physical.setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    m_physical.setWrapMode(QOpenGLTexture::ClampToEdge);
+
+    m_indirection.setFormat(format);
+    m_indirection.setSize(m_source->tilesX(finest), m_source->tilesY(finest));
+    m_indirection.allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+    m_indirection.setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+    m_indirection.setWrapMode(QOpenGLTexture::ClampToEdge);
+
+    // pixel pack buffers are in GL 2.1 and ES 3.0
+    const bool pbo = ctx->hasExtension(QByteArrayLiteral("GL_ARB_pixel_buffer_object"));
+    m_asyncReadback = ctx->isOpenGLES() ? ctx->format().majorVersion() >= 3
+                      : ctx->format().version() >= qMakePair(2, 1) || pbo;
+    for (QOpenGLBuffer &buffer : m_readbacks) {
+        buffer = QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer);
+        buffer.setUsagePattern(QOpenGLBuffer::StreamRead);
+    }
+
+    Slot free = { FreeSlot, -1, false };
+    m_slots.fill(free, m_slotsX * m_slotsY);
+
+    pinLevelZero();
+    updateIndirection();
+}
+
+/*!
+ * \brief VirtualTexture::pinLevelZero
+ * Level 0 stays resident, it is what everything falls back to. Stops at
+ * the first tile there is no slot for.
+ */
+void VirtualTexture::pinLevelZero()
+{
+    for (int y = 0; y < m_source->tilesY(0); y++) {
+        for (int x = 0; x < m_source->tilesX(0); x++) {
+            int slot = allocateSlot();
+            if (slot < 0) {
+                return;
+            }
+            upload(slot, m_source->tile(0, x, y));
+            m_slots[slot].key = tileKey(0, x, y);
+            m_slots[slot].pinned = true;
+            m_slotOf.insert(tileKey(0, x, y), slot);
+        }
+    }
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    // the loaders hold their own reference to the source
+    m_loading.clear();
+}
+
+quint64 VirtualTexture::tileKey(int level, int x, int y)
+{
+    // sorts coarse levels first
+    return quint64(level) << 48 | quint64(y) << 24 | quint64(x);
+}
+
+void VirtualTexture::beginFeedback(const QSize &viewport)
+{
+    QSize size((viewport.width() + FeedbackDivisor - 1) / FeedbackDivisor,
+               (viewport.height() + FeedbackDivisor - 1) / FeedbackDivisor);
+    if (!m_feedbackFbo || m_feedbackFbo->size() != size) {
+        m_feedbackFbo.reset(new QOpenGLFramebufferObject(size,
+                                                         QOpenGLFramebufferObject::Depth));
+    }
+    m_feedbackFbo->bind();
+    glViewport(0, 0, size.width(), size.height());
+    // tile ids must not be blended, the passes after this may want it
+    m_blendEnabled = glIsEnabled(GL_BLEND);
+    glDisable(GL_BLEND);
+    // alpha 0 is no tile
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/*!
+ * \brief VirtualTexture::endFeedback
+ * Read back the feedback and turn it into requests for the missing tiles.
+ * A pixel holds tile x and y in red and green, their high bits in blue and
+ * the level plus one in alpha, see virtualFeedback() in texlighting.frag.
+ */
+void VirtualTexture::endFeedback()
+{
+    bool ready = readFeedback(m_feedbackFbo->size());
+    m_feedbackFbo->release();
+    if (m_blendEnabled) {
+        glEnable(GL_BLEND);
+    }
+    m_frame++;
+    if (ready) {
+        requestWanted();
+    } else {
+        // the first frames, with the ring still filling
+        m_settled = false;
+    }
+}
+
+/*!
+ * \brief VirtualTexture::readFeedback
+ * Start reading the bound feedback buffer into the next pixel buffer and
+ * map the oldest one, written ReadbackCount - 1 frames ago. Without pixel
+ * buffers the read blocks.
+ * \return whether m_feedback holds a feedback to look at
+ */
+bool VirtualTexture::readFeedback(const QSize &size)
+{
+    const int bytes = size.width() * size.height() * 4;
+    if (!m_asyncReadback) {
+        m_feedback.resize(bytes);
+        glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE,
+                     m_feedback.data());
+        return true;
+    }
+
+    QOpenGLBuffer &write = m_readbacks[m_readbackIndex];
+    if (!write.isCreated()) {
+        write.create();
+    }
+    write.bind();
+    if (write.size() < bytes) {
+        write.allocate(bytes);
+    }
+    glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    write.release();
+    m_readbackSizes[m_readbackIndex] = size;
+    m_readbackIndex = (m_readbackIndex + 1) % ReadbackCount;
+
+    QOpenGLBuffer &read = m_readbacks[m_readbackIndex];
+    const QSize readSize = m_readbackSizes[m_readbackIndex];
+    if (readSize.isEmpty()) {
+        return false;
+    }
+    const int readBytes = readSize.width() * readSize.height() * 4;
+    read.bind();
+    // ES 3.0 only maps ranges, desktop GL 2.1 only whole buffers
+    auto ctx = QOpenGLContext::currentContext();
+    void *data = ctx->isOpenGLES()
+                 ? read.mapRange(0, readBytes, QOpenGLBuffer::RangeRead)
+                 : read.map(QOpenGLBuffer::ReadOnly);
+    if (data) {
+        m_feedback.resize(readBytes);
+        memcpy(m_feedback.data(), data, readBytes);
+        read.unmap();
+    }
+    read.release();
+    m_readbackSizes[m_readbackIndex] = QSize();
+    return data != nullptr;
+}
+
+/*!
+ * \brief VirtualTexture::requestWanted
+ * Turn the feedback in m_feedback into requests for the missing tiles.
+ */
+void VirtualTexture::requestWanted()
+{
+    // the wanted tiles and the ancestors they fall back to
+    QSet<quint64> wanted;
+    const int finest = m_source->maxLevel();
+    for (int i = 0; i < m_feedback.size(); i += 4) {
+        const uchar *p = m_feedback.constData() + i;
+        int level = p[3] - 1;
+        if (level < 0 || level > finest) {
+            continue;
+        }
+        int x = p[0] | (p[2] >> 4) << 8;
+        int y = p[1] | (p[2] & 15) << 8;
+        if (x >= m_source->tilesX(level) || y >= m_source->tilesY(level)) {
+            continue;
+        }
+        for (; level >= 0; level--, x >>= 1, y >>= 1) {
+            quint64 key = tileKey(level, x, y);
+            if (wanted.contains(key)) {
+                break;
+            }
+            wanted.insert(key);
+        }
+    }
+    // with the feedback frames behind, a view that just changed shows up
+    // a little later; it has settled once two feedbacks agree
+    m_settled = !m_asyncReadback || wanted == m_wanted;
+    m_wanted = wanted;
+
+    m_requests.clear();
+    for (quint64 key : wanted) {
+        auto slot = m_slotOf.constFind(key);
+        if (slot != m_slotOf.constEnd()) {
+            m_slots[*slot].lastUsed = m_frame;
+        } else if (!m_loading.contains(key)) {
+            m_requests << key;
+        }
+    }
+    std::sort(m_requests.begin(), m_requests.end());
+
+    // only ask for what fits without evicting tiles this frame needs,
+    // a cache too small for the view settles on coarser tiles
+    int evictable = 0;
+    for (const Slot &slot : m_slots) {
+        evictable += !slot.pinned && slot.lastUsed < m_frame;
+    }
+    m_requests.resize(qBound(0, evictable - m_loading.size(), m_requests.size()));
+}
+
+void VirtualTexture::request(quint64 key)
+{
+    int level = key >> 48;
+    int y = (key >> 24) & 0xFFFFFF;
+    int x = key & 0xFFFFFF;
+    m_loading.insert(key, QtConcurrent::run(loadTile, m_source, level, x, y));
+}
+
+bool VirtualTexture::isBusy() const
+{
+    return !m_loading.isEmpty() || !m_requests.isEmpty() || !m_settled;
+}
+
+/*!
+ * \brief VirtualTexture::allocateSlot
+ * A free slot, or the one whose tile has not been wanted for the longest
+ * time. Tiles wanted by the current frame are never evicted.
+ * \return -1 if there is no such slot
+ */
+int VirtualTexture::allocateSlot()
+{
+    int best = -1;
+    for (int i = 0; i < m_slots.size(); i++) {
+        const Slot &slot = m_slots[i];
+        if (slot.key == FreeSlot) {
+            return i;
+        }
+        if (!slot.pinned && slot.lastUsed < m_frame
+            && (best < 0 || slot.lastUsed < m_slots[best].lastUsed)) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        m_slotOf.remove(m_slots[best].key);
+        m_slots[best].key = FreeSlot;
+        m_indirectionDirty = true;
+    }
+    return best;
+}
+
+void VirtualTexture::upload(int slot, const QImage &tile)
+{
+    QImage image = tile;
+    if (image.size() != QSize(m_slotSize, m_slotSize)) {
+        image = image.scaled(m_slotSize, m_slotSize);
+    }
+    image = image.convertToFormat(QImage::Format_RGBA8888);
+
+    m_physical.bind();
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+                    (slot % m_slotsX) * m_slotSize, (slot / m_slotsX) * m_slotSize,
+                    m_slotSize, m_slotSize, GL_RGBA, GL_UNSIGNED_BYTE, image.constBits());
+    m_physical.release();
+}
+
+void VirtualTexture::update()
+{
+    int uploads = 0;
+    for (auto it = m_loading.begin(); it != m_loading.end() && uploads < MaxUploads;) {
+        if (!it.value().isFinished()) {
+            ++it;
+            continue;
+        }
+        QImage tile = it.value().result();
+        int slot = tile.isNull() ? -1 : allocateSlot();
+        if (slot >= 0) {
+            upload(slot, tile);
+            m_slots[slot].key = it.key();
+            m_slots[slot].lastUsed = m_frame;
+            m_slotOf.insert(it.key(), slot);
+            m_indirectionDirty = true;
+            uploads++;
+        }
+        it = m_loading.erase(it);
+    }
+
+    // keep the loaders busy, coarse tiles first
+    while (!m_requests.isEmpty() && m_loading.size() < MaxLoading) {
+        quint64 key = m_requests.takeFirst();
+        if (!m_slotOf.contains(key) && !m_loading.contains(key)) {
+            request(key);
+        }
+    }
+
+    if (m_indirectionDirty) {
+        updateIndirection();
+    }
+}
+
+/*!
+ * \brief VirtualTexture::updateIndirection
+ * Walk the pyramid from level 0 down, every tile taking its own slot when
+ * resident and its parent's entry otherwise. An entry holds the slot
+ * column and row and the level of the tile found.
+ */
+void VirtualTexture::updateIndirection()
+{
+    QVector<uchar> parent, entries;
+    for (int level = 0; level <= m_source->maxLevel(); level++) {
+        const int tilesX = m_source->tilesX(level);
+        const int tilesY = m_source->tilesY(level);
+        const int parentX = level ? m_source->tilesX(level - 1) : 0;
+        const int parentY = level ? m_source->tilesY(level - 1) : 0;
+        entries.fill(0, tilesX * tilesY * 4);
+        for (int y = 0; y < tilesY; y++) {
+            for (int x = 0; x < tilesX; x++) {
+                uchar *entry = entries.data() + (y * tilesX + x) * 4;
+                auto slot = m_slotOf.constFind(tileKey(level, x, y));
+                if (slot != m_slotOf.constEnd()) {
+                    entry[0] = *slot % m_slotsX;
+                    entry[1] = *slot / m_slotsX;
+                    entry[2] = level;
+                    entry[3] = 255;
+                } else if (level > 0) {
+                    int p = qMin(y / 2, parentY - 1) * parentX + qMin(x / 2, parentX - 1);
+                    memcpy(entry, parent.constData() + p * 4, 4);
+                }
+            }
+        }
+        parent.swap(entries);
+    }
+    m_indirection.setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, parent.constData());
+    m_indirectionDirty = false;
+}
+
+/*!
+ * \brief VirtualTexture::bind
+ * Set the uniforms texlighting.frag samples the virtual texture with and
+ * bind the indirection and physical textures to units 1 and 2.
+ * \param pixelScale: as for GlobeLod::splitDistance, the sphere is unit sized
+ */
+void VirtualTexture::bind(QOpenGLShaderProgram &program, double pixelScale, bool feedback)
+{
+    const QSize size = m_source->size();
+    const int finest = m_source->maxLevel();
+    m_indirection.bind(1, QOpenGLTexture::ResetTextureUnit);
+    m_physical.bind(2, QOpenGLTexture::ResetTextureUnit);
+
+    program.setUniformValue("fVirtualTexture", GLint(1));
+    program.setUniformValue("fFeedback", GLint(feedback));
+    program.setUniformValue("vtIndirection", GLint(1));
+    program.setUniformValue("vtPhysical", GLint(2));
+    program.setUniformValue("vtVirtualSize", QVector2D(size.width(), size.height()));
+    program.setUniformValue("vtTileCount", QVector2D(m_source->tilesX(finest),
+                                                      m_source->tilesY(finest)));
+    program.setUniformValue("vtPhysicalSize", QVector2D(m_physical.width(),
+                                                        m_physical.height()));
+    program.setUniformValue("vtTileSize", GLfloat(m_source->tileSize()));
+    program.setUniformValue("vtSlotSize", GLfloat(m_slotSize));
+    program.setUniformValue("vtMaxLevel", GLfloat(finest));
+    // finest level texels per pixel at unit distance, on the equator
+    program.setUniformValue("vtTexelScale", GLfloat(size.width() / (2 * M_PI * pixelScale)));
+}
+
+void VirtualTexture::release()
+{
+    m_physical.release(2, QOpenGLTexture::ResetTextureUnit);
+    m_indirection.release(1, QOpenGLTexture::ResetTextureUnit);
+}
+
+void VirtualTexture::disable(QOpenGLShaderProgram &program)
+{
+    program.setUniformValue("fVirtualTexture", GLint(0));
+    program.setUniformValue("fFeedback", GLint(0));
+}
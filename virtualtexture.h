@@ -0,0 +1,108 @@
+#ifndef VIRTUALTEXTURE_H
+#define VIRTUALTEXTURE_H
+
+#include <QFuture>
+#include <QHash>
+#include <QImage>
+#include <QOpenGLBuffer>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
+#include <QScopedPointer>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
+#include "tilesource.h"
+
+/*!
+ * \brief The VirtualTexture class
+ * Streams the tiles of a TileSource the view needs into a fixed size
+ * physical texture, so GPU memory does not grow with the source image.
+ *
+ * Each frame the sphere is drawn once more into a small feedback buffer,
+ * where texlighting.frag writes the tile every fragment wants instead of
+ * its color. Where pixel buffers are available the feedback is read back
+ * into a ring of them and looked at ReadbackCount - 1 frames later, so the
+ * render thread does not wait for the GPU. Missing tiles are decoded on
+ * the thread pool and replace the least recently wanted ones. The
+ * indirection texture maps every finest level tile to the slot of its
+ * finest resident ancestor.
+ */
+class VirtualTexture : protected QOpenGLFunctions
+{
+public:
+    // the feedback buffer is this many times smaller than the viewport
+    static const int FeedbackDivisor = 8;
+    // pixel buffers the feedback goes through
+    static const int ReadbackCount = 3;
+
+    // needs a current context; takes ownership of source
+    explicit VirtualTexture(TileSource *source, int slotsX = 8, int slotsY = 8);
+    ~VirtualTexture();
+
+    // draw the sphere between these two with bind(program, ..., true)
+    void beginFeedback(const QSize &viewport);
+    void endFeedback();
+    // upload finished tiles and refresh the indirection texture
+    void update();
+    // tiles are still on their way, or the feedback has not settled since
+    // the view last changed; more frames are needed
+    bool isBusy() const;
+
+    int residentTiles() const { return m_slotOf.size(); }
+
+    void bind(QOpenGLShaderProgram &program, double pixelScale, bool feedback);
+    void release();
+    // for programs drawn with an ordinary texture
+    static void disable(QOpenGLShaderProgram &program);
+
+protected:
+    struct Slot {
+        quint64 key;
+        int lastUsed;
+        bool pinned;
+    };
+
+    static quint64 tileKey(int level, int x, int y);
+    bool readFeedback(const QSize &size);
+    void requestWanted();
+    void request(quint64 key);
+    int allocateSlot();
+    void pinLevelZero();
+    void upload(int slot, const QImage &tile);
+    void updateIndirection();
+
+private:
+    QSharedPointer<TileSource> m_source;
+    int m_slotsX;
+    int m_slotsY;
+    int m_slotSize;
+    int m_frame;
+
+    QOpenGLTexture m_physical;
+    QOpenGLTexture m_indirection;
+    bool m_indirectionDirty;
+
+    QVector<Slot> m_slots;
+    QHash<quint64, int> m_slotOf;
+    // tiles wanted by the last feedback, coarse levels first
+    QVector<quint64> m_requests;
+    QHash<quint64, QFuture<QImage>> m_loading;
+
+    QScopedPointer<QOpenGLFramebufferObject> m_feedbackFbo;
+    // blending as it was before the feedback pass
+    bool m_blendEnabled;
+    // the ring, with the feedback size each buffer holds, empty for none
+    bool m_asyncReadback;
+    QOpenGLBuffer m_readbacks[ReadbackCount];
+    QSize m_readbackSizes[ReadbackCount];
+    int m_readbackIndex;
+    // tiles of the last feedback looked at, and whether the one before it
+    // wanted the same
+    QSet<quint64> m_wanted;
+    bool m_settled;
+    QVector<uchar> m_feedback;
+};
+
+#endif // VIRTUALTEXTURE_H